@@ -109,6 +109,16 @@ public:
 		arg = a;
 	}
 
+	/** get type of argument */
+	const std::string& getArgumentType() const {
+		return argType;
+	}
+
+	/** set type of argument */
+	void setArgType(const std::string& type) {
+		argType = type;
+	}
+
 	/** add argument to argument list */
 	void addUnaryMap(AstArgument* first, AstArgument* output) {
 		unarymap.push_back( { first, output });
@@ -159,6 +169,9 @@ protected:
 	/** arguments of lattice binary function */
 	std::string arg;
 
+	/** type of argument */
+	std::string argType;
+
 	/** output of lattice binary function **/
 	std::string func_output;
 
@@ -238,6 +251,16 @@ public:
 		args.push_back(arg);
 	}
 
+	/** get types of arguments */
+	const std::vector<std::string>& getArgumentTypes() const {
+		return argTypes;
+	}
+
+	/** add type of the next argument */
+	void addArgType(const std::string& type) {
+		argTypes.push_back(type);
+	}
+
 	/** add argument to argument list */
 	void addPairMap(AstArgument* first, AstArgument* second,
 			AstArgument* output) {
@@ -294,6 +317,9 @@ protected:
 	/** arguments of lattice binary function */
 	std::vector<std::string> args;
 
+	/** types of arguments */
+	std::vector<std::string> argTypes;
+
 	/** output of lattice binary function **/
 	std::string func_output;
 
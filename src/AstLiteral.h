@@ -223,6 +223,32 @@ protected:
     }
 };
 
+/**
+ * Subclass of Negation that represents a negated atom of a keyed lattice relation.
+ *
+ * Specialised for lattice fixpoints: holds if joining the lattice element of the atom
+ * would raise the cell of its key, not merely if the very tuple doesn't exist
+ */
+class AstSubsumptionNegation : public AstNegation {
+public:
+    AstSubsumptionNegation(std::unique_ptr<AstAtom> atom) : AstNegation(std::move(atom)) {}
+
+    ~AstSubsumptionNegation() override = default;
+
+    /** Output to a given stream */
+    void print(std::ostream& os) const override {
+        os << "lat!";
+        atom->print(os);
+    }
+
+    /** Creates a clone of this AST sub-structure */
+    AstSubsumptionNegation* clone() const override {
+        AstSubsumptionNegation* res = new AstSubsumptionNegation(std::unique_ptr<AstAtom>(atom->clone()));
+        res->setSrcLoc(getSrcLoc());
+        return res;
+    }
+};
+
 /**
  * Subclass of Literal that represents a negated atom, * e.g., !parent(x,y).
  * A Negated atom occurs in a body of clause and cannot occur in a head of a clause.
@@ -26,6 +26,7 @@
 #include "AstRelation.h"
 #include "AstLatticeAssociation.h"
 #include "AstTranslationUnit.h"
+#include "AstType.h"
 #include "AstTypeEnvironmentAnalysis.h"
 #include "AstUtils.h"
 #include "AstVisitor.h"
@@ -48,6 +49,7 @@
 #include "RamTypes.h"
 #include "SrcLocation.h"
 #include "SymbolMask.h"
+#include "SymbolTable.h"
 #include "EnumTypeMask.h"
 #include "TypeSystem.h"
 #include "Util.h"
@@ -123,6 +125,17 @@ EnumTypeMask AstTranslator::getEnumTypeMask(const AstRelation& rel) {
 	return res;
 }
 
+RelationRepresentation AstTranslator::getRepresentation(
+		const AstRelation& rel) {
+	// provenance appends columns after the lattice column, hence no keyed cells
+	if (rel.isLattice()
+			&& rel.getRepresentation() == RelationRepresentation::DEFAULT
+			&& !Global::config().has("provenance")) {
+		return RelationRepresentation::LATTICE;
+	}
+	return rel.getRepresentation();
+}
+
 void AstTranslator::makeIODirective(IODirectives& ioDirective,
 		const AstRelation* rel, const std::string& filePath,
 		const std::string& fileExt, const bool isIntermediate) {
@@ -153,6 +166,14 @@ void AstTranslator::makeIODirective(IODirectives& ioDirective,
 				&& ioDirective.getFileName().front() != '/') {
 			ioDirective.setFileName(filePath + "/" + ioDirective.getFileName());
 		}
+	} else if (ioDirective.getIOType() == "binary") {
+		// binary relations are stored in the same directories as text files
+		if (!ioDirective.has("filename")) {
+			ioDirective.setFileName(ioDirective.getRelationName() + ".bin");
+		}
+		if (ioDirective.getFileName().front() != '/') {
+			ioDirective.setFileName(filePath + "/" + ioDirective.getFileName());
+		}
 	}
 }
 
@@ -305,7 +326,7 @@ std::unique_ptr<RamRelationReference> AstTranslator::translateRelation(
 			relationNamePrefix + getRelationName(rel->getName()),
 			rel->getArity(), attributeNames, attributeTypeQualifiers,
 			getSymbolMask(*rel), getEnumTypeMask(*rel),
-			rel->getRepresentation(), rel->isLattice());
+			getRepresentation(*rel), rel->isLattice());
 }
 
 std::unique_ptr<RamRelationReference> AstTranslator::translateDeltaRelation(
@@ -576,6 +597,24 @@ std::unique_ptr<RamCondition> AstTranslator::translateConstraint(
 							std::move(values)));
 		}
 
+		/** for lattice negations */
+		std::unique_ptr<RamCondition> visitSubsumptionNegation(
+				const AstSubsumptionNegation& neg) override {
+			// get contained atom
+			const auto* atom = neg.getAtom();
+
+			std::vector<std::unique_ptr<RamValue>> values;
+			for (const auto& arg : atom->getArguments()) {
+				values.push_back(translator.translateValue(arg, index));
+			}
+
+			// add constraint
+			return std::make_unique<RamNegation>(
+					std::make_unique<RamSubsumptionCheck>(
+							translator.translateRelation(atom),
+							std::move(values)));
+		}
+
 		/** for provenance negation */
 		std::unique_ptr<RamCondition> visitProvenanceNegation(
 				const AstProvenanceNegation& neg) override {
@@ -777,6 +816,13 @@ std::unique_ptr<RamLatticeUnaryFunction> AstTranslator::translateLatticeUnaryFun
 			ramLatCases.back().constraint == nullptr
 					&& "The last match constraint of lattice unary function must be NULL!");
 
+	// an enum argument ranges over few symbols, so the function is tabulated
+	std::vector<RamDomain> domain = getEnumSymbols(
+			AstUnary->getArgumentType());
+	if (!domain.empty() && RamLatUnary->isTabulable()) {
+		RamLatUnary->getTable().addDomain(domain);
+	}
+
 	return std::unique_ptr<RamLatticeUnaryFunction>(RamLatUnary);
 }
 
@@ -843,9 +889,33 @@ std::unique_ptr<RamLatticeBinaryFunction> AstTranslator::translateLatticeBinaryF
 			ramLatCases.back().match == nullptr
 					&& "The last match constraint of lattice binary function must be NULL!");
 
+	// enum arguments range over few symbols, so the function is tabulated
+	const std::vector<std::string>& types = AstBinary->getArgumentTypes();
+	std::vector<RamDomain> lhsDomain = getEnumSymbols(types[0]);
+	std::vector<RamDomain> rhsDomain = getEnumSymbols(types[1]);
+	if (!lhsDomain.empty() && !rhsDomain.empty()
+			&& RamLatBinary->isTabulable()) {
+		RamLatBinary->getTable().addDomain(lhsDomain);
+		RamLatBinary->getTable().addDomain(rhsDomain);
+	}
+
 	return std::unique_ptr<RamLatticeBinaryFunction>(RamLatBinary);
 }
 
+std::vector<RamDomain> AstTranslator::getEnumSymbols(
+		const std::string& type) const {
+	std::vector<RamDomain> symbols;
+	const auto* enumType = dynamic_cast<const AstEnumType*>(program->getType(
+			type));
+	if (enumType == nullptr) {
+		return symbols;
+	}
+	for (const auto& cur : enumType->getCases()) {
+		symbols.push_back(symTab->lookupExisting(cur.name));
+	}
+	return symbols;
+}
+
 std::unique_ptr<AstClause> AstTranslator::ClauseTranslator::getReorderedClause(
 		const AstClause& clause, const int version) const {
 	const auto plan = clause.getExecutionPlan();
@@ -1225,6 +1295,43 @@ std::unique_ptr<RamStatement> AstTranslator::ClauseTranslator::translateClause(
 		op = std::move(aggregate);
 	}
 
+	// a saturated cell cannot rise anymore, so derivations for it are pruned
+	// as soon as the key is bound, i.e., before the inner levels are scanned
+	std::map<int, std::vector<std::unique_ptr<RamCondition>>> saturationChecks;
+	for (const AstNegation* neg : clause.getNegations()) {
+		if (dynamic_cast<const AstSubsumptionNegation*>(neg) == nullptr) {
+			continue;
+		}
+		const AstAtom* atom = neg->getAtom();
+		std::vector<std::unique_ptr<RamValue>> values;
+		int keyLevel = 0;
+		for (size_t i = 0; i + 1 < atom->argSize(); i++) {
+			const AstArgument* arg = atom->getArgument(i);
+			if (const auto* var = dynamic_cast<const AstVariable*>(arg)) {
+				if (!valueIndex.isDefined(*var)) {
+					break;
+				}
+				const Location& loc = valueIndex.getDefinitionPoint(*var);
+				if (valueIndex.isAggregator(loc.identifier)) {
+					break;
+				}
+				keyLevel = std::max(keyLevel, loc.identifier);
+			} else if (dynamic_cast<const AstConstant*>(arg) == nullptr) {
+				break;
+			}
+			values.push_back(translator.translateValue(arg, valueIndex));
+		}
+		if (values.size() + 1 != atom->argSize()) {
+			continue;
+		}
+		values.push_back(nullptr);
+		saturationChecks[keyLevel].push_back(
+				std::make_unique<RamNegation>(
+						std::make_unique<RamSaturationCheck>(
+								translator.translateRelation(atom),
+								std::move(values))));
+	}
+
 	// build operation bottom-up
 	while (!op_nesting.empty()) {
 		// get next operator
@@ -1234,6 +1341,11 @@ std::unique_ptr<RamStatement> AstTranslator::ClauseTranslator::translateClause(
 		// get current nesting level
 		auto level = op_nesting.size();
 
+		// add saturation checks of keys bound at this level
+		for (auto& check : saturationChecks[level]) {
+			op = std::make_unique<RamFilter>(std::move(check), std::move(op));
+		}
+
 		if (const auto* atom = dynamic_cast<const AstAtom*>(cur)) {
 			// add constraints
 			for (size_t pos = 0; pos < atom->argSize(); ++pos) {
@@ -1385,7 +1497,9 @@ std::unique_ptr<RamStatement> AstTranslator::translateNonRecursiveRelation(
 	}
 
 	// added by Qing Gong: consider lattice for non-recursive relations
-	if (res && rel.isLattice()) {
+	// (keyed lattice relations are normalised on insertion)
+	if (res && rel.isLattice()
+			&& getRepresentation(rel) != RelationRepresentation::LATTICE) {
 		// Run only if there are non-recursive rules
 		// added by Qing Gong
 		// if this is lattice relation with lattice, need to normalize it.
@@ -1506,7 +1620,10 @@ std::unique_ptr<RamStatement> AstTranslator::translateRecursiveRelation(
 		rrel[rel] = translateRelation(rel);
 		relDelta[rel] = translateDeltaRelation(rel);
 		relNew[rel] = translateNewRelation(rel);
-		if (rrel[rel]->isLattice()) {
+		// keyed lattice relations join the new knowledge in place (see LATMERGE)
+		bool isKeyedLattice = rrel[rel]->getRepresentation()
+				== RelationRepresentation::LATTICE;
+		if (rrel[rel]->isLattice() && !isKeyedLattice) {
 			rrel_lat[rel] = translateOrgLatRelation(rel);
 			relNew_lat[rel] = translateNewLatRelation(rel);
 		}
@@ -1542,25 +1659,27 @@ std::unique_ptr<RamStatement> AstTranslator::translateRecursiveRelation(
 //									relNew_lat[rel]->clone())));
 //		} else {
 		/* create update statements for fixpoint (even iteration) */
-		appendStmt(updateRelTable,
-				std::make_unique<RamMerge>(
-						std::unique_ptr<RamRelationReference>(
-								rrel[rel]->clone()),
-						std::unique_ptr<RamRelationReference>(
-								relNew[rel]->clone())));
+		if (!isKeyedLattice) {
+			appendStmt(updateRelTable,
+					std::make_unique<RamMerge>(
+							std::unique_ptr<RamRelationReference>(
+									rrel[rel]->clone()),
+							std::unique_ptr<RamRelationReference>(
+									relNew[rel]->clone())));
 //		}
 
-		appendStmt(updateRelTable,
-				std::make_unique<RamSwap>(
-						std::unique_ptr<RamRelationReference>(
-								relDelta[rel]->clone()),
-						std::unique_ptr<RamRelationReference>(
-								relNew[rel]->clone())));
+			appendStmt(updateRelTable,
+					std::make_unique<RamSwap>(
+							std::unique_ptr<RamRelationReference>(
+									relDelta[rel]->clone()),
+							std::unique_ptr<RamRelationReference>(
+									relNew[rel]->clone())));
 
-		appendStmt(updateRelTable,
-				std::make_unique<RamClear>(
-						std::unique_ptr<RamRelationReference>(
-								relNew[rel]->clone())));
+			appendStmt(updateRelTable,
+					std::make_unique<RamClear>(
+							std::unique_ptr<RamRelationReference>(
+									relNew[rel]->clone())));
+		}
 
 		// Plan A
 //		if (rrel[rel]->isLattice()) {
@@ -1575,7 +1694,7 @@ std::unique_ptr<RamStatement> AstTranslator::translateRecursiveRelation(
 //		}
 
 		/* measure update time for each relation */
-		if (Global::config().has("profile")) {
+		if (updateRelTable && Global::config().has("profile")) {
 			updateRelTable = std::make_unique<RamLogTimer>(
 					std::move(updateRelTable),
 					LogStatement::cRecursiveRelation(toString(rel->getName()),
@@ -1585,7 +1704,7 @@ std::unique_ptr<RamStatement> AstTranslator::translateRecursiveRelation(
 		}
 
 		// Plan B: latnorm the lattice relation in postamble
-		if (rel->isLattice()) {
+		if (rrel_lat.count(rel) != 0) {
 			appendStmt(postamble,
 					std::make_unique<RamLatNorm>(
 							std::unique_ptr<RamRelationReference>(
@@ -1612,15 +1731,17 @@ std::unique_ptr<RamStatement> AstTranslator::translateRecursiveRelation(
 										relNew[rel]->clone()))));
 
 		// added by Qing Gong: drop temporary lattice relations
-		if (rel->isLattice()) {
+		if (rrel_lat.count(rel) != 0) {
 			appendStmt(postamble,
-					std::make_unique<RamSequence>(
-							std::make_unique<RamDrop>(
-									std::unique_ptr<RamRelationReference>(
-											rrel_lat[rel]->clone())),
-							std::make_unique<RamDrop>(
-									std::unique_ptr<RamRelationReference>(
-											relNew_lat[rel]->clone()))));
+					std::make_unique<RamDrop>(
+							std::unique_ptr<RamRelationReference>(
+									rrel_lat[rel]->clone())));
+		}
+		if (relNew_lat.count(rel) != 0) {
+			appendStmt(postamble,
+					std::make_unique<RamDrop>(
+							std::unique_ptr<RamRelationReference>(
+									relNew_lat[rel]->clone())));
 		}
 
 		/* Generate code for non-recursive part of relation */
@@ -1641,7 +1762,25 @@ std::unique_ptr<RamStatement> AstTranslator::translateRecursiveRelation(
 
 	// Plan B by Qing Gong: clean the "new" relations in the loop, between updateTable and Exit
 	for (const AstRelation* rel : scc) {
-		if (rrel[rel]->isLattice()) {
+		if (rrel[rel]->getRepresentation() == RelationRepresentation::LATTICE) {
+			// only the cells that went up form the next delta
+			appendStmt(beforeExit,
+					std::make_unique<RamClear>(
+							std::unique_ptr<RamRelationReference>(
+									relDelta[rel]->clone())));
+			appendStmt(beforeExit,
+					std::make_unique<RamLatMerge>(
+							std::unique_ptr<RamRelationReference>(
+									rrel[rel]->clone()),
+							std::unique_ptr<RamRelationReference>(
+									relNew[rel]->clone()),
+							std::unique_ptr<RamRelationReference>(
+									relDelta[rel]->clone())));
+			appendStmt(beforeExit,
+					std::make_unique<RamClear>(
+							std::unique_ptr<RamRelationReference>(
+									relNew[rel]->clone())));
+		} else if (rrel[rel]->isLattice()) {
 			appendStmt(beforeExit,
 					std::make_unique<RamLatClean>(
 							std::unique_ptr<RamRelationReference>(
@@ -1707,6 +1846,13 @@ std::unique_ptr<RamStatement> AstTranslator::translateRecursiveRelation(
 							std::make_unique<AstProvenanceNegation>(
 									std::unique_ptr<AstAtom>(
 											cl->getHead()->clone())));
+				} else if (getRepresentation(*rel)
+						== RelationRepresentation::LATTICE) {
+					// only tuples raising the cell of their key are new knowledge
+					r1->addToBody(
+							std::make_unique<AstSubsumptionNegation>(
+									std::unique_ptr<AstAtom>(
+											cl->getHead()->clone())));
 				} else {
 					r1->addToBody(
 							std::make_unique<AstNegation>(
@@ -1801,12 +1947,16 @@ std::unique_ptr<RamStatement> AstTranslator::translateRecursiveRelation(
 						: std::move(clause));
 			};
 
+	// keyed lattice relations have merged their new knowledge before the exit
 	std::unique_ptr<RamCondition> exitCond;
 	for (const AstRelation* rel : scc) {
+		const auto& changed =
+				(getRepresentation(*rel) == RelationRepresentation::LATTICE) ?
+						relDelta[rel] : relNew[rel];
 		addCondition(exitCond,
 				std::make_unique<RamEmptinessCheck>(
 						std::unique_ptr<RamRelationReference>(
-								relNew[rel]->clone())));
+								changed->clone())));
 	}
 
 	/* construct fixpoint loop  */
@@ -1905,6 +2055,9 @@ void AstTranslator::translateProgram(
 	typeEnv =
 			&translationUnit.getAnalysis<TypeEnvironmentAnalysis>()->getTypeEnvironment();
 
+	// obtain symbol table for enum symbols
+	symTab = &translationUnit.getSymbolTable();
+
 	// obtain recursive clauses from analysis
 	const auto* recursiveClauses =
 			translationUnit.getAnalysis<RecursiveClauses>();
@@ -1991,6 +2144,11 @@ void AstTranslator::translateProgram(
 	// maintain the index of the SCC within the topological order
 	size_t indexOfScc = 0;
 
+	// strata dropping relations read by several strata, run after all of their readers if
+	// strata are evaluated concurrently, are numbered after the strata of the SCCs
+	size_t indexOfDrop = sccGraph.getNumberOfSCCs();
+	std::vector<std::unique_ptr<RamStratum>> drops;
+
 	// iterate over each SCC according to the topological order
 	for (const auto& scc : sccOrder.order()) {
 		// make a new ram statement for the current SCC
@@ -2035,7 +2193,9 @@ void AstTranslator::translateProgram(
 								std::unique_ptr<RamRelationReference>(
 										translateNewRelation(relation))));
 
-				if (relation->isLattice()) {
+				if (relation->isLattice()
+						&& getRepresentation(*relation)
+								!= RelationRepresentation::LATTICE) {
 					appendStmt(current,
 							std::make_unique<RamCreate>(
 									std::unique_ptr<RamRelationReference>(
@@ -2140,6 +2300,20 @@ void AstTranslator::translateProgram(
 				for (const auto& relation : externNonOutPreds) {
 					makeRamDrop(current, relation);
 				}
+			} else if (Global::config().has("parallel-strata")) {
+				// drop relations expired at the current SCC once all strata reading them are complete
+				for (const auto& relation : internExps) {
+					const size_t producer = sccOrder.indexOfScc(sccGraph.getSCC(relation));
+					if (producer == indexOfScc) {
+						makeRamDrop(current, relation);
+						continue;
+					}
+					std::set<size_t> readers = sccOrder.indexOfScc(sccGraph.getSuccessorSCCs(relation));
+					readers.insert(producer);
+					std::unique_ptr<RamStatement> drop;
+					makeRamDrop(drop, relation);
+					drops.push_back(std::make_unique<RamStratum>(std::move(drop), indexOfDrop++, readers));
+				}
 			} else {
 				// otherwise, drop all  relations expired as per the topological order
 				for (const auto& relation : internExps) {
@@ -2149,10 +2323,16 @@ void AstTranslator::translateProgram(
 		}
 
 		if (current) {
-			// append the current SCC as a stratum to the sequence
+			// append the current SCC as a stratum to the sequence, after the strata of its predecessors
 			appendStmt(res,
 					std::make_unique<RamStratum>(std::move(current),
-							indexOfScc));
+							indexOfScc, sccOrder.indexOfScc(sccGraph.getPredecessorSCCs(scc))));
+
+			// append the strata dropping relations expired at the current SCC
+			for (auto& drop : drops) {
+				appendStmt(res, std::move(drop));
+			}
+			drops.clear();
 
 			// increment the index of the current SCC
 			indexOfScc++;
@@ -76,6 +76,9 @@ private:
 	/** Type environment */
 	const TypeEnvironment* typeEnv = nullptr;
 
+	/** Symbol table */
+	const SymbolTable* symTab = nullptr;
+
 	/** RAM program */
 	std::unique_ptr<RamProgram> ramProg;
 
@@ -204,6 +207,10 @@ private:
 		const bool isArgEnum(const Location& loc,
 				const TypeEnvironment* typeEnv) const {
 			//const Location& loc = getDefinitionPoint(var);
+			// fields of unpacked records are not lattice elements
+			if (loc.relation == nullptr) {
+				return false;
+			}
 			auto rel = loc.relation->getRelation();
 			const std::string& argTypeQualifier = rel->getArgTypeQualifier(
 					loc.element);
@@ -347,6 +354,9 @@ private:
 	/** get enum type mask of a relation describing type attributes */
 	EnumTypeMask getEnumTypeMask(const AstRelation& rel);
 
+	/** get the data structure of a relation; lattice relations keep one cell per key by default */
+	RelationRepresentation getRepresentation(const AstRelation& rel);
+
 	/** converts the given relation identifier into a relation name */
 	std::string getRelationName(const AstRelationIdentifier& id) {
 		return toString(join(id.getNames(), "."));
@@ -425,6 +435,9 @@ private:
 	std::unique_ptr<RamLatticeBinaryFunction> translateLatticeBinaryFunction(
 			const AstLatticeBinaryFunction* AstB);
 
+	/** get the symbols of an enum type; empty if the type is not an enum **/
+	std::vector<RamDomain> getEnumSymbols(const std::string& type) const;
+
 	/** translate AST clause to RAM code */
 	class ClauseTranslator {
 		// index nested variables and records
@@ -96,6 +96,7 @@ struct AstVisitor : public ast_visitor_tag {
 
         // literals
         FORWARD(Atom)
+        FORWARD(SubsumptionNegation)
         FORWARD(Negation)
         FORWARD(ProvenanceNegation)
         FORWARD(BooleanConstraint)
@@ -164,6 +165,7 @@ protected:
 
     // literals
     LINK(Atom, Literal)
+    LINK(SubsumptionNegation, Negation)
     LINK(Negation, Literal)
     LINK(ProvenanceNegation, Literal)
     LINK(Literal, Node);
@@ -20,6 +20,7 @@
 #include "ParallelUtils.h"
 #include "Util.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <iterator>
@@ -290,6 +291,9 @@ protected:
     using field_index_type = uint8_t;
     using lock_type = OptimisticReadWriteLock;
 
+    // the number of entries of an inner node whose count is not known
+    static constexpr size_type unknownEntries = ~size_type(0);
+
     struct node;
 
     /**
@@ -461,19 +465,44 @@ protected:
 
         /**
          * Counts the number of entries contained in the sub-tree rooted
-         * by this node.
+         * by this node. The counts of inner nodes are remembered until
+         * entries are added to their sub-trees.
          */
         size_type countEntries() const {
             if (this->isLeaf()) {
                 return this->numElements;
             }
+            const inner_node& inner = asInnerNode();
+            if (inner.numEntries != unknownEntries) {
+                return inner.numEntries;
+            }
             size_type sum = this->numElements;
             for (unsigned i = 0; i <= this->numElements; ++i) {
                 sum += getChild(i)->countEntries();
             }
+            inner.numEntries = sum;
             return sum;
         }
 
+        /**
+         * Forgets the remembered number of entries of this node and the nodes
+         * above it, after the entries of this node changed. Nodes with unknown
+         * counts only have ancestors with unknown counts, so the walk may
+         * stop at the first of them.
+         */
+        void invalidateEntries() {
+            if (this->isInner()) {
+                asInnerNode().numEntries = unknownEntries;
+            }
+            for (node* cur = this->parent; cur != nullptr; cur = cur->parent) {
+                inner_node& inner = cur->asInnerNode();
+                if (inner.numEntries == unknownEntries) {
+                    break;
+                }
+                inner.numEntries = unknownEntries;
+            }
+        }
+
         /**
          * Determines the amount of memory used by the sub-tree rooted
          * by this node.
@@ -595,6 +624,8 @@ protected:
 #else
             grow_parent(root, root_lock, sibling);
 #endif
+            this->invalidateEntries();
+            sibling->invalidateEntries();
         }
 
         /**
@@ -690,6 +721,8 @@ protected:
                     // update node sizes
                     left->numElements += num;
                     this->numElements -= num;
+                    left->invalidateEntries();
+                    this->invalidateEntries();
 
 #ifdef IS_PARALLEL
                     left->lock.end_write();
@@ -892,77 +925,6 @@ protected:
             }
         }
 
-        /**
-         * A function decomposing the sub-tree rooted by this node into approximately equally
-         * sized chunks. To minimize computational overhead, no strict load balance nor limit
-         * on the number of actual chunks is given.
-         *
-         * @see btree::getChunks()
-         *
-         * @param res   .. the list of chunks to be extended
-         * @param num   .. the number of chunks to be produced
-         * @param begin .. the iterator to start the first chunk with
-         * @param end   .. the iterator to end the last chunk with
-         * @return the handed in list of chunks extended by generated chunks
-         */
-        std::vector<chunk>& collectChunks(
-                std::vector<chunk>& res, size_type num, const iterator& begin, const iterator& end) const {
-            assert(num > 0);
-
-            // special case: this node is empty
-            if (isEmpty()) {
-                if (begin != end) {
-                    res.push_back(chunk(begin, end));
-                }
-                return res;
-            }
-
-            // special case: a single chunk is requested
-            if (num == 1) {
-                res.push_back(chunk(begin, end));
-                return res;
-            }
-
-            // cut-off
-            if (this->isLeaf() || num < (this->numElements + 1)) {
-                auto step = this->numElements / num;
-                if (step == 0) {
-                    step = 1;
-                }
-
-                size_type i = 0;
-
-                // the first chunk starts at the begin
-                res.push_back(chunk(begin, iterator(this, step - 1)));
-
-                // split up the main part
-                for (i = step - 1; i < this->numElements - step; i += step) {
-                    res.push_back(chunk(iterator(this, i), iterator(this, i + step)));
-                }
-
-                // the last chunk runs to the end
-                res.push_back(chunk(iterator(this, i), end));
-
-                // done
-                return res;
-            }
-
-            // else: collect chunks of sub-set elements
-
-            auto part = num / (this->numElements + 1);
-            assert(part > 0);
-            getChild(0)->collectChunks(res, part, begin, iterator(this, 0));
-            for (size_type i = 1; i < this->numElements; i++) {
-                getChild(i)->collectChunks(res, part, iterator(this, i - 1), iterator(this, i));
-            }
-            getChild(this->numElements)
-                    ->collectChunks(res, num - (part * this->numElements),
-                            iterator(this, this->numElements - 1), end);
-
-            // done
-            return res;
-        }
-
         /**
          * A function to verify the consistency of this node.
          *
@@ -1058,8 +1020,15 @@ protected:
         // references to child nodes owned by this node
         node* children[node::maxKeys + 1];
 
+        // the number of entries in the sub-tree rooted by this node, if known
+#ifdef IS_PARALLEL
+        mutable volatile size_type numEntries;
+#else
+        mutable size_type numEntries;
+#endif
+
         // a simple default constructor initializing member fields
-        inner_node() : node(true) {}
+        inner_node() : node(true), numEntries(unknownEntries) {}
 
         // a destruction operation clearing up child nodes recursively
         void cleanup() {
@@ -1161,6 +1130,39 @@ public:
         void print(std::ostream& out = std::cout) const {
             out << cur << "[" << (int)pos << "]";
         }
+
+        /**
+         * Partitions the range between the given iterators into up to the given number
+         * of chunks covering the same number of elements, utilizing the entry counts of
+         * the nodes. The tree must not be updated concurrently.
+         */
+        static std::vector<range<iterator>> partition(const iterator& a, const iterator& b, size_type num) {
+            std::vector<range<iterator>> res;
+            if (a == b) {
+                return res;
+            }
+
+            // locate the range within the tree
+            const node* root = a.cur;
+            while (root->getParent() != nullptr) {
+                root = root->getParent();
+            }
+            const size_type first = btree::rank(a.cur, a.pos);
+            const size_type length = ((b.cur) ? btree::rank(b.cur, b.pos) : root->countEntries()) - first;
+
+            // cut it at evenly spaced ranks
+            num = std::max<size_type>(1, std::min(num, length));
+            iterator lower = a;
+            for (size_type i = 1; i <= num; ++i) {
+                iterator upper = (i == num) ? b : btree::select(root, first + (length * i) / num);
+                res.push_back(range<iterator>(lower, upper));
+                lower = upper;
+            }
+            return res;
+        }
+
+    private:
+        friend class btree;
     };
 
     /**
@@ -1552,6 +1554,7 @@ public:
             // insert new element
             cur->keys[idx] = k;
             cur->numElements++;
+            cur->invalidateEntries();
 
             // release lock on current node
             cur->lock.end_write();
@@ -1660,6 +1663,7 @@ public:
             // insert new element
             cur->keys[idx] = k;
             cur->numElements++;
+            cur->invalidateEntries();
 
             // remember last insertion position
             hints.last_insert.access(cur);
@@ -1694,17 +1698,51 @@ public:
             return;
         }
 
-        // make sure bigger tree is inserted in smaller tree
-        if ((size() + 10000) < other.size()) {
-            // switch sides
-            btree tmp = other;
-            tmp.insertAll(*this);
-            swap(tmp);
+        // the elements of the other tree are sorted in the order of this tree
+        insertSorted(other.begin(), other.end());
+    }
+
+    /**
+     * Inserts a range of elements sorted in the order of this tree. If the range
+     * is small compared to this tree, its elements are inserted one by one, with
+     * hints exploiting their locality. Otherwise the elements of this tree and
+     * the range are merged and the tree is rebuilt from the merged sequence
+     * bottom-up, like by the bulk-load operation.
+     *
+     * This operation must not run concurrently with other updates of this tree.
+     */
+    template <typename Iter>
+    void insertSorted(const Iter& a, const Iter& b) {
+        if (a == b) {
+            return;
+        }
+        const size_type count = std::distance(a, b);
+        const size_type present = size();
+        if (count * 8 < present) {
+            insert(a, b);
             return;
         }
 
-        // by default use the iterator based insertion
-        insert(other.begin(), other.end());
+        // merge the present elements and the range
+        std::vector<Key> merged;
+        merged.reserve(present + count);
+        std::merge(begin(), end(), a, b, std::back_inserter(merged),
+                [&](const Key& x, const Key& y) { return less(x, y); });
+        if (isSet) {
+            // of weakly equal elements, the least one is kept like by an insertion
+            merged.erase(std::unique(merged.begin(), merged.end(),
+                                 [&](const Key& x, const Key& y) { return weak_equal(x, y); }),
+                    merged.end());
+        }
+
+        // rebuild the tree
+        clear();
+        root = buildSubTree(merged.begin(), merged.end() - 1);
+        node* first = root;
+        while (!first->isLeaf()) {
+            first = first->getChild(0);
+        }
+        leftmost = static_cast<leaf_node*>(first);
     }
 
     // Obtains an iterator referencing the first element of the tree.
@@ -1726,11 +1764,23 @@ public:
      * @return a list of chunks partitioning this tree
      */
     std::vector<chunk> getChunks(size_type num) const {
-        std::vector<chunk> res;
-        if (empty()) {
-            return res;
-        }
-        return root->collectChunks(res, num, begin(), end());
+        return iterator::partition(begin(), end(), num);
+    }
+
+    /**
+     * Obtains the number of elements preceding the referenced element, or the
+     * number of elements of this tree for an end-iterator.
+     */
+    size_type rank(const iterator& it) const {
+        return (it.cur) ? rank(it.cur, it.pos) : size();
+    }
+
+    /**
+     * Obtains an iterator referencing the element preceded by the given number
+     * of elements. If there is no such element, an end-iterator will be returned.
+     */
+    iterator select(size_type i) const {
+        return (i < size()) ? select(root, i) : end();
     }
 
     /**
@@ -1925,6 +1975,37 @@ public:
         }
     }
 
+    /**
+     * Obtains an iterator referencing the last element the given key is not less
+     * than. If there is no such element, an end-iterator will be returned.
+     */
+    iterator floor(const Key& k) const {
+        if (empty()) {
+            return end();
+        }
+
+        node* cur = root;
+        iterator res = end();
+        while (true) {
+            auto a = &(cur->keys[0]);
+            auto b = &(cur->keys[cur->numElements]);
+
+            auto pos = search.upper_bound(k, a, b, comp);
+            auto idx = pos - a;
+
+            // the key preceding the upper bound is a candidate
+            if (pos != a) {
+                res = iterator(cur, idx - 1);
+            }
+
+            if (!cur->inner) {
+                return res;
+            }
+
+            cur = cur->getChild(idx);
+        }
+    }
+
     /**
      * Clears this tree.
      */
@@ -2152,60 +2233,109 @@ private:
         return !node->isEmpty() && !less(k, node->keys[0]) && less(k, node->keys[node->numElements - 1]);
     }
 
+    // Counts the elements preceding the given position within the tree containing it.
+    static size_type rank(const node* cur, size_type pos) {
+        size_type res = pos;
+        if (cur->isInner()) {
+            for (size_type i = 0; i <= pos; ++i) {
+                res += cur->getChild(i)->countEntries();
+            }
+        }
+        while (cur->getParent() != nullptr) {
+            const size_type position = cur->getPositionInParent();
+            cur = cur->getParent();
+            res += position;
+            for (size_type i = 0; i < position; ++i) {
+                res += cur->getChild(i)->countEntries();
+            }
+        }
+        return res;
+    }
+
+    // Locates the element preceded by the given number of elements within the given sub-tree.
+    static iterator select(const node* cur, size_type i) {
+        while (cur->isInner()) {
+            size_type c = 0;
+            while (true) {
+                const size_type entries = cur->getChild(c)->countEntries();
+                if (i < entries) {
+                    break;
+                }
+                if (i == entries) {
+                    return iterator(cur, c);
+                }
+                i -= entries + 1;
+                ++c;
+            }
+            cur = cur->getChild(c);
+        }
+        return iterator(cur, i);
+    }
+
     // Utility function for the load operation above.
     template <typename Iter>
     static node* buildSubTree(const Iter& a, const Iter& b) {
-        const int N = node::maxKeys;
+        // pick the lowest height able to hold the range
+        const size_type length = (b - a) + 1;
+        unsigned height = 0;
+        for (size_type capacity = node::maxKeys; capacity < length; capacity = grow(capacity)) {
+            height++;
+        }
+        return buildSubTree(a, length, height);
+    }
 
-        // divide range in N+1 sub-ranges
-        int length = (b - a) + 1;
+    // The number of keys a tree one level higher than one of the given capacity can hold.
+    static size_type grow(size_type capacity) {
+        return capacity * (node::maxKeys + 1) + node::maxKeys;
+    }
 
-        // terminal case: length is less then maxKeys
-        if (length <= N) {
-            // create a leaf node
+    // Builds a tree of exactly the given height, such that all leaves are on the same level.
+    template <typename Iter>
+    static node* buildSubTree(Iter a, size_type length, unsigned height) {
+        // terminal case: a single leaf node
+        if (height == 0) {
             node* res = new leaf_node();
             res->numElements = length;
-
-            for (int i = 0; i < length; ++i) {
+            for (size_type i = 0; i < length; ++i) {
                 res->keys[i] = a[i];
             }
-
             return res;
         }
 
-        // recursive case - compute step size
-        int numKeys = N;
-        int step = ((length - numKeys) / (numKeys + 1));
-
-        while (numKeys > 1 && (step < N / 2)) {
-            numKeys--;
-            step = ((length - numKeys) / (numKeys + 1));
+        // the capacity of a sub-tree
+        size_type capacity = node::maxKeys;
+        for (unsigned i = 1; i < height; i++) {
+            capacity = grow(capacity);
         }
 
+        // use as few children as possible, spreading the elements evenly
+        const size_type numChildren = (length + capacity + 1) / (capacity + 1);
+        const size_type perChild = (length - (numChildren - 1)) / numChildren;
+        const size_type remainder = (length - (numChildren - 1)) % numChildren;
+
         // create inner node
-        node* res = new inner_node();
-        res->numElements = numKeys;
+        auto* res = new inner_node();
+        res->numElements = numChildren - 1;
+        res->numEntries = length;
 
         Iter c = a;
-        for (int i = 0; i < numKeys; i++) {
-            // get dividing key
-            res->keys[i] = c[step];
+        for (size_type i = 0; i < numChildren; i++) {
+            const size_type count = perChild + ((i < remainder) ? 1 : 0);
 
             // get sub-tree
-            auto child = buildSubTree(c, c + (step - 1));
+            auto child = buildSubTree(c, count, height - 1);
             child->parent = res;
             child->position = i;
             res->getChildren()[i] = child;
+            c = c + count;
 
-            c = c + (step + 1);
+            // get dividing key
+            if (i + 1 < numChildren) {
+                res->keys[i] = *c;
+                c = c + 1;
+            }
         }
 
-        // and the remaining part
-        auto child = buildSubTree(c, b);
-        child->parent = res;
-        child->position = numKeys;
-        res->getChildren()[numKeys] = child;
-
         // done
         return res;
     }
@@ -2217,6 +2347,13 @@ template <typename Key, typename Comparator, typename Allocator, unsigned blockS
 const SearchStrategy
         btree<Key, Comparator, Allocator, blockSize, SearchStrategy, isSet, WeakComparator, Updater>::search;
 
+// Definition of static member unknownEntries.
+template <typename Key, typename Comparator, typename Allocator, unsigned blockSize, typename SearchStrategy,
+        bool isSet, typename WeakComparator, typename Updater>
+constexpr typename btree<Key, Comparator, Allocator, blockSize, SearchStrategy, isSet, WeakComparator,
+        Updater>::size_type
+        btree<Key, Comparator, Allocator, blockSize, SearchStrategy, isSet, WeakComparator, Updater>::unknownEntries;
+
 }  // end namespace detail
 
 /**
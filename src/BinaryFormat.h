@@ -0,0 +1,80 @@
+/*
+ * Souffle - A Datalog Compiler
+ * Copyright (c) 2013, 2014, Oracle and/or its affiliates. All rights reserved
+ * Licensed under the Universal Permissive License v 1.0 as shown at:
+ * - https://opensource.org/licenses/UPL
+ * - <souffle root>/licenses/SOUFFLE-UPL.txt
+ */
+
+/************************************************************************
+ *
+ * @file BinaryFormat.h
+ *
+ * Layout of the binary fact files of IO type "binary".
+ *
+ * A file starts with a BinaryHeader, followed by one column of size
+ * RamDomain values per attribute, padded to a multiple of eight bytes.
+ * Symbol and enum columns hold indices into the symbol dictionary at the end
+ * of the file, which consists of symbols + 1 offsets of type uint64_t
+ * followed by the characters of all symbols. The file uses the byte order
+ * and RamDomain width of the writer.
+ *
+ ***********************************************************************/
+
+#pragma once
+
+#include "RamTypes.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace souffle {
+
+struct BinaryHeader {
+    char magic[8];
+    uint32_t domainSize;
+    uint32_t arity;
+    uint64_t size;
+    uint64_t symbols;
+    uint64_t symbolBytes;
+
+    static constexpr const char* MAGIC = "SOUFBIN1";
+
+    BinaryHeader() : domainSize(sizeof(RamDomain)), arity(0), size(0), symbols(0), symbolBytes(0) {
+        std::memcpy(magic, MAGIC, sizeof(magic));
+    }
+
+    /** Check whether the header was written for tuples of the given arity */
+    bool isValid(size_t expectedArity) const {
+        return std::memcmp(magic, MAGIC, sizeof(magic)) == 0 && domainSize == sizeof(RamDomain) &&
+               arity == expectedArity;
+    }
+
+    /** Number of bytes of the columns including their padding */
+    uint64_t columnBytes() const {
+        return (arity * size * sizeof(RamDomain) + 7) & ~uint64_t(7);
+    }
+
+    /** Check whether a file of the given number of bytes has exactly the layout of this header; each
+     *  field is bounded by the length before it is used, so that corrupted fields cannot wrap around */
+    bool matchesLength(uint64_t length) const {
+        if (length < sizeof(BinaryHeader)) {
+            return false;
+        }
+        uint64_t rest = length - sizeof(BinaryHeader);
+        if (arity > 0 && size > rest / (arity * sizeof(RamDomain))) {
+            return false;
+        }
+        if (columnBytes() > rest) {
+            return false;
+        }
+        rest -= columnBytes();
+        if (symbols >= rest / sizeof(uint64_t)) {
+            return false;
+        }
+        rest -= (symbols + 1) * sizeof(uint64_t);
+        return symbolBytes == rest;
+    }
+};
+
+}  // namespace souffle
@@ -20,10 +20,12 @@
 #include "ParallelUtils.h"
 #include "Util.h"
 
+#include <atomic>
+#include <cassert>
+#include <cstdint>
 #include <limits>
 #include <memory>
 #include <unordered_map>
-#include <vector>
 
 namespace souffle {
 
@@ -73,70 +75,116 @@ bool isNull(RamDomain ref) {
 namespace detail {
 
 /**
- * A bidirectional mapping between tuples and reference indices.
+ * A bidirectional mapping between tuples and reference indices, safe for
+ * concurrent use. Tuples are stored in blocks that never move, such that
+ * references are unpacked without locking, and the index from tuples to
+ * references is split into shards guarded by their own locks.
  */
 template <typename Tuple>
 class RecordMap {
-    // create blocks of a million entries
-    static const std::size_t BLOCK_SIZE = 1 << 20;
-
     /** The definition of the tuple type handled by this instance */
     using tuple_type = Tuple;
 
-    /** The definition of the type of a tuple block */
-    using block_type = std::array<tuple_type, BLOCK_SIZE>;
+    enum {
+        /** Number of shards of the tuple index, a power of two */
+        SHARD_BITS = 6,
+        SHARDS = 1 << SHARD_BITS,
+        /** Number of tuples in the first block; block b holds BLOCK_SIZE << b */
+        BLOCK_SIZE = 1024,
+        /** Number of blocks, enough for any domain of references */
+        BLOCKS = 48
+    };
+
+    /** A part of the tuple index, guarded by its own lock */
+    struct Shard {
+        Lock access;
+        std::unordered_map<tuple_type, RamDomain> r2i;
+    };
+
+    /** The shards of the mapping from tuples to references/indices */
+    Shard shards[SHARDS];
+
+    /** The blocks of the mapping from indices to tuples, allocated when first used */
+    std::atomic<tuple_type*> i2r[BLOCKS];
+
+    /** The next index to be assigned; 0 is skipped for the Nil element */
+    std::atomic<RamDomain> next;
+
+    /** a lock for allocating blocks */
+    Lock grow;
+
+    /** Find the shard of a tuple from the high bits of its scrambled hash */
+    Shard& shardOf(const tuple_type& tuple) {
+        uint64_t hash = std::hash<tuple_type>()(tuple) * 0x9e3779b97f4a7c15ull;
+        return shards[hash >> (64 - SHARD_BITS)];
+    }
 
-    /** The type utilized for the block index */
-    using block_index_type = std::vector<std::unique_ptr<block_type>>;
+    /** Find the block and the offset in the block of an index */
+    static void locate(std::size_t index, std::size_t& block, std::size_t& offset) {
+        std::size_t n = index / BLOCK_SIZE + 1;
+        block = 63 - __builtin_clzll(n);
+        offset = index - BLOCK_SIZE * ((std::size_t(1) << block) - 1);
+    }
 
-    /** The mapping from tuples to references/indices */
-    std::unordered_map<tuple_type, RamDomain> r2i;
+    /** The slot for the tuple of an index, allocating its block if needed */
+    tuple_type& slot(std::size_t index) {
+        std::size_t block, offset;
+        locate(index, block, offset);
+        tuple_type* tuples = i2r[block].load(std::memory_order_acquire);
+        if (tuples == nullptr) {
+            auto lease = grow.acquire();
+            (void)lease;  // avoid warning
+            tuples = i2r[block].load(std::memory_order_relaxed);
+            if (tuples == nullptr) {
+                tuples = new tuple_type[std::size_t(BLOCK_SIZE) << block];
+                i2r[block].store(tuples, std::memory_order_release);
+            }
+        }
+        return tuples[offset];
+    }
 
-    /** The mapping from indices to tuples */
-    block_index_type i2r;
+public:
+    RecordMap() : next(1) {
+        for (auto& block : i2r) {
+            block.store(nullptr, std::memory_order_relaxed);
+        }
+    }
 
-    /** a lock for the pack operation */
-    Lock pack_lock;
+    RecordMap(const RecordMap&) = delete;
+    RecordMap& operator=(const RecordMap&) = delete;
 
-public:
-    RecordMap() = default;
+    ~RecordMap() {
+        for (auto& block : i2r) {
+            delete[] block.load(std::memory_order_relaxed);
+        }
+    }
 
     /**
      * Packs the given tuple -- and may create a new reference if necessary.
      */
     RamDomain pack(const tuple_type& tuple) {
-        RamDomain index;
-
-        {
-            // lock pack operation
-            auto leas = pack_lock.acquire();  // lock hold till end of scope
-            (void)leas;                       // avoid warning
-
-            // try lookup
-            auto pos = r2i.find(tuple);
-            if (pos != r2i.end()) {
-                // take the previously assigned value
-                index = pos->second;
-            } else {
-                // add tuple to index
-                index = r2i.size() + 1;  // since 0 is skipped for the Nil element
-                r2i[tuple] = index;
-
-                // assert that new index is smaller than the range
-                assert(index != std::numeric_limits<RamDomain>::max());
-
-                if (index / BLOCK_SIZE == i2r.size()) {
-                    i2r.push_back(std::make_unique<block_type>());
-                }
-
-                // create entry for unpacking
-                auto& list = i2r[index / BLOCK_SIZE];
-
-                // insert tuple
-                (*list)[index % BLOCK_SIZE] = tuple;
-            }
+        Shard& shard = shardOf(tuple);
+
+        // lock the shard of the tuple only
+        auto lease = shard.access.acquire();  // lock hold till end of scope
+        (void)lease;                          // avoid warning
+
+        // try lookup
+        auto pos = shard.r2i.find(tuple);
+        if (pos != shard.r2i.end()) {
+            // take the previously assigned value
+            return pos->second;
         }
 
+        // store the tuple before publishing its reference
+        RamDomain index = next.fetch_add(1);
+
+        // assert that new index is smaller than the range
+        assert(index != std::numeric_limits<RamDomain>::max());
+
+        slot(index) = tuple;
+        shard.r2i.emplace(tuple, index);
+
         // done
         return index;
     }
@@ -144,9 +192,11 @@ public:
     /**
      * Obtains a pointer to the tuple addressed by the given index.
      */
-    const tuple_type& unpack(RamDomain index) {
+    const tuple_type& unpack(RamDomain index) const {
         // just look up the right spot
-        return (*(i2r[index / BLOCK_SIZE]))[index % BLOCK_SIZE];
+        std::size_t block, offset;
+        locate(index, block, offset);
+        return i2r[block].load(std::memory_order_acquire)[offset];
     }
 };
 
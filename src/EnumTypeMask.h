@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <cassert>
+#include <initializer_list>
 #include <ostream>
 #include <vector>
 
@@ -26,6 +28,11 @@ public:
 			mask(symbolList) {
 	}
 
+	EnumTypeMask(std::initializer_list<bool> symbolList,
+			std::initializer_list<bool> numberList) :
+			mask(symbolList), number_mask(numberList) {
+	}
+
 	size_t getArity() const {
 //		assert(mask.size() == number_mask.size());
 		return mask.size();
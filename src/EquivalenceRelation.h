@@ -23,9 +23,9 @@
 #include "Util.h"
 #include <algorithm>
 #include <exception>
-#include <set>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace souffle {
 template <typename TupleType>
@@ -41,7 +41,7 @@ class EquivalenceRelation {
             souffle::EqrelMapComparator<StorePair>>;
 
 public:
-    EquivalenceRelation() : statesMapStale(false){};
+    EquivalenceRelation() : statesMapStale(false), numPairs(0){};
     ~EquivalenceRelation() {
         emptyPartition();
     }
@@ -91,8 +91,10 @@ public:
         other.genAllDisjointSetLists();
 
         // iterate over partitions at a time
-        for (typename StatesMap::chunk it : other.equivalencePartition.getChunks(MAX_THREADS)) {
-            for (auto& p : it) {
+        auto chunks = other.equivalencePartition.getChunks(MAX_THREADS);
+#pragma omp parallel for schedule(dynamic, 1)
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            for (auto& p : chunks[c]) {
                 value_type rep = p.first;
                 StatesList& pl = *p.second;
                 const size_t ksize = pl.size();
@@ -113,42 +115,56 @@ public:
      */
     void extend(const EquivalenceRelation<TupleType>& other) {
         // nothing to extend if there's no new/original knowledge
-        if (other.size() == 0 || this->size() == 0) return;
+        if (other.sds.size() == 0 || this->sds.size() == 0) return;
 
-        this->genAllDisjointSetLists();
         other.genAllDisjointSetLists();
 
-        std::set<value_type> repsCovered;
-
-        // find all the disjoint sets that need to be added to this relation
-        // that exist in other (and exist in this)
-        {
-            auto it = this->sds.sparseToDenseMap.begin();
-            auto end = this->sds.sparseToDenseMap.end();
-            value_type el;
-            for (; it != end; ++it) {
-                std::tie(el, std::ignore) = *it;
-                if (other.containsElement(el)) {
-                    value_type rep = other.sds.findNode(el);
-                    if (repsCovered.count(rep) == 0) {
-                        repsCovered.emplace(rep);
-                    }
+        // union each disjoint set of other that shares an element with this relation into this one;
+        // the sets of other are disjoint, so the sets unioned by other threads never make a set
+        // appear to intersect with this relation
+        auto chunks = other.equivalencePartition.getChunks(MAX_THREADS);
+#pragma omp parallel for schedule(dynamic, 1)
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            for (auto& p : chunks[c]) {
+                const StatesList& pl = *p.second;
+                const size_t ksize = pl.size();
+                bool intersects = false;
+                for (size_t i = 0; i < ksize && !intersects; ++i) {
+                    intersects = this->containsElement(pl.get(i));
+                }
+                if (!intersects) continue;
+                for (size_t i = 0; i < ksize; ++i) {
+                    this->sds.unionNodes(p.first, pl.get(i));
                 }
             }
         }
 
-        // add the intersecting dj sets into this one
-        {
-            value_type el;
-            value_type rep;
-            auto it = other.sds.sparseToDenseMap.begin();
-            auto end = other.sds.sparseToDenseMap.end();
-            for (; it != end; ++it) {
-                std::tie(el, std::ignore) = *it;
-                rep = other.sds.findNode(el);
-                if (repsCovered.count(rep) != 0) {
-                    this->insert(el, rep);
-                }
+        // invalidate iterators unconditionally
+        this->statesMapStale.store(true, std::memory_order_relaxed);
+    }
+
+    /**
+     * Write the elements of the disjoint sets to consecutive positions, set after set
+     * @param elements receives the elements of all sets
+     * @param offsets receives the position of the first element of each set, followed by the number
+     * of elements
+     */
+    void collectSets(std::vector<value_type>& elements, std::vector<size_t>& offsets) const {
+        genAllDisjointSetLists();
+
+        std::vector<const StatesList*> lists;
+        offsets.assign(1, 0);
+        for (const auto& p : equivalencePartition) {
+            lists.push_back(p.second);
+            offsets.push_back(offsets.back() + p.second->size());
+        }
+
+        elements.resize(offsets.back());
+#pragma omp parallel for schedule(dynamic, 64)
+        for (size_t s = 0; s < lists.size(); ++s) {
+            const size_t ksize = lists[s]->size();
+            for (size_t i = 0; i < ksize; ++i) {
+                elements[offsets[s] + i] = lists[s]->get(i);
             }
         }
     }
@@ -193,14 +209,9 @@ public:
         genAllDisjointSetLists();
 
         statesLock.lock_shared();
-
-        size_t retVal = 0;
-        for (auto& e : this->equivalencePartition) {
-            const size_t s = e.second->size();
-            retVal += s * s;
-        }
-
+        size_t retVal = numPairs;
         statesLock.unlock_shared();
+
         return retVal;
     }
 
@@ -215,8 +226,12 @@ public:
                 : br(br), isEndVal(true){};
 
         explicit iterator(const EquivalenceRelation* br)
-                : br(br), ityp(IterType::ALL), djSetMapListIt(br->equivalencePartition.begin()),
-                  djSetMapListEnd(br->equivalencePartition.end()) {
+                : iterator(br, br->equivalencePartition.begin(), br->equivalencePartition.end()) {}
+
+        // ALL over the disjoint sets within [first, last) (used for EquivalenceRelation.partition())
+        explicit iterator(const EquivalenceRelation* br, typename StatesMap::iterator first,
+                typename StatesMap::iterator last)
+                : br(br), ityp(IterType::ALL), djSetMapListIt(first), djSetMapListEnd(last) {
             // no need to fast forward if this iterator is empty
             if (djSetMapListIt == djSetMapListEnd) {
                 isEndVal = true;
@@ -232,10 +247,16 @@ public:
 
         // WITHIN: iterator for everything within the same DJset (used for EquivalenceRelation.partition())
         explicit iterator(const EquivalenceRelation* br, const StatesBucket within)
-                : br(br), ityp(IterType::WITHIN), djSetList(within) {
+                : iterator(br, within, 0, within->size()) {}
+
+        // WITHIN, restricted to the anterior elements at positions [first, last) of the dj set
+        explicit iterator(const EquivalenceRelation* br, const StatesBucket within, size_t first, size_t last)
+                : br(br), ityp(IterType::WITHIN), djSetList(within), cAnteriorIndex(first),
+                  cAnteriorEnd(last) {
             // empty dj set
-            if (djSetList->size() == 0) {
+            if (cAnteriorIndex >= cAnteriorEnd) {
                 isEndVal = true;
+                return;
             }
 
             updateAnterior();
@@ -371,7 +392,7 @@ public:
                     if (++cPosteriorIndex == djSetList->size()) {
                         // move anterior along one
                         // see if we can't move the anterior along one
-                        if (++cAnteriorIndex == djSetList->size()) {
+                        if (++cAnteriorIndex == cAnteriorEnd) {
                             isEndVal = true;
                             return *this;
                         }
@@ -408,6 +429,8 @@ public:
 
         // used for ALL, and POSTERIOR (just a current index in the cList)
         size_t cAnteriorIndex = 0;
+        // used for WITHIN (the index in the cList past the last anterior)
+        size_t cAnteriorEnd = 0;
         // used for ALL, and ANTERIOR (just a current index in the cList)
         size_t cPosteriorIndex = 0;
     };
@@ -551,28 +574,41 @@ public:
         if (numPairs == 0) return {};
         if (numPairs == 1 || chunks <= 1) return {souffle::make_range(begin(), end())};
 
-        // if there's more dj sets than requested chunks, then just return an iter per dj set
+        // cut the sequence of dj sets into runs of about numPairs/chunks pairs, and split the dj sets
+        // with more pairs than that into runs of anterior elements
         std::vector<souffle::range<iterator>> ret;
-        if (chunks <= equivalencePartition.size()) {
-            for (auto& p : equivalencePartition) {
-                ret.push_back(souffle::make_range(closure(p.first), end()));
-            }
-            return ret;
-        }
-
-        // keep it simple stupid
-        // just go through and if the size of the binrel is > numpairs/chunks, then generate an anteriorIt for
-        // each
-        const size_t perchunk = numPairs / chunks;
-        for (const auto& itp : equivalencePartition) {
-            const size_t s = itp.second->size();
-            if (s * s > perchunk) {
-                for (const auto& i : *itp.second) {
-                    ret.push_back(souffle::make_range(anteriorIt(i), end()));
+        const size_t perchunk = (numPairs + chunks - 1) / chunks;
+        auto first = equivalencePartition.begin();
+        const auto last = equivalencePartition.end();
+        size_t pairs = 0;
+        for (auto it = first; it != last;) {
+            const StatesBucket list = (*it).second;
+            auto next = it;
+            ++next;
+
+            const size_t s = list->size();
+            if (s * s <= perchunk) {
+                pairs += s * s;
+                if (pairs >= perchunk) {
+                    ret.push_back(souffle::make_range(iterator(this, first, next), end()));
+                    first = next;
+                    pairs = 0;
                 }
             } else {
-                ret.push_back(souffle::make_range(closure(itp.first), end()));
+                if (first != it) {
+                    ret.push_back(souffle::make_range(iterator(this, first, it), end()));
+                }
+                const size_t step = std::max<size_t>(1, perchunk / s);
+                for (size_t i = 0; i < s; i += step) {
+                    ret.push_back(souffle::make_range(iterator(this, list, i, std::min(s, i + step)), end()));
+                }
+                first = next;
+                pairs = 0;
             }
+            it = next;
+        }
+        if (first != last) {
+            ret.push_back(souffle::make_range(iterator(this, first, last), end()));
         }
 
         return ret;
@@ -604,12 +640,19 @@ private:
     mutable StatesMap equivalencePartition;
     // whether the cache is stale
     mutable std::atomic<bool> statesMapStale;
+    // the number of pairs, i.e. the sum of the squared sizes of the dj sets in the cache
+    mutable size_t numPairs;
 
     /**
      * Generate a cache of the sets such that they can be iterated over efficiently.
      * Each set is partitioned into a PiggyList.
      */
     void genAllDisjointSetLists() const {
+        // no need to generate again, already done (this check spares concurrent readers the lock)
+        if (!this->statesMapStale.load(std::memory_order_acquire)) {
+            return;
+        }
+
         statesLock.lock();
 
         // no need to generate again, already done.
@@ -621,7 +664,9 @@ private:
         // btree version
         emptyPartition();
 
-        size_t dSetSize = this->sds.ds.a_blocks.size();
+        // both the partition and its lists admit concurrent insertions
+        const size_t dSetSize = this->sds.ds.a_blocks.size();
+#pragma omp parallel for
         for (size_t i = 0; i < dSetSize; ++i) {
             typename TupleType::value_type sparseVal = this->sds.toSparse(i);
             parent_t rep = this->sds.findNode(sparseVal);
@@ -635,6 +680,12 @@ private:
             mapList->append(sparseVal);
         }
 
+        numPairs = 0;
+        for (auto& e : this->equivalencePartition) {
+            const size_t s = e.second->size();
+            numPairs += s * s;
+        }
+
         statesMapStale.store(false, std::memory_order_release);
         statesLock.unlock();
     }
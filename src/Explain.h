@@ -19,6 +19,7 @@
 #include "ExplainProvenanceSLD.h"
 
 #include <csignal>
+#include <fstream>
 #include <iostream>
 #include <regex>
 #include <string>
@@ -104,6 +105,25 @@ public:
                 }
                 std::unique_ptr<TreeNode> t = prov.explain(query.first, query.second, depthLimit);
                 printTree(std::move(t));
+            } else if (command[0] == "explainall") {
+                std::ifstream queries;
+                if (command.size() == 2) {
+                    queries.open(command[1]);
+                }
+                if (!queries.is_open()) {
+                    printStr("Usage: explainall <filename>, with one relation_name(...) per line\n");
+                    continue;
+                }
+                std::vector<std::pair<std::string, std::vector<std::string>>> batch;
+                std::string query;
+                while (getline(queries, query)) {
+                    if (!query.empty()) {
+                        batch.push_back(parseTuple(query));
+                    }
+                }
+                for (auto& t : prov.explainAll(batch, depthLimit)) {
+                    printTree(std::move(t));
+                }
             } else if (command[0] == "subproof") {
                 std::pair<std::string, std::vector<std::string>> query;
                 int label = -1;
@@ -162,6 +182,8 @@ public:
                         "----------\n"
                         "setdepth <depth>: Set a limit for printed derivation tree height\n"
                         "explain <relation>(<element1>, <element2>, ...): Prints derivation tree\n"
+                        "explainall <filename>: Prints derivation trees for the tuples in a file, one "
+                        "<relation>(<element1>, <element2>, ...) per line\n"
                         "subproof <relation>(<label>): Prints derivation tree for a subproof, label is "
                         "generated if a derivation tree exceeds height limit\n"
                         "rule <relation name> <rule number>: Prints a rule\n"
@@ -57,6 +57,16 @@ public:
     virtual std::unique_ptr<TreeNode> explain(
             std::string relName, std::vector<std::string> tuple, size_t depthLimit) = 0;
 
+    /** Explain several tuples, each given by a relation name and arguments, in one pass */
+    virtual std::vector<std::unique_ptr<TreeNode>> explainAll(
+            const std::vector<std::pair<std::string, std::vector<std::string>>>& queries, size_t depthLimit) {
+        std::vector<std::unique_ptr<TreeNode>> trees;
+        for (auto query : queries) {
+            trees.push_back(explain(query.first, query.second, depthLimit));
+        }
+        return trees;
+    }
+
     virtual std::unique_ptr<TreeNode> explainSubproof(
             std::string relName, RamDomain label, size_t depthLimit) = 0;
 
@@ -128,7 +138,7 @@ protected:
     }
 
     std::vector<std::string> numsToArgs(const std::string& relName, const std::vector<RamDomain>& nums,
-            std::vector<bool>* err = nullptr) const {
+            const std::vector<bool>* err = nullptr) const {
         std::vector<std::string> args;
 
         auto rel = prog.getRelation(relName);
@@ -18,6 +18,7 @@
 
 #include "BinaryConstraintOps.h"
 #include "ExplainProvenance.h"
+#include "ParallelUtils.h"
 #include "Util.h"
 
 #include <algorithm>
@@ -26,6 +27,7 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace souffle {
@@ -87,14 +89,12 @@ public:
             tuple.push_back(levelNum);
 
             // find if subproof exists already
-            size_t idx = 0;
-            auto it = std::find(subproofs.begin(), subproofs.end(), tuple);
-            if (it != subproofs.end()) {
-                idx = it - subproofs.begin();
-            } else {
+            auto it = subproofIndex.find(tuple);
+            if (it == subproofIndex.end()) {
+                it = subproofIndex.emplace(tuple, subproofs.size()).first;
                 subproofs.push_back(tuple);
-                idx = subproofs.size() - 1;
             }
+            size_t idx = it->second;
 
             return std::make_unique<LeafNode>("subproof " + relName + "(" + std::to_string(idx) + ")");
         }
@@ -102,81 +102,35 @@ public:
         auto internalNode = std::make_unique<InnerNode>(
                 relName + "(" + joinedArgsStr + ")", "(R" + std::to_string(ruleNum) + ")");
 
-        // make return vector pointer
-        std::vector<RamDomain> ret;
-        std::vector<bool> err;
-
-        // add level number to tuple
-        tuple.push_back(levelNum);
-
-        // execute subroutine to get subproofs
-        prog.executeSubroutine(relName + "_" + std::to_string(ruleNum) + "_subproof", tuple, ret, err);
-
         // recursively get nodes for subproofs
-        size_t tupleCurInd = 0;
-        for (std::string bodyRel : info[std::make_pair(relName, ruleNum)]) {
-            // check whether the current atom is a constraint
-            bool isConstraint =
-                    std::find(constraintList.begin(), constraintList.end(), bodyRel) != constraintList.end();
-
-            // handle negated atom names
-            auto bodyRelAtomName = bodyRel;
-            if (bodyRel[0] == '!') {
-                bodyRelAtomName = bodyRel.substr(1);
-            }
-
-            // traverse subroutine return
-            size_t arity;
-            if (isConstraint) {
-                // we only handle binary constraints, and assume arity is 4 to account for hidden provenance
-                // annotations
-                arity = 4;
-            } else {
-                arity = prog.getRelation(bodyRelAtomName)->getArity();
-            }
-            auto tupleEnd = tupleCurInd + arity;
-
-            // store current tuple and error
-            std::vector<RamDomain> subproofTuple;
-            std::vector<bool> subproofTupleError;
-
-            for (; tupleCurInd < tupleEnd - 2; tupleCurInd++) {
-                subproofTuple.push_back(ret[tupleCurInd]);
-                subproofTupleError.push_back(err[tupleCurInd]);
-            }
-
-            int subproofRuleNum = ret[tupleCurInd];
-            int subproofLevelNum = ret[tupleCurInd + 1];
-
+        const Subproof& subproof = getSubproof(relName, tuple, ruleNum, levelNum);
+        for (const BodyTuple& body : getBodyTuples(relName, ruleNum, subproof)) {
             // for a negation, display the corresponding tuple and do not recurse
-            if (bodyRel[0] == '!') {
+            if (body.rel[0] == '!') {
                 std::stringstream joinedTuple;
-                joinedTuple << join(numsToArgs(bodyRelAtomName, subproofTuple, &subproofTupleError), ", ");
+                joinedTuple << join(numsToArgs(body.rel.substr(1), body.tuple, &body.err), ", ");
                 auto joinedTupleStr = joinedTuple.str();
-                internalNode->add_child(std::make_unique<LeafNode>(bodyRel + "(" + joinedTupleStr + ")"));
+                internalNode->add_child(std::make_unique<LeafNode>(body.rel + "(" + joinedTupleStr + ")"));
                 internalNode->setSize(internalNode->getSize() + 1);
                 // for a binary constraint, display the corresponding values and do not recurse
-            } else if (isConstraint) {
+            } else if (body.isConstraint) {
                 std::stringstream joinedConstraint;
 
-                if (isNumericBinaryConstraintOp(toBinaryConstraintOp(bodyRel))) {
-                    joinedConstraint << subproofTuple[0] << " " << bodyRel << " " << subproofTuple[1];
+                if (isNumericBinaryConstraintOp(toBinaryConstraintOp(body.rel))) {
+                    joinedConstraint << body.tuple[0] << " " << body.rel << " " << body.tuple[1];
                 } else {
-                    joinedConstraint << bodyRel << "(\"" << prog.getSymbolTable().resolve(subproofTuple[0])
-                                     << "\", \"" << prog.getSymbolTable().resolve(subproofTuple[1]) << "\")";
+                    joinedConstraint << body.rel << "(\"" << prog.getSymbolTable().resolve(body.tuple[0])
+                                     << "\", \"" << prog.getSymbolTable().resolve(body.tuple[1]) << "\")";
                 }
 
                 internalNode->add_child(std::make_unique<LeafNode>(joinedConstraint.str()));
                 internalNode->setSize(internalNode->getSize() + 1);
                 // otherwise, for a normal tuple, recurse
             } else {
-                auto child =
-                        explain(bodyRel, subproofTuple, subproofRuleNum, subproofLevelNum, depthLimit - 1);
+                auto child = explain(body.rel, body.tuple, body.ruleNum, body.levelNum, depthLimit - 1);
                 internalNode->setSize(internalNode->getSize() + child->getSize());
                 internalNode->add_child(std::move(child));
             }
-
-            tupleCurInd = tupleEnd;
         }
 
         return std::move(internalNode);
@@ -197,7 +151,48 @@ public:
             return std::make_unique<LeafNode>("Tuple not found");
         }
 
-        return explain(relName, tuple, ruleNum, levelNum, depthLimit);
+        return explainInParallel(relName, tuple, ruleNum, levelNum, depthLimit);
+    }
+
+    std::vector<std::unique_ptr<TreeNode>> explainAll(
+            const std::vector<std::pair<std::string, std::vector<std::string>>>& queries,
+            size_t depthLimit) override {
+        // find the rule and level numbers of the queried tuples with one scan per relation
+        std::vector<std::vector<RamDomain>> tuples;
+        std::vector<std::pair<int, int>> tupleInfos;
+        for (auto query : queries) {
+            tuples.push_back(argsToNums(query.first, query.second));
+            std::pair<int, int> tupleInfo(-1, -1);
+            if (!tuples.back().empty()) {
+                tupleInfo = findTuple(query.first, tuples.back());
+            }
+            tupleInfos.push_back(tupleInfo);
+        }
+
+        // search the subproofs of all tuples in parallel
+#pragma omp parallel
+#pragma omp single
+        for (size_t i = 0; i < queries.size(); i++) {
+            if (tupleInfos[i].first >= 0 && tupleInfos[i].second != -1) {
+#pragma omp task firstprivate(i)
+                searchSubproofs(queries[i].first, tuples[i], tupleInfos[i].first, tupleInfos[i].second,
+                        depthLimit);
+            }
+        }
+
+        // build the trees in order, from the cached subproofs
+        std::vector<std::unique_ptr<TreeNode>> trees;
+        for (size_t i = 0; i < queries.size(); i++) {
+            if (tuples[i].empty()) {
+                trees.push_back(std::make_unique<LeafNode>("Relation not found"));
+            } else if (tupleInfos[i].first < 0 || tupleInfos[i].second == -1) {
+                trees.push_back(std::make_unique<LeafNode>("Tuple not found"));
+            } else {
+                trees.push_back(explain(
+                        queries[i].first, tuples[i], tupleInfos[i].first, tupleInfos[i].second, depthLimit));
+            }
+        }
+        return trees;
     }
 
     std::unique_ptr<TreeNode> explainSubproof(
@@ -212,7 +207,7 @@ public:
         RamDomain ruleNum = tup.back();
         tup.pop_back();
 
-        return explain(relName, tup, ruleNum, levelNum, depthLimit);
+        return explainInParallel(relName, tup, ruleNum, levelNum, depthLimit);
     }
 
     std::string getRule(std::string relName, size_t ruleNum) override {
@@ -252,19 +247,7 @@ public:
                 continue;
             }
 
-            std::vector<RamDomain> currentTuple;
-            for (size_t i = 0; i < rel->getArity() - 2; i++) {
-                RamDomain n;
-                if (*rel->getAttrType(i) == 's') {
-                    std::string s;
-                    tuple >> s;
-                    n = prog.getSymbolTable().lookupExisting(s.c_str());
-                } else {
-                    tuple >> n;
-                }
-
-                currentTuple.push_back(n);
-            }
+            std::vector<RamDomain> currentTuple = readTuple(*rel, tuple);
 
             RamDomain ruleNum;
             tuple >> ruleNum;
@@ -308,55 +291,233 @@ public:
     }
 
 private:
+    /** Hash function of tuples */
+    struct TupleHash {
+        size_t operator()(const std::vector<RamDomain>& tuple) const {
+            size_t res = 0;
+            for (RamDomain value : tuple) {
+                // from boost hash combine
+                res ^= std::hash<RamDomain>()(value) + 0x9e3779b9 + (res << 6) + (res >> 2);
+            }
+            return res;
+        }
+    };
+
+    /** A relation name with a tuple, followed by its rule and level number */
+    using SubproofKey = std::pair<std::string, std::vector<RamDomain>>;
+
+    /** Hash function of subproof keys */
+    struct SubproofHash {
+        size_t operator()(const SubproofKey& key) const {
+            return std::hash<std::string>()(key.first) ^ (TupleHash()(key.second) << 1);
+        }
+    };
+
+    /** The tuples returned by a subproof subroutine, with their error flags */
+    struct Subproof {
+        std::vector<RamDomain> ret;
+        std::vector<bool> err;
+    };
+
+    /** A tuple of a body atom of a subproof, with the rule and level number of its own proof */
+    struct BodyTuple {
+        // the atom, prefixed by '!' if negated, or the constraint operator
+        std::string rel;
+        bool isConstraint;
+        std::vector<RamDomain> tuple;
+        std::vector<bool> err;
+        int ruleNum;
+        int levelNum;
+    };
+
+    /** The rule and level numbers of the tuples of a relation */
+    using TupleIndex = std::unordered_map<std::vector<RamDomain>, std::pair<int, int>, TupleHash>;
+
+    /** indexes of the relations queried so far, which do not change after the evaluation */
+    std::map<std::string, TupleIndex> tupleIndexes;
+
     std::map<std::pair<std::string, size_t>, std::vector<std::string>> info;
     std::map<std::pair<std::string, size_t>, std::string> rules;
     std::vector<std::vector<RamDomain>> subproofs;
+    std::unordered_map<std::vector<RamDomain>, size_t, TupleHash> subproofIndex;
     std::vector<std::string> constraintList = {
             "=", "!=", "<", "<=", ">=", ">", "match", "contains", "not_match", "not_contains"};
 
-    std::pair<int, int> findTuple(const std::string& relName, std::vector<RamDomain> tup) {
-        auto rel = prog.getRelation(relName);
+    /** results of the subproof subroutines, shared by the proof trees of all queries */
+    std::unordered_map<SubproofKey, Subproof, SubproofHash> subproofCache;
+
+    /** lock for the subproof cache */
+    Lock subproofLock;
+
+    /**
+     * Obtain the result of the subproof subroutine of a tuple, executing it unless cached
+     */
+    const Subproof& getSubproof(
+            const std::string& relName, const std::vector<RamDomain>& tuple, int ruleNum, int levelNum) {
+        SubproofKey key(relName, tuple);
+        key.second.push_back(ruleNum);
+        key.second.push_back(levelNum);
+        {
+            auto lease = subproofLock.acquire();
+            (void)lease;  // avoid warning
+            auto pos = subproofCache.find(key);
+            if (pos != subproofCache.end()) {
+                return pos->second;
+            }
+        }
 
-        if (rel == nullptr) {
-            return std::make_pair(-1, -1);
+        // execute subroutine to get subproofs, without holding the lock
+        Subproof subproof;
+        std::vector<RamDomain> args(tuple);
+        args.push_back(levelNum);
+        prog.executeSubroutine(
+                relName + "_" + std::to_string(ruleNum) + "_subproof", args, subproof.ret, subproof.err);
+
+        // elements of the cache stay in place while it grows
+        auto lease = subproofLock.acquire();
+        (void)lease;  // avoid warning
+        return subproofCache.emplace(std::move(key), std::move(subproof)).first->second;
+    }
+
+    /**
+     * Split the result of a subproof subroutine into the tuples of the body atoms of the rule
+     */
+    std::vector<BodyTuple> getBodyTuples(const std::string& relName, int ruleNum, const Subproof& subproof) {
+        std::vector<BodyTuple> bodies;
+        auto bodyRels = info.find(std::make_pair(relName, ruleNum));
+        if (bodyRels == info.end()) {
+            return bodies;
         }
 
-        // find correct tuple
-        for (auto& tuple : *rel) {
-            bool match = true;
-            std::vector<RamDomain> currentTuple;
-
-            for (size_t i = 0; i < rel->getArity() - 2; i++) {
-                RamDomain n;
-                if (*rel->getAttrType(i) == 's') {
-                    std::string s;
-                    tuple >> s;
-                    n = prog.getSymbolTable().lookupExisting(s);
-                } else {
-                    tuple >> n;
-                }
+        size_t tupleCurInd = 0;
+        for (const std::string& bodyRel : bodyRels->second) {
+            BodyTuple body;
+            body.rel = bodyRel;
 
-                currentTuple.push_back(n);
+            // check whether the current atom is a constraint
+            body.isConstraint =
+                    std::find(constraintList.begin(), constraintList.end(), bodyRel) != constraintList.end();
 
-                if (n != tup[i]) {
-                    match = false;
-                    break;
-                }
+            // traverse subroutine return
+            size_t arity;
+            if (body.isConstraint) {
+                // we only handle binary constraints, and assume arity is 4 to account for hidden provenance
+                // annotations
+                arity = 4;
+            } else {
+                // handle negated atom names
+                arity = prog.getRelation(bodyRel[0] == '!' ? bodyRel.substr(1) : bodyRel)->getArity();
             }
+            auto tupleEnd = tupleCurInd + arity;
 
-            if (match) {
-                RamDomain ruleNum;
-                tuple >> ruleNum;
+            for (; tupleCurInd < tupleEnd - 2; tupleCurInd++) {
+                body.tuple.push_back(subproof.ret[tupleCurInd]);
+                body.err.push_back(subproof.err[tupleCurInd]);
+            }
 
-                RamDomain levelNum;
-                tuple >> levelNum;
+            body.ruleNum = subproof.ret[tupleCurInd];
+            body.levelNum = subproof.ret[tupleCurInd + 1];
 
-                return std::make_pair(ruleNum, levelNum);
+            bodies.push_back(std::move(body));
+            tupleCurInd = tupleEnd;
+        }
+
+        return bodies;
+    }
+
+    /**
+     * Execute the subproof subroutines of the proof tree of a tuple, the searches for sibling
+     * subproofs as parallel tasks, such that the tree is then built from the subproof cache
+     */
+    void searchSubproofs(const std::string& relName, const std::vector<RamDomain>& tuple, int ruleNum,
+            int levelNum, size_t depthLimit) {
+        if (levelNum == 0 || depthLimit <= 1) {
+            return;
+        }
+
+        std::vector<BodyTuple> bodies =
+                getBodyTuples(relName, ruleNum, getSubproof(relName, tuple, ruleNum, levelNum));
+        for (size_t i = 0; i < bodies.size(); i++) {
+            if (bodies[i].rel[0] == '!' || bodies[i].isConstraint) {
+                continue;
             }
+#pragma omp task shared(bodies) firstprivate(i)
+            searchSubproofs(bodies[i].rel, bodies[i].tuple, bodies[i].ruleNum, bodies[i].levelNum,
+                    depthLimit - 1);
         }
+#pragma omp taskwait
+    }
+
+    /**
+     * Explain a tuple, searching its subproofs in parallel first
+     */
+    std::unique_ptr<TreeNode> explainInParallel(const std::string& relName,
+            const std::vector<RamDomain>& tuple, int ruleNum, int levelNum, size_t depthLimit) {
+#pragma omp parallel
+#pragma omp single
+        searchSubproofs(relName, tuple, ruleNum, levelNum, depthLimit);
+
+        return explain(relName, tuple, ruleNum, levelNum, depthLimit);
+    }
 
-        // if no tuple exists
-        return std::make_pair(-1, -1);
+    /**
+     * Read the values of a tuple of a relation with provenance annotations, which are left in the tuple
+     */
+    std::vector<RamDomain> readTuple(const Relation& rel, tuple& tup) {
+        std::vector<RamDomain> values;
+        for (size_t i = 0; i < rel.getArity() - 2; i++) {
+            RamDomain n;
+            if (*rel.getAttrType(i) == 's') {
+                std::string s;
+                tup >> s;
+                n = prog.getSymbolTable().lookupExisting(s);
+            } else {
+                tup >> n;
+            }
+            values.push_back(n);
+        }
+        return values;
+    }
+
+    /**
+     * Index the rule and level numbers of all tuples of a relation
+     */
+    TupleIndex indexTuples(const std::string& relName) {
+        TupleIndex index;
+        auto rel = prog.getRelation(relName);
+        if (rel == nullptr) {
+            return index;
+        }
+
+        for (auto& tuple : *rel) {
+            std::vector<RamDomain> values = readTuple(*rel, tuple);
+
+            RamDomain ruleNum;
+            tuple >> ruleNum;
+
+            RamDomain levelNum;
+            tuple >> levelNum;
+
+            index.emplace(std::move(values), std::make_pair(ruleNum, levelNum));
+        }
+        return index;
+    }
+
+    /**
+     * Find the rule and level numbers of a tuple, through the index of its relation built on first use
+     */
+    std::pair<int, int> findTuple(const std::string& relName, const std::vector<RamDomain>& tup) {
+        auto index = tupleIndexes.find(relName);
+        if (index == tupleIndexes.end()) {
+            index = tupleIndexes.emplace(relName, indexTuples(relName)).first;
+        }
+
+        auto pos = index->second.find(tup);
+        if (pos == index->second.end()) {
+            // if no tuple exists
+            return std::make_pair(-1, -1);
+        }
+        return pos->second;
     }
 
     void printRelationOutput(
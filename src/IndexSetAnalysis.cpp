@@ -21,8 +21,10 @@
 #include "RamNode.h"
 #include "RamOperation.h"
 #include "RamProvenanceExistenceCheckAnalysis.h"
+#include "RamStatement.h"
 #include "RamTranslationUnit.h"
 #include "RamVisitor.h"
+#include "RelationRepresentation.h"
 #include <cstdint>
 #include <cstdlib>
 #include <iostream>
@@ -298,6 +300,23 @@ void IndexSetAnalysis::run(const RamTranslationUnit& translationUnit) {
         } else if (const auto* provExists = dynamic_cast<const RamProvenanceExistenceCheck*>(&node)) {
             IndexSet& indexes = getIndexes(provExists->getRelation());
             indexes.addSearch(provExistCheckAnalysis->getKey(provExists));
+        } else if (const auto* subsumption = dynamic_cast<const RamSubsumptionCheck*>(&node)) {
+            getIndexes(subsumption->getRelation()).addSearch(getCellKey(subsumption->getRelation()));
+        } else if (const auto* saturation = dynamic_cast<const RamSaturationCheck*>(&node)) {
+            getIndexes(saturation->getRelation()).addSearch(getCellKey(saturation->getRelation()));
+        } else if (const auto* latNorm = dynamic_cast<const RamLatNorm*>(&node)) {
+            // cells are looked up by the key columns, i.e. all but the lattice column
+            getIndexes(latNorm->getRelation_IN_Rel()).addSearch(getCellKey(latNorm->getRelation_IN_Rel()));
+            getIndexes(latNorm->getRelation_OUT_Rel()).addSearch(getCellKey(latNorm->getRelation_OUT_Rel()));
+        } else if (const auto* latClean = dynamic_cast<const RamLatClean*>(&node)) {
+            getIndexes(latClean->getRelation_IN_Origin())
+                    .addSearch(getCellKey(latClean->getRelation_IN_Origin()));
+            getIndexes(latClean->getRelation_IN_New()).addSearch(getCellKey(latClean->getRelation_IN_New()));
+        } else if (const auto* create = dynamic_cast<const RamCreate*>(&node)) {
+            // keyed lattice relations join on insertion, which looks up the cell
+            if (create->getRelation().getRepresentation() == RelationRepresentation::LATTICE) {
+                getIndexes(create->getRelation()).addSearch(getCellKey(create->getRelation()));
+            }
         }
     });
 
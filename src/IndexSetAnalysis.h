@@ -262,6 +262,11 @@ public:
     }
 
 private:
+    /** get the search for the cell of a lattice relation, i.e. its key columns */
+    static SearchColumns getCellKey(const RamRelationReference& rel) {
+        return (SearchColumns(1) << (rel.getArity() - 1)) - 1;
+    }
+
     std::map<std::string, IndexSet> data;
 };
 
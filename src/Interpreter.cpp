@@ -21,6 +21,7 @@
 #include "Global.h"
 #include "IODirectives.h"
 #include "IOSystem.h"
+#include "IndexSetAnalysis.h"
 #include "InterpreterIndex.h"
 #include "InterpreterRecords.h"
 #include "Logger.h"
@@ -42,6 +43,8 @@
 #include "Util.h"
 #include "WriteStream.h"
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
@@ -54,365 +57,528 @@
 #include <sstream>
 #include <stdexcept>
 #include <typeinfo>
+#include <unordered_map>
 #include <utility>
 #include <ffi.h>
 #include "RamLatticeFunction.h"
 
 namespace souffle {
 
-/** Evaluate RAM Value */
+/** Call site of a user-defined functor with its symbol and prepared ffi call */
+struct FunctorCallSite {
+	std::atomic<void (*)()> fn { nullptr };
+	ffi_cif cif;
+	std::vector<ffi_type*> args;
+
+	/** lock for binding the functor, which the threads of a parallel query may call first at once */
+	Lock bindLock;
+};
+
+/** Get the shared call site of a user-defined functor */
+std::shared_ptr<FunctorCallSite> Interpreter::getCallSite(
+		const RamUserDefinedOperator& op) {
+	auto lease = callSitesLock.acquire();
+	(void) lease;
+	std::shared_ptr<FunctorCallSite>& site = callSites[&op];
+	if (!site) {
+		site = std::make_shared<FunctorCallSite>();
+	}
+	return site;
+}
+
+/** Evaluate RAM Value of a statement, lowered with the statement */
 RamDomain Interpreter::evalVal(const RamValue& value,
 		const InterpreterContext& ctxt) {
-	class ValueEvaluator: public RamVisitor<RamDomain> {
+	auto pos = values.find(&value);
+	assert(pos != values.end() && "value not lowered");
+	return pos->second(ctxt);
+}
+
+/** Evaluate RAM Condition of a statement, lowered with the statement */
+bool Interpreter::evalCond(const RamCondition& cond,
+		const InterpreterContext& ctxt) {
+	auto pos = conditions.find(&cond);
+	assert(pos != conditions.end() && "condition not lowered");
+	return pos->second(ctxt);
+}
+
+namespace {
+
+/** Lower a unary operator applied to the closure of its argument */
+template<typename Closure, typename F>
+Closure lowerUnary(const Closure& arg, F f) {
+	return [arg, f](const InterpreterContext& ctxt) {
+		return f(arg(ctxt));
+	};
+}
+
+/** Lower a binary operator applied to the closures of its arguments */
+template<typename Result, typename Closure, typename F>
+Result lowerBinary(const std::vector<Closure>& args, F f) {
+	Closure lhs = args[0];
+	Closure rhs = args[1];
+	return [lhs, rhs, f](const InterpreterContext& ctxt) {
+		auto x = lhs(ctxt);
+		return f(x, rhs(ctxt));
+	};
+}
+
+/** Number of chunks a parallel loop splits its range into */
+const size_t PARALLEL_CHUNKS = 400;
+
+/** Run the closure of a loop body for each tuple of the chunks of a range,
+ *  spread over all threads; each thread binds the tuples in its own copy of
+ *  the context */
+template<typename Chunks, typename Closure>
+void forEachInParallel(const Chunks& chunks, size_t identifier,
+		const Closure& nested, const InterpreterContext& ctxt) {
+#pragma omp parallel
+	{
+		InterpreterContext local(ctxt);
+#pragma omp for schedule(dynamic, 1)
+		for (size_t i = 0; i < chunks.size(); i++) {
+			for (auto it = chunks[i].first; it != chunks[i].second; ++it) {
+				local[identifier] = *it;
+				nested(local);
+			}
+		}
+	}
+}
+
+/** Results of an aggregate by the values of its bound columns, remembered for
+ *  one version of the aggregated relation and shared by all threads */
+class AggregateMemo {
+public:
+	/** Maximal number of bound columns of a remembered aggregate */
+	static const size_t MAX_BOUND = 4;
+
+	/** Values of the bound columns, stored inline and padded with zeros */
+	using Key = std::array<RamDomain, MAX_BOUND>;
+
+	/** Look up the result for the given bound values, false if unknown */
+	bool lookup(const InterpreterRelation& rel, const Key& key, RamDomain& res) {
+		lock.start_read();
+		bool found = false;
+		if (rel.getVersion() == version) {
+			auto pos = results.find(key);
+			if (pos != results.end()) {
+				res = pos->second;
+				found = true;
+			}
+		}
+		lock.end_read();
+		return found;
+	}
+
+	/** Remember the result for the given bound values */
+	void store(const InterpreterRelation& rel, const Key& key, RamDomain res) {
+		lock.start_write();
+		if (rel.getVersion() != version || results.size() >= MAX_RESULTS) {
+			results.clear();
+			version = rel.getVersion();
+		}
+		results[key] = res;
+		lock.end_write();
+	}
+
+private:
+	static const size_t MAX_RESULTS = 1 << 16;
+
+	struct KeyHash {
+		size_t operator()(const Key& key) const {
+			size_t res = 0;
+			for (RamDomain value : key) {
+				res = res * 1000003 ^ std::hash<RamDomain>()(value);
+			}
+			return res;
+		}
+	};
+
+	ReadWriteLock lock;
+	size_t version = 0;
+	std::unordered_map<Key, RamDomain, KeyHash> results;
+};
+
+/** Check whether a value is a function of the tuple bound to the given
+ *  identifier only, such that its aggregate can be remembered */
+bool isFunctionOf(const RamValue& value, size_t identifier) {
+	bool res = true;
+	visitDepthFirst(value, [&](const RamNode& node) {
+		if (const auto* access = dynamic_cast<const RamElementAccess*>(&node)) {
+			res = res && access->getIdentifier() == identifier;
+		} else if (!dynamic_cast<const RamNumber*>(&node)
+				&& !dynamic_cast<const RamIntrinsicOperator*>(&node)) {
+			res = false;
+		}
+	});
+	return res;
+}
+
+}  // namespace
+
+/** Lower RAM value into a closure */
+Interpreter::ValueClosure Interpreter::compileVal(const RamValue& value) {
+	class ValueCompiler: public RamVisitor<ValueClosure> {
 		Interpreter& interpreter;
-		const InterpreterContext& ctxt;
 
 	public:
-		ValueEvaluator(Interpreter& interp, const InterpreterContext& ctxt) :
-				interpreter(interp), ctxt(ctxt) {
+		ValueCompiler(Interpreter& interp) :
+				interpreter(interp) {
 		}
 
-		RamDomain visitNumber(const RamNumber& num) override {
-			return num.getConstant();
+		ValueClosure visitNumber(const RamNumber& num) override {
+			RamDomain constant = num.getConstant();
+			return [constant](const InterpreterContext&) {
+				return constant;
+			};
 		}
 
-		RamDomain visitElementAccess(const RamElementAccess& access) override {
-			return ctxt[access.getIdentifier()][access.getElement()];
+		ValueClosure visitElementAccess(const RamElementAccess& access)
+				override {
+			size_t identifier = access.getIdentifier();
+			size_t element = access.getElement();
+			return [identifier, element](const InterpreterContext& ctxt) {
+				return ctxt[identifier][element];
+			};
 		}
 
-		RamDomain visitLatticeGLB(const RamLatticeGLB& latGLB) override {
-//			std::cout << "visit RamLatticeGLB here! ";
-			InterpreterContext ctxt_temp;
+		ValueClosure visitLatticeGLB(const RamLatticeGLB& latGLB) override {
+			Interpreter* interp = &interpreter;
 			const RamLatticeBinaryFunction& glb_func =
 					interpreter.getTranslationUnit().getProgram()->getLattice()->getGLB();
-
 			const auto* refs = latGLB.getRefs();
-			auto it = refs->begin();
-			RamDomain res = ctxt[it->identifier][it->element];
-//			std::cout << "it->identifier:" << it->identifier << ",it->element:" << it->element << "\n";
-//			std::cout << "res: " << res << "\n";
-			it++;
-//			std::cout << "refs size:" << refs->size() << "\n";
-			while (it != refs->end()) {
-//				std::cout << "it->identifier:" << it->identifier << ",it->element:" << it->element << "\n";
-				RamDomain it_r = ctxt[it->identifier][it->element];
-//				std::cout << "last_res: " << res <<" ,it_r: " << it_r << "\n";
-				// TODO
-				// set 2 input variables
-				std::vector<RamDomain> args = { res, it_r };
-				ctxt_temp.setArguments(args);
-
-				// evaluate binary constraint
-				for (const auto& cas : glb_func.getLatCase()) {
-					if (cas.match == nullptr
-							|| interpreter.evalCond(*cas.match, ctxt_temp)) {
-						// get output if match
-						res = interpreter.evalVal(*cas.output, ctxt_temp);
-						break;
-					}
+			return [interp, &glb_func, refs](const InterpreterContext& ctxt) {
+				auto it = refs->begin();
+				RamDomain res = ctxt[it->identifier][it->element];
+				for (++it; it != refs->end(); ++it) {
+					res = interp->evalLatticeBinaryFunction(glb_func, res,
+							ctxt[it->identifier][it->element]);
 				}
-				it++;
-			}
-//			std::cout << "visit RamLatticeGLB finish, res:" << res << "\n";
-			return res;
+				return res;
+			};
 		}
 
-		RamDomain visitQuestionMark(const RamQuestionMark& qmark) override {
-			if (interpreter.evalCond(qmark.getCondition(), ctxt)) {
-//				std::cout<<"visitQuestionMark: cond pass\n";
-				return interpreter.evalVal(qmark.getFirstRet(), ctxt);
-			} else {
-//				std::cout<<"visitQuestionMark: cond fail\n";
-				return interpreter.evalVal(qmark.getSecondRet(), ctxt);
-			}
-			return 0;
+		ValueClosure visitQuestionMark(const RamQuestionMark& qmark) override {
+			ConditionClosure cond = interpreter.compileCond(
+					qmark.getCondition());
+			ValueClosure first = visit(qmark.getFirstRet());
+			ValueClosure second = visit(qmark.getSecondRet());
+			return [cond, first, second](const InterpreterContext& ctxt) {
+				return cond(ctxt) ? first(ctxt) : second(ctxt);
+			};
 		}
 
-		RamDomain visitAutoIncrement(const RamAutoIncrement&) override {
-			return interpreter.incCounter();
+		ValueClosure visitAutoIncrement(const RamAutoIncrement&) override {
+			Interpreter* interp = &interpreter;
+			return [interp](const InterpreterContext&) {
+				return interp->incCounter();
+			};
 		}
 
 		// intrinsic functors
-		RamDomain visitIntrinsicOperator(const RamIntrinsicOperator& op)
+		ValueClosure visitIntrinsicOperator(const RamIntrinsicOperator& op)
 				override {
-			const auto& args = op.getArguments();
+			SymbolTable* symbols = &interpreter.getSymbolTable();
+			std::vector<ValueClosure> args;
+			for (const RamValue* arg : op.getArguments()) {
+				args.push_back(visit(arg));
+			}
 
 			switch (op.getOperator()) {
 			/** Unary Functor Operators */
 			case FunctorOp::ORD:
-				return visit(args[0]);
-			case FunctorOp::STRLEN:
-				return interpreter.getSymbolTable().resolve(visit(args[0])).size();
+				return args[0];
 			case FunctorOp::NEG:
-				return -visit(args[0]);
+				return lowerUnary(args[0], [](RamDomain x) {return -x;});
 			case FunctorOp::BNOT:
-				return ~visit(args[0]);
+				return lowerUnary(args[0], [](RamDomain x) {return ~x;});
 			case FunctorOp::LNOT:
-				return !visit(args[0]);
-			case FunctorOp::TONUMBER: {
-				RamDomain result = 0;
-				try {
-					result = stord(
-							interpreter.getSymbolTable().resolve(
-									visit(args[0])));
-				} catch (...) {
-					std::cerr << "error: wrong string provided by to_number(\"";
-					std::cerr
-							<< interpreter.getSymbolTable().resolve(
-									visit(args[0]));
-					std::cerr << "\") functor.\n";
-					raise(SIGFPE);
-				}
-				return result;
-			}
-			case FunctorOp::TOSTRING:
-				return interpreter.getSymbolTable().lookup(
-						std::to_string(visit(args[0])));
+				return lowerUnary(args[0],
+						[](RamDomain x) {return (RamDomain) !x;});
 
 				/** Binary Functor Operators */
-			case FunctorOp::ADD: {
-				return visit(args[0]) + visit(args[1]);
-			}
-			case FunctorOp::SUB: {
-				return visit(args[0]) - visit(args[1]);
-			}
-			case FunctorOp::MUL: {
-				return visit(args[0]) * visit(args[1]);
-			}
-			case FunctorOp::DIV: {
-				return visit(args[0]) / visit(args[1]);
-			}
-			case FunctorOp::EXP: {
-				return std::pow(visit(args[0]), visit(args[1]));
-			}
-			case FunctorOp::MOD: {
-				return visit(args[0]) % visit(args[1]);
-			}
-			case FunctorOp::BAND: {
-				return visit(args[0]) & visit(args[1]);
-			}
-			case FunctorOp::BOR: {
-				return visit(args[0]) | visit(args[1]);
-			}
-			case FunctorOp::BXOR: {
-				return visit(args[0]) ^ visit(args[1]);
-			}
+			case FunctorOp::ADD:
+				return lowerBinary<ValueClosure>(args,
+						[](RamDomain x, RamDomain y) {return x + y;});
+			case FunctorOp::SUB:
+				return lowerBinary<ValueClosure>(args,
+						[](RamDomain x, RamDomain y) {return x - y;});
+			case FunctorOp::MUL:
+				return lowerBinary<ValueClosure>(args,
+						[](RamDomain x, RamDomain y) {return x * y;});
+			case FunctorOp::DIV:
+				return lowerBinary<ValueClosure>(args,
+						[](RamDomain x, RamDomain y) {return x / y;});
+			case FunctorOp::EXP:
+				return lowerBinary<ValueClosure>(args,
+						[](RamDomain x, RamDomain y) {return (RamDomain) std::pow(x, y);});
+			case FunctorOp::MOD:
+				return lowerBinary<ValueClosure>(args,
+						[](RamDomain x, RamDomain y) {return x % y;});
+			case FunctorOp::BAND:
+				return lowerBinary<ValueClosure>(args,
+						[](RamDomain x, RamDomain y) {return x & y;});
+			case FunctorOp::BOR:
+				return lowerBinary<ValueClosure>(args,
+						[](RamDomain x, RamDomain y) {return x | y;});
+			case FunctorOp::BXOR:
+				return lowerBinary<ValueClosure>(args,
+						[](RamDomain x, RamDomain y) {return x ^ y;});
 			case FunctorOp::LAND: {
-				return visit(args[0]) && visit(args[1]);
+				ValueClosure lhs = args[0];
+				ValueClosure rhs = args[1];
+				return [lhs, rhs](const InterpreterContext& ctxt) {
+					return (RamDomain) (lhs(ctxt) && rhs(ctxt));
+				};
 			}
 			case FunctorOp::LOR: {
-				return visit(args[0]) || visit(args[1]);
-			}
-			case FunctorOp::MAX: {
-				return std::max(visit(args[0]), visit(args[1]));
-			}
-			case FunctorOp::MIN: {
-				return std::min(visit(args[0]), visit(args[1]));
-			}
-			case FunctorOp::CAT: {
-				return interpreter.getSymbolTable().lookup(
-						interpreter.getSymbolTable().resolve(visit(args[0]))
-								+ interpreter.getSymbolTable().resolve(
-										visit(args[1])));
-			}
-
-				/** Ternary Functor Operators */
+				ValueClosure lhs = args[0];
+				ValueClosure rhs = args[1];
+				return [lhs, rhs](const InterpreterContext& ctxt) {
+					return (RamDomain) (lhs(ctxt) || rhs(ctxt));
+				};
+			}
+			case FunctorOp::MAX:
+				return lowerBinary<ValueClosure>(args,
+						[](RamDomain x, RamDomain y) {return std::max(x, y);});
+			case FunctorOp::MIN:
+				return lowerBinary<ValueClosure>(args,
+						[](RamDomain x, RamDomain y) {return std::min(x, y);});
+
+				/** Functors on symbols */
+			case FunctorOp::STRLEN:
+				return lowerUnary(args[0], [symbols](RamDomain x) {
+					return (RamDomain) symbols->resolve(x).size();
+				});
+			case FunctorOp::TONUMBER:
+				return lowerUnary(args[0], [symbols](RamDomain x) {
+					RamDomain result = 0;
+					try {
+						result = stord(symbols->resolve(x));
+					} catch (...) {
+						std::cerr << "error: wrong string provided by to_number(\"";
+						std::cerr << symbols->resolve(x);
+						std::cerr << "\") functor.\n";
+						raise(SIGFPE);
+					}
+					return result;
+				});
+			case FunctorOp::TOSTRING:
+				return lowerUnary(args[0], [symbols](RamDomain x) {
+					return symbols->lookup(std::to_string(x));
+				});
+			case FunctorOp::CAT:
+				return lowerBinary<ValueClosure>(args,
+						[symbols](RamDomain x, RamDomain y) {
+							return symbols->lookup(
+									symbols->resolve(x) + symbols->resolve(y));
+						});
 			case FunctorOp::SUBSTR: {
-				auto symbol = visit(args[0]);
-				const std::string& str = interpreter.getSymbolTable().resolve(
-						symbol);
-				auto idx = visit(args[1]);
-				auto len = visit(args[2]);
-				std::string sub_str;
-				try {
-					sub_str = str.substr(idx, len);
-				} catch (...) {
-					std::cerr
-							<< "warning: wrong index position provided by substr(\"";
-					std::cerr << str << "\"," << (int32_t) idx << ","
-							<< (int32_t) len << ") functor.\n";
-				}
-				return interpreter.getSymbolTable().lookup(sub_str);
+				ValueClosure symbol = args[0];
+				ValueClosure index = args[1];
+				ValueClosure length = args[2];
+				return [symbols, symbol, index, length](const InterpreterContext& ctxt) {
+					const std::string& str = symbols->resolve(symbol(ctxt));
+					auto idx = index(ctxt);
+					auto len = length(ctxt);
+					std::string sub_str;
+					try {
+						sub_str = str.substr(idx, len);
+					} catch (...) {
+						std::cerr
+								<< "warning: wrong index position provided by substr(\"";
+						std::cerr << str << "\"," << (int32_t) idx << ","
+								<< (int32_t) len << ") functor.\n";
+					}
+					return symbols->lookup(sub_str);
+				};
 			}
 
 				/** Undefined */
-			default: {
-				assert(false && "unsupported operator");
-				return 0;
-			}
+			default:
+				return visitNode(op);
 			}
 		}
 
-		RamDomain visitUserDefinedOperator(const RamUserDefinedOperator& op)
+		ValueClosure visitUserDefinedOperator(const RamUserDefinedOperator& op)
 				override {
-			// get name and type
+			Interpreter* interp = &interpreter;
 			const std::string& name = op.getName();
 			const std::string& type = op.getType();
-
-			// load DLL (if not done yet)
-			void* handle = interpreter.loadDLL();
-			void (*fn)() = (void (*)())dlsym(handle, name.c_str());
-			if (fn == nullptr) {
-				std::cerr << "Cannot find user-defined operator " << name
-						<< " in " << SOUFFLE_DLL << std::endl;
-				exit(1);
-			}
-
-			// prepare dynamic call environment
 			size_t arity = op.getArgCount();
-			ffi_cif cif;
-			ffi_type* args[arity];
-			void* values[arity];
-			RamDomain intVal[arity];
-			const char* strVal[arity];
-			ffi_arg rc;
-
-			/* Initialize arguments for ffi-call */
-			for (size_t i = 0; i < arity; i++) {
-				RamDomain arg = visit(op.getArgument(i));
-				if (type[i] == 'S') {
-					args[i] = &ffi_type_pointer;
-					strVal[i] =
-							interpreter.getSymbolTable().resolve(arg).c_str();
-					values[i] = &strVal[i];
-				} else {
-					args[i] = &ffi_type_uint32;
-					intVal[i] = arg;
-					values[i] = &intVal[i];
+			std::vector<ValueClosure> args;
+			for (const RamValue* arg : op.getArguments()) {
+				args.push_back(visit(arg));
+			}
+
+			// the call site binds the functor on its first call, so that programs
+			// not evaluating their functors run without the library; it is shared
+			// by all lowerings of the same operator
+			std::shared_ptr<FunctorCallSite> site = interpreter.getCallSite(op);
+			auto bind = [interp, site, &name, &type, arity]() {
+				auto lease = site->bindLock.acquire();
+				(void) lease;
+				if (site->fn != nullptr) {
+					return;
 				}
-			}
-
-			// call external function
-			if (type[arity] == 'N') {
-				// Initialize for numerical return value
-				if (ffi_prep_cif(&cif, FFI_DEFAULT_ABI, arity, &ffi_type_uint32,
-						args) != FFI_OK) {
-					std::cerr
-							<< "Failed to prepare CIF for user-defined operator ";
-					std::cerr << name << std::endl;
+				void* handle = interp->loadDLL();
+				void (*fn)() = (void (*)())dlsym(handle, name.c_str());
+				if (fn == nullptr) {
+					std::cerr << "Cannot find user-defined operator " << name
+							<< " in " << SOUFFLE_DLL << std::endl;
 					exit(1);
 				}
-			} else {
-				// Initialize for string return value
-				if (ffi_prep_cif(&cif, FFI_DEFAULT_ABI, arity,
-						&ffi_type_pointer, args) != FFI_OK) {
+				for (size_t i = 0; i < arity; i++) {
+					site->args.push_back(
+							(type[i] == 'S') ? &ffi_type_pointer : &ffi_type_uint32);
+				}
+				ffi_type* result =
+						(type[arity] == 'N') ? &ffi_type_uint32 : &ffi_type_pointer;
+				if (ffi_prep_cif(&site->cif, FFI_DEFAULT_ABI, arity, result,
+						site->args.data()) != FFI_OK) {
 					std::cerr
 							<< "Failed to prepare CIF for user-defined operator ";
 					std::cerr << name << std::endl;
 					exit(1);
 				}
-			}
-			ffi_call(&cif, fn, &rc, values);
-			RamDomain result;
-			if (type[arity] == 'N') {
-				result = ((RamDomain) rc);
-			} else {
-				result = interpreter.getSymbolTable().lookup(
-						((const char*) rc));
+				site->fn = fn;
+			};
+
+			// numerical functors of few arguments are called directly
+			if (type.find('S') == std::string::npos) {
+				switch (arity) {
+				case 0:
+					return [site, bind](const InterpreterContext&) {
+						if (site->fn == nullptr) {
+							bind();
+						}
+						return ((RamDomain (*)()) site->fn.load())();
+					};
+				case 1: {
+					ValueClosure arg = args[0];
+					return [site, bind, arg](const InterpreterContext& ctxt) {
+						RamDomain x = arg(ctxt);
+						if (site->fn == nullptr) {
+							bind();
+						}
+						return ((RamDomain (*)(RamDomain)) site->fn.load())(x);
+					};
+				}
+				case 2: {
+					ValueClosure lhs = args[0];
+					ValueClosure rhs = args[1];
+					return [site, bind, lhs, rhs](const InterpreterContext& ctxt) {
+						RamDomain x = lhs(ctxt);
+						RamDomain y = rhs(ctxt);
+						if (site->fn == nullptr) {
+							bind();
+						}
+						return ((RamDomain (*)(RamDomain, RamDomain)) site->fn.load())(x, y);
+					};
+				}
+				default:
+					break;
+				}
 			}
 
-			return result;
+			// all other functors go through the prepared ffi call
+			return [interp, site, bind, args, &type](const InterpreterContext& ctxt) {
+				size_t arity = args.size();
+				void* values[arity];
+				RamDomain intVal[arity];
+				const char* strVal[arity];
+				for (size_t i = 0; i < arity; i++) {
+					RamDomain arg = args[i](ctxt);
+					if (type[i] == 'S') {
+						strVal[i] = interp->getSymbolTable().resolve(arg).c_str();
+						values[i] = &strVal[i];
+					} else {
+						intVal[i] = arg;
+						values[i] = &intVal[i];
+					}
+				}
+				if (site->fn == nullptr) {
+					bind();
+				}
+				ffi_arg rc;
+				ffi_call(&site->cif, site->fn.load(), &rc, values);
+				if (type[arity] == 'N') {
+					return (RamDomain) rc;
+				}
+				return interp->getSymbolTable().lookup((const char*) rc);
+			};
 		}
 
-		RamDomain visitLatticeUnaryFunctor(const RamLatticeUnaryFunctor& luf)
+		ValueClosure visitLatticeUnaryFunctor(const RamLatticeUnaryFunctor& luf)
 				override {
-//			std::cout << "visitLatticeUnaryFunctor here\n";
-
-			InterpreterContext ctxt_temp;
+			Interpreter* interp = &interpreter;
 			const RamLatticeUnaryFunction& func = luf.getFunc();
-			RamDomain arg1 = interpreter.evalVal(*luf.getRef(), ctxt);
-
-			// set 2 input variables
-			std::vector<RamDomain> args = { arg1 };
-			ctxt_temp.setArguments(args);
-
-			// evaluate binary constraint
-			for (const auto& cas : func.getLatCase()) {
-				if (cas.constraint == nullptr
-						|| interpreter.evalCond(*cas.constraint, ctxt_temp)) {
-					// get output if match
-					return interpreter.evalVal(*cas.output, ctxt_temp);
-				}
-			}
-
-			std::cerr << "Failed to find a match for a lattice unary functor!"
-					<< std::endl;
-			exit(1);
+			ValueClosure arg = visit(*luf.getRef());
+			return [interp, &func, arg](const InterpreterContext& ctxt) {
+				return interp->evalLatticeUnaryFunction(func, arg(ctxt));
+			};
 		}
 
-		RamDomain visitLatticeBinaryFunctor(const RamLatticeBinaryFunctor& lbf)
-				override {
-//			std::cout << "visitLatticeBinaryFunctor here\n";
-
-			InterpreterContext ctxt_temp;
+		ValueClosure visitLatticeBinaryFunctor(
+				const RamLatticeBinaryFunctor& lbf) override {
+			Interpreter* interp = &interpreter;
 			const RamLatticeBinaryFunction& func = lbf.getFunc();
-			RamDomain arg1 = interpreter.evalVal(*lbf.getRef1(), ctxt);
-			RamDomain arg2 = interpreter.evalVal(*lbf.getRef2(), ctxt);
-
-			// set 2 input variables
-			std::vector<RamDomain> args = { arg1, arg2 };
-			ctxt_temp.setArguments(args);
-
-			// evaluate binary constraint
-			for (const auto& cas : func.getLatCase()) {
-				if (cas.match == nullptr
-						|| interpreter.evalCond(*cas.match, ctxt_temp)) {
-					// get output if match
-//					std::cout << "find a match: " << *cas.output << std::endl;
-//					if (dynamic_cast<RamQuestionMark *>(cas.output.get())!=nullptr) {
-//						std::cout << "cast to question mark!\n";
-//					}
-					return interpreter.evalVal(*cas.output, ctxt_temp);
-				}
-			}
-
-			std::cerr << "Failed to find a match for a lattice binary functor!"
-					<< std::endl;
-			exit(1);
+			ValueClosure arg1 = visit(*lbf.getRef1());
+			ValueClosure arg2 = visit(*lbf.getRef2());
+			return [interp, &func, arg1, arg2](const InterpreterContext& ctxt) {
+				RamDomain lhs = arg1(ctxt);
+				return interp->evalLatticeBinaryFunction(func, lhs, arg2(ctxt));
+			};
 		}
 
 		// -- records --
-		RamDomain visitPack(const RamPack& op) override {
-			auto values = op.getArguments();
-			auto arity = values.size();
-			RamDomain data[arity];
-			for (size_t i = 0; i < arity; ++i) {
-				data[i] = visit(values[i]);
-			}
-			return pack(data, arity);
+		ValueClosure visitPack(const RamPack& op) override {
+			std::vector<ValueClosure> values;
+			for (const RamValue* value : op.getArguments()) {
+				values.push_back(visit(value));
+			}
+			return [values](const InterpreterContext& ctxt) {
+				auto arity = values.size();
+				RamDomain data[arity];
+				for (size_t i = 0; i < arity; ++i) {
+					data[i] = values[i](ctxt);
+				}
+				return pack(data, arity);
+			};
 		}
 
 		// -- subroutine argument
-		RamDomain visitArgument(const RamArgument& arg) override {
-			return ctxt.getArgument(arg.getArgCount());
+		ValueClosure visitArgument(const RamArgument& arg) override {
+			size_t argCount = arg.getArgCount();
+			return [argCount](const InterpreterContext& ctxt) {
+				return ctxt.getArgument(argCount);
+			};
 		}
 
 		// -- safety net --
-
-		RamDomain visitNode(const RamNode& node) override {
+		ValueClosure visitNode(const RamNode& node) override {
 			std::cerr << "Unsupported node type: " << typeid(node).name()
 					<< "\n";
 			assert(false && "Unsupported Node Type!");
-			return 0;
+			return ValueClosure();
 		}
 	};
 
-	// create and run evaluator
-	return ValueEvaluator(*this, ctxt)(value);
+	return ValueCompiler(*this)(value);
 }
 
-/** Evaluate RAM Condition */
-bool Interpreter::evalCond(const RamCondition& cond,
-		const InterpreterContext& ctxt) {
-	class ConditionEvaluator: public RamVisitor<bool> {
+/** Lower RAM condition into a closure */
+Interpreter::ConditionClosure Interpreter::compileCond(
+		const RamCondition& cond) {
+	class ConditionCompiler: public RamVisitor<ConditionClosure> {
 		Interpreter& interpreter;
-		const InterpreterContext& ctxt;
 		RamExistenceCheckAnalysis* existCheckAnalysis;
 		RamProvenanceExistenceCheckAnalysis* provExistCheckAnalysis;
+		bool profile = Global::config().has("profile");
 
 	public:
-		ConditionEvaluator(Interpreter& interp, const InterpreterContext& ctxt) :
-				interpreter(interp), ctxt(ctxt), existCheckAnalysis(
+		ConditionCompiler(Interpreter& interp) :
+				interpreter(interp), existCheckAnalysis(
 						interp.getTranslationUnit().getAnalysis<
 								RamExistenceCheckAnalysis>()), provExistCheckAnalysis(
 						interp.getTranslationUnit().getAnalysis<
@@ -421,431 +587,794 @@ bool Interpreter::evalCond(const RamCondition& cond,
 
 		// -- connectors operators --
 
-		bool visitConjunction(const RamConjunction& conj) override {
-			return visit(conj.getLHS()) && visit(conj.getRHS());
+		ConditionClosure visitConjunction(const RamConjunction& conj) override {
+			ConditionClosure lhs = visit(conj.getLHS());
+			ConditionClosure rhs = visit(conj.getRHS());
+			return [lhs, rhs](const InterpreterContext& ctxt) {
+				return lhs(ctxt) && rhs(ctxt);
+			};
 		}
 
-		bool visitNegation(const RamNegation& neg) override {
-			return !visit(neg.getOperand());
+		ConditionClosure visitNegation(const RamNegation& neg) override {
+			ConditionClosure operand = visit(neg.getOperand());
+			return [operand](const InterpreterContext& ctxt) {
+				return !operand(ctxt);
+			};
 		}
 
 		// -- relation operations --
 
-		bool visitEmptinessCheck(const RamEmptinessCheck& emptiness) override {
-			return interpreter.getRelation(emptiness.getRelation()).empty();
+		ConditionClosure visitEmptinessCheck(const RamEmptinessCheck& emptiness)
+				override {
+			InterpreterRelation* const* relation = interpreter.resolveRelation(
+					emptiness.getRelation());
+			return [relation](const InterpreterContext&) {
+				return (*relation)->empty();
+			};
 		}
 
-		bool visitExistenceCheck(const RamExistenceCheck& exists) override {
-			const InterpreterRelation& rel = interpreter.getRelation(
+		ConditionClosure visitExistenceCheck(const RamExistenceCheck& exists)
+				override {
+			Interpreter* interp = &interpreter;
+			InterpreterRelation* const* relation = interpreter.resolveRelation(
 					exists.getRelation());
+			std::vector<ValueClosure> values = compileValues(
+					exists.getValues());
+			std::string readsName = countReads(exists.getRelation());
 
-			// construct the pattern tuple
-			auto arity = rel.getArity();
-			auto values = exists.getValues();
-
-			if (Global::config().has("profile")
-					&& !exists.getRelation().isTemp()) {
-				interpreter.reads[exists.getRelation().getName()]++;
-			}
 			// for total we use the exists test
 			if (existCheckAnalysis->isTotal(&exists)) {
-				RamDomain tuple[arity];
-				for (size_t i = 0; i < arity; i++) {
-					tuple[i] =
-							(values[i]) ?
-									interpreter.evalVal(*values[i], ctxt) :
-									MIN_RAM_DOMAIN;
-				}
-
-				return rel.exists(tuple);
+				return [interp, relation, values, readsName](const InterpreterContext& ctxt) {
+					const InterpreterRelation& rel = **relation;
+					if (!readsName.empty()) {
+						interp->reads[readsName]++;
+					}
+					auto arity = values.size();
+					RamDomain tuple[arity];
+					for (size_t i = 0; i < arity; i++) {
+						tuple[i] = (values[i]) ? values[i](ctxt) : MIN_RAM_DOMAIN;
+					}
+					return rel.exists(tuple);
+				};
 			}
 
 			// for partial we search for lower and upper boundaries
-			RamDomain low[arity];
-			RamDomain high[arity];
-			for (size_t i = 0; i < arity; i++) {
-				low[i] = (values[i]) ? interpreter.evalVal(*values[i], ctxt) :
-				MIN_RAM_DOMAIN;
-				high[i] = (values[i]) ? low[i] : MAX_RAM_DOMAIN;
-			}
+			SearchColumns key = existCheckAnalysis->getKey(&exists);
+			return [interp, relation, values, readsName, key](const InterpreterContext& ctxt) {
+				const InterpreterRelation& rel = **relation;
+				if (!readsName.empty()) {
+					interp->reads[readsName]++;
+				}
+				auto arity = values.size();
+				RamDomain low[arity];
+				RamDomain high[arity];
+				for (size_t i = 0; i < arity; i++) {
+					low[i] = (values[i]) ? values[i](ctxt) : MIN_RAM_DOMAIN;
+					high[i] = (values[i]) ? low[i] : MAX_RAM_DOMAIN;
+				}
+				auto range = rel.getIndex(key)->lowerUpperBound(low, high);
+				return range.first != range.second;
+			};
+		}
 
-			// obtain index
-			auto idx = rel.getIndex(existCheckAnalysis->getKey(&exists));
-			auto range = idx->lowerUpperBound(low, high);
-			return range.first != range.second; // if there is something => done
+		ConditionClosure visitSubsumptionCheck(
+				const RamSubsumptionCheck& subsumption) override {
+			Interpreter* interp = &interpreter;
+			InterpreterRelation* const* relation = interpreter.resolveRelation(
+					subsumption.getRelation());
+			std::vector<ValueClosure> values = compileValues(
+					subsumption.getValues());
+			std::string readsName = countReads(subsumption.getRelation());
+			return [interp, relation, values, readsName](const InterpreterContext& ctxt) {
+				const auto& rel =
+						static_cast<const InterpreterLatticeRelation&>(**relation);
+				if (!readsName.empty()) {
+					interp->reads[readsName]++;
+				}
+				auto arity = values.size();
+				RamDomain tuple[arity];
+				for (size_t i = 0; i < arity; i++) {
+					tuple[i] = values[i](ctxt);
+				}
+				return rel.subsumes(tuple);
+			};
 		}
 
-		bool visitProvenanceExistenceCheck(
+		ConditionClosure visitSaturationCheck(
+				const RamSaturationCheck& saturation) override {
+			Interpreter* interp = &interpreter;
+			InterpreterRelation* const* relation = interpreter.resolveRelation(
+					saturation.getRelation());
+			std::vector<ValueClosure> values = compileValues(
+					saturation.getValues());
+			std::string readsName = countReads(saturation.getRelation());
+			return [interp, relation, values, readsName](const InterpreterContext& ctxt) {
+				const auto& rel =
+						static_cast<const InterpreterLatticeRelation&>(**relation);
+				if (!readsName.empty()) {
+					interp->reads[readsName]++;
+				}
+				auto arity = values.size();
+				RamDomain tuple[arity];
+				for (size_t i = 0; i < arity - 1; i++) {
+					tuple[i] = values[i](ctxt);
+				}
+				tuple[arity - 1] = MIN_RAM_DOMAIN;
+				return rel.isSaturated(tuple);
+			};
+		}
+
+		ConditionClosure visitProvenanceExistenceCheck(
 				const RamProvenanceExistenceCheck& provExists) override {
-			const InterpreterRelation& rel = interpreter.getRelation(
+			InterpreterRelation* const* relation = interpreter.resolveRelation(
 					provExists.getRelation());
-
-			// construct the pattern tuple
-			auto arity = rel.getArity();
-			auto values = provExists.getValues();
-
-			// for partial we search for lower and upper boundaries
-			RamDomain low[arity];
-			RamDomain high[arity];
-			for (size_t i = 0; i < arity - 2; i++) {
-				low[i] = (values[i]) ? interpreter.evalVal(*values[i], ctxt) :
-				MIN_RAM_DOMAIN;
-				high[i] = (values[i]) ? low[i] : MAX_RAM_DOMAIN;
-			}
-
-			low[arity - 2] = MIN_RAM_DOMAIN;
-			low[arity - 1] = MIN_RAM_DOMAIN;
-			high[arity - 2] = MAX_RAM_DOMAIN;
-			high[arity - 1] = MAX_RAM_DOMAIN;
-
-			// obtain index
-			auto idx = rel.getIndex(
-					provExistCheckAnalysis->getKey(&provExists));
-			auto range = idx->lowerUpperBound(low, high);
-			return range.first != range.second; // if there is something => done
+			std::vector<ValueClosure> values = compileValues(
+					provExists.getValues());
+			SearchColumns key = provExistCheckAnalysis->getKey(&provExists);
+			return [relation, values, key](const InterpreterContext& ctxt) {
+				const InterpreterRelation& rel = **relation;
+				auto arity = values.size();
+				RamDomain low[arity];
+				RamDomain high[arity];
+				for (size_t i = 0; i < arity - 2; i++) {
+					low[i] = (values[i]) ? values[i](ctxt) : MIN_RAM_DOMAIN;
+					high[i] = (values[i]) ? low[i] : MAX_RAM_DOMAIN;
+				}
+				low[arity - 2] = MIN_RAM_DOMAIN;
+				low[arity - 1] = MIN_RAM_DOMAIN;
+				high[arity - 2] = MAX_RAM_DOMAIN;
+				high[arity - 1] = MAX_RAM_DOMAIN;
+				auto range = rel.getIndex(key)->lowerUpperBound(low, high);
+				return range.first != range.second;
+			};
 		}
 
 		// -- comparison operators --
-		bool visitConstraint(const RamConstraint& relOp) override {
-			RamDomain lhs = interpreter.evalVal(*relOp.getLHS(), ctxt);
-			RamDomain rhs = interpreter.evalVal(*relOp.getRHS(), ctxt);
+		ConditionClosure visitConstraint(const RamConstraint& relOp) override {
+			SymbolTable* symbols = &interpreter.getSymbolTable();
 			switch (relOp.getOperator()) {
 			case BinaryConstraintOp::EQ:
-				return lhs == rhs;
+				return lowerBinary<ConditionClosure>(compileSides(relOp),
+						[](RamDomain x, RamDomain y) {return x == y;});
 			case BinaryConstraintOp::NE:
-				return lhs != rhs;
+				return lowerBinary<ConditionClosure>(compileSides(relOp),
+						[](RamDomain x, RamDomain y) {return x != y;});
 			case BinaryConstraintOp::LT:
-				return lhs < rhs;
+				return lowerBinary<ConditionClosure>(compileSides(relOp),
+						[](RamDomain x, RamDomain y) {return x < y;});
 			case BinaryConstraintOp::LE:
-				return lhs <= rhs;
+				return lowerBinary<ConditionClosure>(compileSides(relOp),
+						[](RamDomain x, RamDomain y) {return x <= y;});
 			case BinaryConstraintOp::GT:
-				return lhs > rhs;
+				return lowerBinary<ConditionClosure>(compileSides(relOp),
+						[](RamDomain x, RamDomain y) {return x > y;});
 			case BinaryConstraintOp::GE:
-				return lhs >= rhs;
-			case BinaryConstraintOp::MATCH: {
-				RamDomain l = interpreter.evalVal(*relOp.getLHS(), ctxt);
-				RamDomain r = interpreter.evalVal(*relOp.getRHS(), ctxt);
-				const std::string& pattern =
-						interpreter.getSymbolTable().resolve(l);
-				const std::string& text = interpreter.getSymbolTable().resolve(
-						r);
-				bool result = false;
-				try {
-					result = std::regex_match(text, std::regex(pattern));
-				} catch (...) {
-					std::cerr << "warning: wrong pattern provided for match(\""
-							<< pattern << "\",\"" << text << "\").\n";
-				}
-				return result;
-			}
-			case BinaryConstraintOp::NOT_MATCH: {
-				RamDomain l = interpreter.evalVal(*relOp.getLHS(), ctxt);
-				RamDomain r = interpreter.evalVal(*relOp.getRHS(), ctxt);
-				const std::string& pattern =
-						interpreter.getSymbolTable().resolve(l);
-				const std::string& text = interpreter.getSymbolTable().resolve(
-						r);
-				bool result = false;
-				try {
-					result = !std::regex_match(text, std::regex(pattern));
-				} catch (...) {
-					std::cerr << "warning: wrong pattern provided for !match(\""
-							<< pattern << "\",\"" << text << "\").\n";
-				}
-				return result;
-			}
-			case BinaryConstraintOp::CONTAINS: {
-				RamDomain l = interpreter.evalVal(*relOp.getLHS(), ctxt);
-				RamDomain r = interpreter.evalVal(*relOp.getRHS(), ctxt);
-				const std::string& pattern =
-						interpreter.getSymbolTable().resolve(l);
-				const std::string& text = interpreter.getSymbolTable().resolve(
-						r);
-				return text.find(pattern) != std::string::npos;
-			}
-			case BinaryConstraintOp::NOT_CONTAINS: {
-				RamDomain l = interpreter.evalVal(*relOp.getLHS(), ctxt);
-				RamDomain r = interpreter.evalVal(*relOp.getRHS(), ctxt);
-				const std::string& pattern =
-						interpreter.getSymbolTable().resolve(l);
-				const std::string& text = interpreter.getSymbolTable().resolve(
-						r);
-				return text.find(pattern) == std::string::npos;
-			}
+				return lowerBinary<ConditionClosure>(compileSides(relOp),
+						[](RamDomain x, RamDomain y) {return x >= y;});
+			case BinaryConstraintOp::MATCH:
+				return lowerBinary<ConditionClosure>(compileSides(relOp),
+						[symbols](RamDomain l, RamDomain r) {
+							const std::string& pattern = symbols->resolve(l);
+							const std::string& text = symbols->resolve(r);
+							bool result = false;
+							try {
+								result = std::regex_match(text, std::regex(pattern));
+							} catch (...) {
+								std::cerr << "warning: wrong pattern provided for match(\""
+										<< pattern << "\",\"" << text << "\").\n";
+							}
+							return result;
+						});
+			case BinaryConstraintOp::NOT_MATCH:
+				return lowerBinary<ConditionClosure>(compileSides(relOp),
+						[symbols](RamDomain l, RamDomain r) {
+							const std::string& pattern = symbols->resolve(l);
+							const std::string& text = symbols->resolve(r);
+							bool result = false;
+							try {
+								result = !std::regex_match(text, std::regex(pattern));
+							} catch (...) {
+								std::cerr << "warning: wrong pattern provided for !match(\""
+										<< pattern << "\",\"" << text << "\").\n";
+							}
+							return result;
+						});
+			case BinaryConstraintOp::CONTAINS:
+				return lowerBinary<ConditionClosure>(compileSides(relOp),
+						[symbols](RamDomain l, RamDomain r) {
+							return symbols->resolve(r).find(symbols->resolve(l))
+									!= std::string::npos;
+						});
+			case BinaryConstraintOp::NOT_CONTAINS:
+				return lowerBinary<ConditionClosure>(compileSides(relOp),
+						[symbols](RamDomain l, RamDomain r) {
+							return symbols->resolve(r).find(symbols->resolve(l))
+									== std::string::npos;
+						});
 			default:
-				assert(false && "unsupported operator");
-				return false;
+				return visitNode(relOp);
 			}
 		}
 
-		bool visitNode(const RamNode& node) override {
+		// -- safety net --
+		ConditionClosure visitNode(const RamNode& node) override {
 			std::cerr << "Unsupported node type: " << typeid(node).name()
 					<< "\n";
 			assert(false && "Unsupported Node Type!");
-			return false;
+			return ConditionClosure();
+		}
+
+	private:
+		/** lower the values of a pattern, keeping its unbound columns empty */
+		std::vector<ValueClosure> compileValues(
+				const std::vector<RamValue*>& values) {
+			std::vector<ValueClosure> res;
+			for (const RamValue* value : values) {
+				res.push_back(
+						(value) ? interpreter.compileVal(*value) : ValueClosure());
+			}
+			return res;
+		}
+
+		/** name of the relation whose reads are counted, empty if none */
+		std::string countReads(const RamRelationReference& relation) const {
+			return (profile && !relation.isTemp()) ?
+					relation.getName() : std::string();
+		}
+
+		/** lower both sides of a constraint */
+		std::vector<ValueClosure> compileSides(const RamConstraint& relOp) {
+			return {interpreter.compileVal(*relOp.getLHS()),
+					interpreter.compileVal(*relOp.getRHS())};
 		}
 	};
 
-	// run evaluator
-	return ConditionEvaluator(*this, ctxt)(cond);
+	return ConditionCompiler(*this)(cond);
 }
 
-/** Evaluate RAM operation */
-void Interpreter::evalOp(const RamOperation& op,
-		const InterpreterContext& args) {
-	class OperationEvaluator: public RamVisitor<void> {
+/** Lower RAM operation into a closure */
+Interpreter::OperationClosure Interpreter::compileOp(const RamOperation& op,
+		bool parallel) {
+	class OperationCompiler: public RamVisitor<OperationClosure> {
 		Interpreter& interpreter;
-		InterpreterContext& ctxt;
 		RamIndexScanKeysAnalysis* keysAnalysis;
+		bool profile = Global::config().has("profile");
+		// the outermost loop is still to be lowered and may run in parallel
+		bool parallel;
+		// projections are reached from several threads
+		bool concurrent = false;
 
 	public:
-		OperationEvaluator(Interpreter& interp, InterpreterContext& ctxt) :
-				interpreter(interp), ctxt(ctxt), keysAnalysis(
+		OperationCompiler(Interpreter& interp, bool parallel) :
+				interpreter(interp), keysAnalysis(
 						interp.getTranslationUnit().getAnalysis<
-								RamIndexScanKeysAnalysis>()) {
+								RamIndexScanKeysAnalysis>()), parallel(parallel) {
 		}
 
 		// -- Operations -----------------------------
 
-		void visitNestedOperation(const RamNestedOperation& nested) override {
-			visit(nested.getOperation());
+		OperationClosure visitNestedOperation(const RamNestedOperation& nested)
+				override {
+			return visit(nested.getOperation());
 		}
 
-		void visitSearch(const RamSearch& search) override {
-			visitNestedOperation(search);
-
-			if (Global::config().has("profile")
-					&& !search.getProfileText().empty()) {
-				interpreter.frequencies[search.getProfileText()][interpreter.getIterationNumber()]++;
-			}
+		OperationClosure visitSearch(const RamSearch& search) override {
+			OperationClosure nested = visitNestedOperation(search);
+			if (!profile || search.getProfileText().empty()) {
+				return nested;
+			}
+			Interpreter* interp = &interpreter;
+			const std::string& text = search.getProfileText();
+			return [interp, nested, &text](InterpreterContext& ctxt) {
+				nested(ctxt);
+				interp->frequencies[text][ctxt.getIteration()]++;
+			};
 		}
 
-		void visitScan(const RamScan& scan) override {
-			//std::cout << "visitScan here!\n";
-			// get the targeted relation
-			const InterpreterRelation& rel = interpreter.getRelation(
+		OperationClosure visitScan(const RamScan& scan) override {
+			InterpreterRelation* const* relation = interpreter.resolveRelation(
 					scan.getRelation());
-
-			// use simple iterator
-			for (const RamDomain* cur : rel) {
-				ctxt[scan.getIdentifier()] = cur;
-				visitSearch(scan);
-			}
+			size_t identifier = scan.getIdentifier();
+			if (parallel) {
+				parallel = false;
+				concurrent = true;
+				OperationClosure nested = visitSearch(scan);
+				return [relation, identifier, nested](InterpreterContext& ctxt) {
+					forEachInParallel((*relation)->partition(PARALLEL_CHUNKS),
+							identifier, nested, ctxt);
+				};
+			}
+			OperationClosure nested = visitSearch(scan);
+			return [relation, identifier, nested](InterpreterContext& ctxt) {
+				// use simple iterator
+				for (const RamDomain* cur : **relation) {
+					ctxt[identifier] = cur;
+					nested(ctxt);
+				}
+			};
 		}
 
-		void visitIndexScan(const RamIndexScan& scan) override {
-			//std::cout << "visitIndexScan here!\n";
-			// get the targeted relation
-			const InterpreterRelation& rel = interpreter.getRelation(
+		OperationClosure visitIndexScan(const RamIndexScan& scan) override {
+			InterpreterRelation* const* relation = interpreter.resolveRelation(
 					scan.getRelation());
-
-			// create pattern tuple for range query
-			auto arity = rel.getArity();
-			RamDomain low[arity];
-			RamDomain hig[arity];
-			auto pattern = scan.getRangePattern();
-			for (size_t i = 0; i < arity; i++) {
-				if (pattern[i] != nullptr) {
-					low[i] = interpreter.evalVal(*pattern[i], ctxt);
-					hig[i] = low[i];
-				} else {
-					low[i] = MIN_RAM_DOMAIN;
-					hig[i] = MAX_RAM_DOMAIN;
+			size_t identifier = scan.getIdentifier();
+			std::vector<ValueClosure> pattern = compileValues(
+					scan.getRangePattern());
+			SearchColumns key = keysAnalysis->getRangeQueryColumns(&scan);
+			bool outermost = parallel;
+			parallel = false;
+			concurrent = concurrent || outermost;
+			OperationClosure nested = visitSearch(scan);
+			return [relation, identifier, pattern, key, nested, outermost](
+					InterpreterContext& ctxt) {
+				const InterpreterRelation& rel = **relation;
+
+				// create pattern tuple for range query
+				auto arity = pattern.size();
+				RamDomain low[arity];
+				RamDomain hig[arity];
+				for (size_t i = 0; i < arity; i++) {
+					if (pattern[i]) {
+						low[i] = pattern[i](ctxt);
+						hig[i] = low[i];
+					} else {
+						low[i] = MIN_RAM_DOMAIN;
+						hig[i] = MAX_RAM_DOMAIN;
+					}
 				}
-			}
 
-			// obtain index
-			auto idx = rel.getIndex(keysAnalysis->getRangeQueryColumns(&scan),
-					nullptr);
-
-			// get iterator range
-			auto range = idx->lowerUpperBound(low, hig);
-
-			// conduct range query
-			for (auto ip = range.first; ip != range.second; ++ip) {
-				const RamDomain* data = *(ip);
-				//std::cout << "scan.getIdentifier():" <<scan.getIdentifier()<<"\n";
-				ctxt[scan.getIdentifier()] = data;
-				visitSearch(scan);
-			}
+				// conduct range query
+				const InterpreterIndex* index = rel.getIndex(key, nullptr);
+				auto range = index->lowerUpperBound(low, hig);
+				if (outermost) {
+					forEachInParallel(index->partition(range.first, range.second,
+							PARALLEL_CHUNKS), identifier, nested, ctxt);
+					return;
+				}
+				for (auto ip = range.first; ip != range.second; ++ip) {
+					ctxt[identifier] = *ip;
+					nested(ctxt);
+				}
+			};
 		}
 
-		void visitLookup(const RamLookup& lookup) override {
-			// get reference
-			RamDomain ref =
-					ctxt[lookup.getReferenceLevel()][lookup.getReferencePosition()];
-
-			// check for null
-			if (isNull(ref)) {
-				return;
-			}
-
-			// update environment variable
-			auto arity = lookup.getArity();
-			const RamDomain* tuple = unpack(ref, arity);
-
-			// save reference to temporary value
-			ctxt[lookup.getIdentifier()] = tuple;
+		OperationClosure visitLookup(const RamLookup& lookup) override {
+			size_t level = lookup.getReferenceLevel();
+			size_t position = lookup.getReferencePosition();
+			size_t arity = lookup.getArity();
+			size_t identifier = lookup.getIdentifier();
+			parallel = false;
+			OperationClosure nested = visitSearch(lookup);
+			return [level, position, arity, identifier, nested](InterpreterContext& ctxt) {
+				RamDomain ref = ctxt[level][position];
+
+				// check for null
+				if (isNull(ref)) {
+					return;
+				}
 
-			// run nested part - using base class visitor
-			visitSearch(lookup);
+				// save reference to temporary value
+				ctxt[identifier] = unpack(ref, arity);
+				nested(ctxt);
+			};
 		}
 
-		void visitAggregate(const RamAggregate& aggregate) override {
-			// get the targeted relation
-			const InterpreterRelation& rel = interpreter.getRelation(
+		OperationClosure visitAggregate(const RamAggregate& aggregate)
+				override {
+			InterpreterRelation* const* relation = interpreter.resolveRelation(
 					aggregate.getRelation());
-
-			// initialize result
-			RamDomain res = 0;
-			switch (aggregate.getFunction()) {
-			case RamAggregate::MIN:
-				res = MAX_RAM_DOMAIN;
-				break;
-			case RamAggregate::MAX:
-				res = MIN_RAM_DOMAIN;
-				break;
-			case RamAggregate::COUNT:
-				res = 0;
-				break;
-			case RamAggregate::SUM:
-				res = 0;
-				break;
+			size_t identifier = aggregate.getIdentifier();
+			RamAggregate::Function function = aggregate.getFunction();
+			std::vector<ValueClosure> pattern = compileValues(
+					aggregate.getPattern());
+			ValueClosure target =
+					(function != RamAggregate::COUNT) ?
+							interpreter.compileVal(
+									*aggregate.getTargetExpression()) :
+							ValueClosure();
+			SearchColumns key = aggregate.getRangeQueryColumns();
+
+			// a MIN or MAX of a column is found at the ends of the range if the
+			// index orders the range by that column
+			int column = -1;
+			if (function == RamAggregate::MIN || function == RamAggregate::MAX) {
+				if (const auto* access =
+						dynamic_cast<const RamElementAccess*>(aggregate.getTargetExpression())) {
+					if (access->getIdentifier() == identifier) {
+						column = access->getElement();
+					}
+				}
 			}
-
-			// init temporary tuple for this level
-			auto arity = rel.getArity();
-
-			// get lower and upper boundaries for iteration
-			const auto& pattern = aggregate.getPattern();
-			RamDomain low[arity];
-			RamDomain hig[arity];
-
-			for (size_t i = 0; i < arity; i++) {
-				if (pattern[i] != nullptr) {
-					low[i] = interpreter.evalVal(*pattern[i], ctxt);
-					hig[i] = low[i];
-				} else {
-					low[i] = MIN_RAM_DOMAIN;
-					hig[i] = MAX_RAM_DOMAIN;
+			size_t bound = 0;
+			for (size_t i = 0; i < pattern.size(); i++) {
+				if ((key >> i) & 1) {
+					bound++;
 				}
 			}
 
-			// obtain index
-			auto idx = rel.getIndex(aggregate.getRangeQueryColumns());
+			// otherwise the results are remembered by the values of the bound
+			// columns; counts are not, as the index counts a range from the
+			// ranks of its ends
+			std::shared_ptr<AggregateMemo> memo;
+			if (function != RamAggregate::COUNT && bound <= AggregateMemo::MAX_BOUND
+					&& isFunctionOf(*aggregate.getTargetExpression(), identifier)) {
+				memo = std::make_shared<AggregateMemo>();
+			}
 
-			// get iterator range
-			auto range = idx->lowerUpperBound(low, hig);
+			parallel = false;
+			OperationClosure nested = visitSearch(aggregate);
+			return [relation, identifier, function, pattern, target, key, column,
+					bound, memo, nested](InterpreterContext& ctxt) {
+				const InterpreterRelation& rel = **relation;
 
-			// check for emptiness
-			if (aggregate.getFunction() != RamAggregate::COUNT) {
-				if (range.first == range.second) {
-					return;  // no elements => no min/max
+				// get lower and upper boundaries for iteration
+				auto arity = pattern.size();
+				RamDomain low[arity];
+				RamDomain hig[arity];
+				for (size_t i = 0; i < arity; i++) {
+					if (pattern[i]) {
+						low[i] = pattern[i](ctxt);
+						hig[i] = low[i];
+					} else {
+						low[i] = MIN_RAM_DOMAIN;
+						hig[i] = MAX_RAM_DOMAIN;
+					}
 				}
-			}
 
-			// iterate through values
-			for (auto ip = range.first; ip != range.second; ++ip) {
-				// link tuple
-				const RamDomain* data = *(ip);
-				ctxt[aggregate.getIdentifier()] = data;
+				// the result to write to the environment
+				RamDomain tuple[1];
+				RamDomain& res = tuple[0];
 
-				// count is easy
-				if (aggregate.getFunction() == RamAggregate::COUNT) {
-					++res;
-					continue;
+				// answer it from the relation or the index directly if possible
+				if (function == RamAggregate::COUNT && key == 0) {
+					res = rel.size();
+					ctxt[identifier] = tuple;
+					nested(ctxt);
+					return;
+				}
+				const InterpreterIndex* index = rel.getIndex(key);
+				if (column >= 0
+						&& (pattern[column] || (bound < arity
+								&& index->order()[bound] == column))) {
+					auto first = index->LowerBound(low);
+					if (first == index->UpperBound(hig)) {
+						return;  // no elements => no min/max
+					}
+					res = (function == RamAggregate::MIN) ?
+							(*first)[column] : (*index->floor(hig))[column];
+					ctxt[identifier] = tuple;
+					nested(ctxt);
+					return;
 				}
 
-				// aggregation is a bit more difficult
-
-				// eval target expression
-				RamDomain cur = interpreter.evalVal(
-						*aggregate.getTargetExpression(), ctxt);
+				// look up a remembered result
+				AggregateMemo::Key values {};
+				if (memo) {
+					for (size_t i = 0, j = 0; i < arity; i++) {
+						if (pattern[i]) {
+							values[j++] = low[i];
+						}
+					}
+					if (memo->lookup(rel, values, res)) {
+						ctxt[identifier] = tuple;
+						nested(ctxt);
+						return;
+					}
+				}
 
-				switch (aggregate.getFunction()) {
+				// initialize result
+				switch (function) {
 				case RamAggregate::MIN:
-					res = std::min(res, cur);
+					res = MAX_RAM_DOMAIN;
 					break;
 				case RamAggregate::MAX:
-					res = std::max(res, cur);
+					res = MIN_RAM_DOMAIN;
 					break;
 				case RamAggregate::COUNT:
-					res = 0;
-					break;
 				case RamAggregate::SUM:
-					res += cur;
+					res = 0;
 					break;
 				}
-			}
 
-			// write result to environment
-			RamDomain tuple[1];
-			tuple[0] = res;
-			ctxt[aggregate.getIdentifier()] = tuple;
+				if (function == RamAggregate::COUNT) {
+					// count is easy
+					res = index->count(low, hig);
+				} else {
+					auto range = index->lowerUpperBound(low, hig);
 
-			// run nested part - using base class visitor
-			visitSearch(aggregate);
-		}
+					// check for emptiness
+					if (function != RamAggregate::SUM
+							&& range.first == range.second) {
+						return;  // no elements => no min/max
+					}
 
-		void visitFilter(const RamFilter& filter) override {
-			//std::cout << "visitFilter here!\n";
-			// check condition
-			if (interpreter.evalCond(filter.getCondition(), ctxt)) {
-				// process nested
-				visitNestedOperation(filter);
-			}
+					// iterate through values
+					for (auto ip = range.first; ip != range.second; ++ip) {
+						// eval target expression on the linked tuple
+						ctxt[identifier] = *ip;
+						RamDomain cur = target(ctxt);
+						switch (function) {
+						case RamAggregate::MIN:
+							res = std::min(res, cur);
+							break;
+						case RamAggregate::MAX:
+							res = std::max(res, cur);
+							break;
+						case RamAggregate::COUNT:
+							break;
+						case RamAggregate::SUM:
+							res += cur;
+							break;
+						}
+					}
+				}
+				if (memo) {
+					memo->store(rel, values, res);
+				}
 
-			if (Global::config().has("profile")
-					&& !filter.getProfileText().empty()) {
-				interpreter.frequencies[filter.getProfileText()][interpreter.getIterationNumber()]++;
-			}
+				// write result to environment
+				ctxt[identifier] = tuple;
+				nested(ctxt);
+			};
 		}
 
-		void visitProject(const RamProject& project) override {
-			// create a tuple of the proper arity (also supports arity 0)
-			//std::cout << "visitProject here.\n";
-			auto arity = project.getRelation().getArity();
-			const auto& values = project.getValues();
-			RamDomain tuple[arity];
-			for (size_t i = 0; i < arity; i++) {
-				assert(values[i]);
-				//std::cout << "visitProject -- evalVal here, arity = " << arity << ".\n";
-				tuple[i] = interpreter.evalVal(*values[i], ctxt);
+		OperationClosure visitFilter(const RamFilter& filter) override {
+			ConditionClosure cond = interpreter.compileCond(
+					filter.getCondition());
+			OperationClosure nested = visitNestedOperation(filter);
+			if (!profile || filter.getProfileText().empty()) {
+				return [cond, nested](InterpreterContext& ctxt) {
+					if (cond(ctxt)) {
+						nested(ctxt);
+					}
+				};
 			}
+			Interpreter* interp = &interpreter;
+			const std::string& text = filter.getProfileText();
+			return [interp, cond, nested, &text](InterpreterContext& ctxt) {
+				if (cond(ctxt)) {
+					nested(ctxt);
+				}
+				interp->frequencies[text][ctxt.getIteration()]++;
+			};
+		}
 
-			// insert in target relation
-			InterpreterRelation& rel = interpreter.getRelation(
+		OperationClosure visitProject(const RamProject& project) override {
+			InterpreterRelation* const* relation = interpreter.resolveRelation(
 					project.getRelation());
-			rel.insert(tuple);
+			std::vector<ValueClosure> values = compileValues(
+					project.getValues());
+			if (concurrent) {
+				return [relation, values](InterpreterContext& ctxt) {
+					auto arity = values.size();
+					RamDomain tuple[arity];
+					for (size_t i = 0; i < arity; i++) {
+						tuple[i] = values[i](ctxt);
+					}
+					(*relation)->insertConcurrently(tuple);
+				};
+			}
+			return [relation, values](InterpreterContext& ctxt) {
+				// create a tuple of the proper arity (also supports arity 0)
+				auto arity = values.size();
+				RamDomain tuple[arity];
+				for (size_t i = 0; i < arity; i++) {
+					tuple[i] = values[i](ctxt);
+				}
+
+				// insert in target relation
+				(*relation)->insert(tuple);
+			};
 		}
 
 		// -- return from subroutine --
-		void visitReturn(const RamReturn& ret) override {
-			for (auto val : ret.getValues()) {
-				if (val == nullptr) {
-					ctxt.addReturnValue(0, true);
-				} else {
-					ctxt.addReturnValue(interpreter.evalVal(*val, ctxt));
+		OperationClosure visitReturn(const RamReturn& ret) override {
+			std::vector<ValueClosure> values = compileValues(ret.getValues());
+			return [values](InterpreterContext& ctxt) {
+				for (const auto& val : values) {
+					if (!val) {
+						ctxt.addReturnValue(0, true);
+					} else {
+						ctxt.addReturnValue(val(ctxt));
+					}
 				}
-			}
+			};
 		}
 
 		// -- safety net --
-		void visitNode(const RamNode& node) override {
+		OperationClosure visitNode(const RamNode& node) override {
 			std::cerr << "Unsupported node type: " << typeid(node).name()
 					<< "\n";
 			assert(false && "Unsupported Node Type!");
+			return OperationClosure();
+		}
+
+	private:
+		/** lower the values of a pattern, keeping its unbound columns empty */
+		std::vector<ValueClosure> compileValues(
+				const std::vector<RamValue*>& values) {
+			std::vector<ValueClosure> res;
+			for (const RamValue* value : values) {
+				res.push_back(
+						(value) ? interpreter.compileVal(*value) : ValueClosure());
+			}
+			return res;
 		}
 	};
 
-	// create and run interpreter for operations
+	return OperationCompiler(*this, parallel)(op);
+}
+
+/** Check whether the outermost loop of a query may be spread over threads */
+bool Interpreter::isParallelQuery(const RamOperation& op) const {
+	if (Global::config().get("jobs") == "1"
+			|| Global::config().has("profile")) {
+		return false;
+	}
+
+	// the values returned by a subroutine are collected in order
+	bool parallel = true;
+	visitDepthFirst(op, [&](const RamReturn&) {
+		parallel = false;
+	});
+
+	// the target relation must not be read while it is being inserted into
+	visitDepthFirst(op, [&](const RamProject& project) {
+		size_t uses = 0;
+		visitDepthFirst(op, [&](const RamRelationReference& rel) {
+			if (rel.getName() == project.getRelation().getName()) {
+				uses++;
+			}
+		});
+		if (uses > 1) {
+			parallel = false;
+		}
+	});
+	return parallel;
+}
+
+/** Assign slots to all relations of a statement ahead of the evaluation */
+void Interpreter::assignSlots(const RamStatement& stmt) {
+	visitDepthFirst(stmt, [&](const RamRelationReference& rel) {
+		addSlot(rel.getName());
+	});
+	// the relation of a timer is not a child node
+	visitDepthFirst(stmt, [&](const RamLogTimer& timer) {
+		if (timer.getRelation() != nullptr) {
+			addSlot(timer.getRelation()->getName());
+		}
+	});
+}
+
+/** Plan the indexes of a relation chosen by the index set analysis, which
+ *  shares an order between all searches on a prefix of it. For a lattice
+ *  relation, the lattice column is moved to the end of the orders of the
+ *  searches not bounding it, so that their indexes stay sorted when a cell
+ *  is raised and are updated in place instead of being rebuilt */
+void Interpreter::planIndexes(InterpreterRelation& rel,
+		const RamRelationReference& id) {
+	if (id.getArity() == 0) {
+		return;
+	}
+	const size_t lattice = id.getArity() - 1;
+	IndexSet& indexes = translationUnit.getAnalysis<IndexSetAnalysis>()->getIndexes(id);
+	for (SearchColumns search : indexes.getSearches()) {
+		const bool latticeLast = id.isLattice() && !(search & (SearchColumns(1) << lattice));
+		InterpreterIndexOrder order;
+		for (int column : indexes.getLexOrder(search)) {
+			if (!latticeLast || size_t(column) != lattice) {
+				order.append(column);
+			}
+		}
+		for (size_t column = 0; column < id.getArity(); column++) {
+			if (!order.covers(column) && (!latticeLast || column != lattice)) {
+				order.append(column);
+			}
+		}
+		if (latticeLast) {
+			order.append(lattice);
+		}
+		rel.planIndex(search, order);
+	}
+}
+
+/** Lower the queries of a statement ahead of the evaluation, with the values
+ *  of its facts and the conditions of its inserts and loop exits */
+void Interpreter::compileQueries(const RamStatement& stmt) {
+	visitDepthFirst(stmt, [&](const RamFact& fact) {
+		for (const RamValue* value : fact.getValues()) {
+			if (values.find(value) == values.end()) {
+				values[value] = compileVal(*value);
+			}
+		}
+	});
+	visitDepthFirst(stmt, [&](const RamExit& exit) {
+		const RamCondition& cond = exit.getCondition();
+		if (conditions.find(&cond) == conditions.end()) {
+			conditions[&cond] = compileCond(cond);
+		}
+	});
+	visitDepthFirst(stmt, [&](const RamInsert& insert) {
+		const RamCondition* cond = insert.getCondition();
+		if (cond != nullptr && conditions.find(cond) == conditions.end()) {
+			conditions[cond] = compileCond(*cond);
+		}
+		const RamOperation& op = insert.getOperation();
+		if (queries.find(&op) != queries.end()) {
+			return;
+		}
+		if (!isParallelQuery(op)) {
+			queries[&op] = compileOp(op, false);
+			return;
+		}
+
+		// build the indexes searched by a parallel query, and all indexes of
+		// the relations it inserts into, before its threads use them
+		auto* keysAnalysis = translationUnit.getAnalysis<RamIndexScanKeysAnalysis>();
+		auto* existCheckAnalysis = translationUnit.getAnalysis<RamExistenceCheckAnalysis>();
+		auto* provExistCheckAnalysis = translationUnit.getAnalysis<
+				RamProvenanceExistenceCheckAnalysis>();
+		std::vector<std::pair<InterpreterRelation* const*, SearchColumns>> searches;
+		std::vector<InterpreterRelation* const*> targets;
+		visitDepthFirst(op, [&](const RamNode& node) {
+			if (const auto* scan = dynamic_cast<const RamIndexScan*>(&node)) {
+				searches.emplace_back(resolveRelation(scan->getRelation()),
+						keysAnalysis->getRangeQueryColumns(scan));
+			} else if (const auto* agg = dynamic_cast<const RamAggregate*>(&node)) {
+				searches.emplace_back(resolveRelation(agg->getRelation()),
+						agg->getRangeQueryColumns());
+			} else if (const auto* exists = dynamic_cast<const RamExistenceCheck*>(&node)) {
+				searches.emplace_back(resolveRelation(exists->getRelation()),
+						existCheckAnalysis->getKey(exists));
+			} else if (const auto* provExists =
+					dynamic_cast<const RamProvenanceExistenceCheck*>(&node)) {
+				searches.emplace_back(resolveRelation(provExists->getRelation()),
+						provExistCheckAnalysis->getKey(provExists));
+			} else if (const auto* project = dynamic_cast<const RamProject*>(&node)) {
+				targets.push_back(resolveRelation(project->getRelation()));
+			}
+		});
+		OperationClosure query = compileOp(op, true);
+		queries[&op] = [searches, targets, query](InterpreterContext& ctxt) {
+			for (const auto& cur : searches) {
+				const InterpreterRelation* rel = *cur.first;
+				if (rel == nullptr || rel->getArity() == 0) {
+					continue;
+				}
+				if (cur.second != rel->getTotalIndexKey()) {
+					rel->getIndex(cur.second);
+				} else if (!dynamic_cast<const InterpreterLatticeRelation*>(rel)) {
+					rel->getTotalIndex();
+				}
+			}
+			for (InterpreterRelation* const* target : targets) {
+				(*target)->freezeIndexes();
+			}
+			query(ctxt);
+			for (InterpreterRelation* const* target : targets) {
+				(*target)->thawIndexes();
+			}
+		};
+	});
+}
+
+/** Evaluate RAM operation */
+void Interpreter::evalOp(const RamOperation& op,
+		const InterpreterContext& args) {
+	// the queries are lowered ahead of the evaluation and only read since
+	auto pos = queries.find(&op);
+	assert(pos != queries.end() && "query not lowered");
+	const OperationClosure* query = &pos->second;
+
+	// create and run closure for operations
 	InterpreterContext ctxt(
 			translationUnit.getAnalysis<RamOperationDepthAnalysis>()->getDepth(
 					&op));
 	ctxt.setReturnValues(args.getReturnValues());
 	ctxt.setReturnErrors(args.getReturnErrors());
 	ctxt.setArguments(args.getArguments());
-	OperationEvaluator(*this, ctxt).visit(op);
+	ctxt.setIteration(args.getIteration());
+	(*query)(ctxt);
 }
 
 /** Evaluate RAM statement */
@@ -853,6 +1382,10 @@ void Interpreter::evalStmt(const RamStatement& stmt) {
 	class StatementEvaluator: public RamVisitor<bool> {
 		Interpreter& interpreter;
 
+		/** Iteration of the fix-point calculation of the stratum; strata
+		 *  run concurrently with their own evaluators */
+		size_t iteration = 0;
+
 	public:
 		StatementEvaluator(Interpreter& interp) :
 				interpreter(interp) {
@@ -861,6 +1394,12 @@ void Interpreter::evalStmt(const RamStatement& stmt) {
 		// -- Statements -----------------------------
 
 		bool visitSequence(const RamSequence& seq) override {
+			// run a sequence of strata as a graph of tasks if requested
+			if (Global::config().has("parallel-strata")
+					&& isStrata(seq.getStatements())) {
+				return visitStrata(seq.getStatements());
+			}
+
 			// process all statements in sequence
 			for (const auto& cur : seq.getStatements()) {
 				if (!visit(cur)) {
@@ -872,6 +1411,35 @@ void Interpreter::evalStmt(const RamStatement& stmt) {
 			return true;
 		}
 
+		/** Check whether the given statements are all strata */
+		static bool isStrata(const std::vector<RamStatement*>& stmts) {
+			return !stmts.empty() && std::all_of(stmts.begin(), stmts.end(),
+					[](const RamStatement* cur) {
+						return dynamic_cast<const RamStratum*>(cur) != nullptr;
+					});
+		}
+
+		/** Run strata concurrently, each once the strata it depends on are complete */
+		bool visitStrata(const std::vector<RamStatement*>& stmts) {
+			std::map<size_t, size_t> positions;
+			std::vector<std::function<void()>> tasks;
+			std::vector<std::vector<size_t>> dependencies;
+			for (const RamStatement* cur : stmts) {
+				const auto& stratum = static_cast<const RamStratum&>(*cur);
+				std::vector<size_t> positionsOfDependencies;
+				for (size_t dependency : stratum.getDependencies()) {
+					positionsOfDependencies.push_back(positions.at(dependency));
+				}
+				positions[stratum.getIndex()] = tasks.size();
+				tasks.push_back([this, &stratum]() {
+					StatementEvaluator(interpreter).visit(stratum);
+				});
+				dependencies.push_back(std::move(positionsOfDependencies));
+			}
+			runTaskGraph(tasks, dependencies);
+			return true;
+		}
+
 		bool visitParallel(const RamParallel& parallel) override {
 			// get statements to be processed in parallel
 			const auto& stmts = parallel.getStatements();
@@ -894,17 +1462,17 @@ void Interpreter::evalStmt(const RamStatement& stmt) {
 			bool cond = true;
 #pragma omp parallel for reduction(&& : cond)
 			for (size_t i = 0; i < stmts.size(); i++) {
-				cond = cond && visit(stmts[i]);
+				cond = cond && StatementEvaluator(*this).visit(stmts[i]);
 			}
 			return cond;
 		}
 
 		bool visitLoop(const RamLoop& loop) override {
-			interpreter.resetIterationNumber();
+			iteration = 0;
 			while (visit(loop.getBody())) {
-				interpreter.incIterationNumber();
+				iteration++;
 			}
-			interpreter.resetIterationNumber();
+			iteration = 0;
 			return true;
 		}
 
@@ -915,13 +1483,13 @@ void Interpreter::evalStmt(const RamStatement& stmt) {
 		bool visitLogTimer(const RamLogTimer& timer) override {
 			if (timer.getRelation() == nullptr) {
 				Logger logger(timer.getMessage().c_str(),
-						interpreter.getIterationNumber());
+						iteration);
 				return visit(timer.getStatement());
 			} else {
 				const InterpreterRelation& rel = interpreter.getRelation(
 						*timer.getRelation());
 				Logger logger(timer.getMessage().c_str(),
-						interpreter.getIterationNumber(),
+						iteration,
 						std::bind(&InterpreterRelation::size, &rel));
 				return visit(timer.getStatement());
 			}
@@ -977,7 +1545,7 @@ void Interpreter::evalStmt(const RamStatement& stmt) {
 					size.getRelation());
 			ProfileEventSingleton::instance().makeQuantityEvent(
 					size.getMessage(), rel.size(),
-					interpreter.getIterationNumber());
+					iteration);
 			return true;
 		}
 
@@ -993,12 +1561,6 @@ void Interpreter::evalStmt(const RamStatement& stmt) {
 							Global::config().has("provenance"))->readAll(
 							relation);
 				} catch (std::exception& e) {
-					std::cout << "symbolmask:\n";
-					load.getRelation().getSymbolMask().print(std::cout);
-					std::cout << "\n";
-					std::cout << "symboltable:\n";
-					interpreter.getSymbolTable().print(std::cout);
-					std::cout << "\n";
 					std::cerr << "Error loading data: " << e.what() << "\n";
 				}
 			}
@@ -1039,13 +1601,15 @@ void Interpreter::evalStmt(const RamStatement& stmt) {
 		bool visitInsert(const RamInsert& insert) override {
 			// run generic query executor
 			//std::cout << "visitInsert here.\n";
+			InterpreterContext args;
+			args.setIteration(iteration);
 			const RamCondition* c = insert.getCondition();
 			if (c != nullptr) {
 				if (interpreter.evalCond(*insert.getCondition())) {
-					interpreter.evalOp(insert.getOperation());
+					interpreter.evalOp(insert.getOperation(), args);
 				}
 			} else {
-				interpreter.evalOp(insert.getOperation());
+				interpreter.evalOp(insert.getOperation(), args);
 			}
 			//std::cout << "visitInsert finish.\n";
 			return true;
@@ -1058,12 +1622,13 @@ void Interpreter::evalStmt(const RamStatement& stmt) {
 			InterpreterRelation& trg = interpreter.getRelation(
 					merge.getTargetRelation());
 
-			if (dynamic_cast<InterpreterEqRelation*>(&trg)) {
-				// expand src with the new knowledge generated by insertion.
-				src.extend(trg);
+			if (auto* eqrel = dynamic_cast<InterpreterEqRelation*>(&trg)) {
+				// expand src with the new knowledge generated by insertion, and merge it
+				eqrel->merge(src);
+			} else {
+				// merge in all elements
+				trg.insert(src);
 			}
-			// merge in all elements
-			trg.insert(src);
 			//std::cout << "visitMerge finish.\n";
 			// done
 			return true;
@@ -1087,7 +1652,6 @@ void Interpreter::evalStmt(const RamStatement& stmt) {
 				high[i] = MAX_RAM_DOMAIN;
 			}
 
-			InterpreterContext ctxt_temp;
 			const RamLatticeBinaryFunction& lub_func =
 					interpreter.getTranslationUnit().getProgram()->getLattice()->getLUB();
 
@@ -1117,22 +1681,8 @@ void Interpreter::evalStmt(const RamStatement& stmt) {
 					}
 
 					RamDomain curlat = (*it)[arity - 1];
-					// set 2 input variables
-					std::vector<RamDomain> args = { biggestLat, curlat };
-					ctxt_temp.setArguments(args);
-
-					// evaluate binary constraint
-					for (const auto& cas : lub_func.getLatCase()) {
-						if (cas.match == nullptr
-								|| interpreter.evalCond(*cas.match,
-										ctxt_temp)) {
-							// get output if match
-							biggestLat = interpreter.evalVal(*cas.output,
-									ctxt_temp);
-							break;
-						}
-					}
-					//				biggestLat = latAssoc->applyLub(biggestLat, curlat);
+					biggestLat = interpreter.evalLatticeBinaryFunction(lub_func,
+							biggestLat, curlat);
 				}
 				high[arity - 1] = biggestLat;
 
@@ -1168,7 +1718,6 @@ void Interpreter::evalStmt(const RamStatement& stmt) {
 				high[i] = MAX_RAM_DOMAIN;
 			}
 
-			InterpreterContext ctxt_temp;
 			const RamLatticeBinaryFunction& lub_func =
 					interpreter.getTranslationUnit().getProgram()->getLattice()->getLUB();
 
@@ -1207,20 +1756,8 @@ void Interpreter::evalStmt(const RamStatement& stmt) {
 					}
 
 					RamDomain curlat = (*new_it)[arity - 1];
-					// set 2 input variables
-					std::vector<RamDomain> ctxt_args = { biggestLat, curlat };
-					ctxt_temp.setArguments(ctxt_args);
-					// evaluate binary constraint
-					for (const auto& cas : lub_func.getLatCase()) {
-						if (cas.match == nullptr
-								|| interpreter.evalCond(*cas.match,
-										ctxt_temp)) {
-							// get output if match
-							biggestLat = interpreter.evalVal(*cas.output,
-									ctxt_temp);
-							break;
-						}
-					}
+					biggestLat = interpreter.evalLatticeBinaryFunction(lub_func,
+							biggestLat, curlat);
 				}
 
 
@@ -1237,22 +1774,8 @@ void Interpreter::evalStmt(const RamStatement& stmt) {
 						}
 
 						RamDomain curlat = (*cell_org_it)[arity - 1];
-						// set 2 input variables
-						std::vector<RamDomain> ctxt_args =
-								{ biggestLat, curlat };
-						ctxt_temp.setArguments(ctxt_args);
-						// evaluate binary constraint
-						for (const auto& cas : lub_func.getLatCase()) {
-							if (cas.match == nullptr
-									|| interpreter.evalCond(*cas.match,
-											ctxt_temp)) {
-
-								// get output if match
-								biggestLat = interpreter.evalVal(*cas.output,
-										ctxt_temp);
-								break;
-							}
-						}
+						biggestLat = interpreter.evalLatticeBinaryFunction(
+								lub_func, biggestLat, curlat);
 					}
 				}
 
@@ -1267,6 +1790,23 @@ void Interpreter::evalStmt(const RamStatement& stmt) {
 			return true;
 		}
 
+		bool visitLatMerge(const RamLatMerge& latmerge) override {
+			auto& target = static_cast<InterpreterLatticeRelation&>(
+					interpreter.getRelation(latmerge.getTargetRelation()));
+			InterpreterRelation& source = interpreter.getRelation(
+					latmerge.getSourceRelation());
+			InterpreterRelation& delta = interpreter.getRelation(
+					latmerge.getDeltaRelation());
+
+			// only the cells whose lattice element went up are touched
+			for (const RamDomain* tuple : source) {
+				if (target.join(tuple)) {
+					delta.insert(target.getCell(tuple));
+				}
+			}
+			return true;
+		}
+
 		// Plan A TODO, use RamDomain lat_Top to optimize
 //		bool visitLatExt(const RamLatExt& latext) override {
 ////			std::cout << "\n visit LatExt here! relation: " << latext.getRelation_IN_Origin().getName() << std::endl;
@@ -1472,6 +2012,134 @@ void Interpreter::evalStmt(const RamStatement& stmt) {
 	StatementEvaluator(*this).visit(stmt);
 }
 
+/** Evaluate lattice unary function */
+RamDomain Interpreter::evalLatticeUnaryFunction(
+		const RamLatticeUnaryFunction& func, RamDomain arg) {
+	RamDomain res;
+	if (func.getTable().lookup(arg, res)) {
+		return res;
+	}
+
+	InterpreterContext ctxt;
+	std::vector<RamDomain> args = { arg };
+	ctxt.setArguments(args);
+
+	// the first case whose constraint holds determines the output
+	auto pos = latticeCases.find(&func);
+	assert(pos != latticeCases.end() && "lattice function not lowered");
+	for (const auto& cas : pos->second) {
+		if (!cas.condition || cas.condition(ctxt)) {
+			return cas.output(ctxt);
+		}
+	}
+
+	std::cerr << "Failed to find a match for a lattice unary functor!"
+			<< std::endl;
+	exit(1);
+}
+
+/** Evaluate lattice binary function */
+RamDomain Interpreter::evalLatticeBinaryFunction(
+		const RamLatticeBinaryFunction& func, RamDomain lhs, RamDomain rhs) {
+	RamDomain res;
+	if (func.getTable().lookup(lhs, rhs, res)) {
+		return res;
+	}
+
+	InterpreterContext ctxt;
+	std::vector<RamDomain> args = { lhs, rhs };
+	ctxt.setArguments(args);
+
+	// the first case whose match condition holds determines the output
+	auto pos = latticeCases.find(&func);
+	assert(pos != latticeCases.end() && "lattice function not lowered");
+	for (const auto& cas : pos->second) {
+		if (!cas.condition || cas.condition(ctxt)) {
+			return cas.output(ctxt);
+		}
+	}
+
+	std::cerr << "Failed to find a match for a lattice binary functor!"
+			<< std::endl;
+	exit(1);
+}
+
+/** Lower the cases of lattice functions into closures */
+void Interpreter::compileLatticeFunctions() {
+	RamProgram* prog = translationUnit.getProgram();
+
+	auto compileUnary = [&](const RamLatticeUnaryFunction& func) {
+		std::vector<LatticeCaseClosure>& cases = latticeCases[&func];
+		for (const auto& cas : func.getLatCase()) {
+			cases.push_back( { (cas.constraint) ?
+					compileCond(*cas.constraint) : ConditionClosure(),
+					compileVal(*cas.output) });
+		}
+	};
+
+	auto compileBinary = [&](const RamLatticeBinaryFunction& func) {
+		std::vector<LatticeCaseClosure>& cases = latticeCases[&func];
+		for (const auto& cas : func.getLatCase()) {
+			cases.push_back( { (cas.match) ?
+					compileCond(*cas.match) : ConditionClosure(),
+					compileVal(*cas.output) });
+		}
+	};
+
+	if (prog->hasLattice()) {
+		compileBinary(prog->getLattice()->getLUB());
+		compileBinary(prog->getLattice()->getGLB());
+	}
+	for (const auto& cur : prog->getLUFs()) {
+		compileUnary(*cur.second);
+	}
+	for (const auto& cur : prog->getLBFs()) {
+		compileBinary(*cur.second);
+	}
+}
+
+/** Precompute the outputs of lattice functions over enum arguments */
+void Interpreter::tabulateLatticeFunctions() {
+	RamProgram* prog = translationUnit.getProgram();
+
+	auto tabulateUnary = [&](const RamLatticeUnaryFunction& func) {
+		RamLatticeTable& table = func.getTable();
+		if (table.getArity() == 0 || table.isComputed()) {
+			return;
+		}
+		std::vector<RamDomain> outputs;
+		for (RamDomain arg : table.getDomain(0)) {
+			outputs.push_back(evalLatticeUnaryFunction(func, arg));
+		}
+		table.setOutputs(std::move(outputs));
+	};
+
+	auto tabulateBinary = [&](const RamLatticeBinaryFunction& func) {
+		RamLatticeTable& table = func.getTable();
+		if (table.getArity() == 0 || table.isComputed()) {
+			return;
+		}
+		std::vector<RamDomain> outputs;
+		for (RamDomain lhs : table.getDomain(0)) {
+			for (RamDomain rhs : table.getDomain(1)) {
+				outputs.push_back(evalLatticeBinaryFunction(func, lhs, rhs));
+			}
+		}
+		table.setOutputs(std::move(outputs));
+	};
+
+	if (prog->hasLattice()) {
+		tabulateBinary(prog->getLattice()->getLUB());
+		tabulateBinary(prog->getLattice()->getGLB());
+	}
+	for (const auto& cur : prog->getLUFs()) {
+		tabulateUnary(*cur.second);
+	}
+	for (const auto& cur : prog->getLBFs()) {
+		tabulateBinary(*cur.second);
+	}
+}
+
 /** Execute main program of a translation unit */
 void Interpreter::executeMain() {
 	SignalHandler::instance()->set();
@@ -1480,6 +2148,32 @@ void Interpreter::executeMain() {
 	}
 	const RamStatement& main = *translationUnit.getP().getMain();
 
+	compileLatticeFunctions();
+	tabulateLatticeFunctions();
+#ifdef _OPENMP
+	if (std::stoi(Global::config().get("jobs")) > 0) {
+		omp_set_num_threads(std::stoi(Global::config().get("jobs")));
+	}
+#endif
+	// prepare the subroutines as well, as they run after main
+	assignSlots(main);
+	for (const auto& cur : translationUnit.getP().getSubroutines()) {
+		assignSlots(*cur.second);
+	}
+	compileQueries(main);
+	for (const auto& cur : translationUnit.getP().getSubroutines()) {
+		compileQueries(*cur.second);
+	}
+
+	// run the analyses consulted during the evaluation before strata, or the
+	// subroutines searching subproofs in parallel, may use them concurrently
+	if (Global::config().has("parallel-strata") || Global::config().has("provenance")) {
+		translationUnit.getAnalysis<IndexSetAnalysis>();
+		translationUnit.getAnalysis<RamExistenceCheckAnalysis>();
+		translationUnit.getAnalysis<RamProvenanceExistenceCheckAnalysis>();
+		translationUnit.getAnalysis<RamOperationDepthAnalysis>();
+	}
+
 	if (!Global::config().has("profile")) {
 		evalStmt(main);
 	} else {
@@ -18,7 +18,9 @@
 
 #include "InterpreterContext.h"
 #include "InterpreterRelation.h"
+#include "ParallelUtils.h"
 #include "RamCondition.h"
+#include "RamLatticeFunction.h"
 #include "RamRelation.h"
 #include "RamStatement.h"
 #include "RamTranslationUnit.h"
@@ -28,8 +30,11 @@
 #include <atomic>
 #include <cassert>
 #include <cstdlib>
+#include <deque>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -39,8 +44,10 @@
 
 namespace souffle {
 
+struct FunctorCallSite;
 class InterpreterProgInterface;
 class RamOperation;
+class RamUserDefinedOperator;
 class RamValue;
 class SymbolTable;
 
@@ -50,7 +57,7 @@ class SymbolTable;
 
 class Interpreter {
 public:
-    Interpreter(RamTranslationUnit& tUnit) : translationUnit(tUnit), counter(0), iteration(0), dll(nullptr) {}
+    Interpreter(RamTranslationUnit& tUnit) : translationUnit(tUnit), counter(0), dll(nullptr) {}
     virtual ~Interpreter() {
         for (auto& x : environment) {
             delete x.second;
@@ -85,6 +92,49 @@ protected:
     /** Evaluate statement */
     void evalStmt(const RamStatement& stmt);
 
+    /** Closure evaluating a value in a context */
+    using ValueClosure = std::function<RamDomain(const InterpreterContext&)>;
+
+    /** Closure evaluating a condition in a context */
+    using ConditionClosure = std::function<bool(const InterpreterContext&)>;
+
+    /** Closure executing an operation in a context */
+    using OperationClosure = std::function<void(InterpreterContext&)>;
+
+    /** Lower value into a closure with its constants and analyses resolved */
+    ValueClosure compileVal(const RamValue& value);
+
+    /** Lower condition into a closure with its constants and analyses resolved */
+    ConditionClosure compileCond(const RamCondition& cond);
+
+    /** Lower operation into a closure with its constants and analyses resolved;
+     *  a parallel operation spreads its outermost loop over all threads */
+    OperationClosure compileOp(const RamOperation& op, bool parallel = false);
+
+    /** Check whether the outermost loop of a query may be spread over threads */
+    bool isParallelQuery(const RamOperation& op) const;
+
+    /** Lower the queries, fact values and conditions of a statement ahead of the evaluation */
+    void compileQueries(const RamStatement& stmt);
+
+    /** Plan the indexes of a relation chosen by the index set analysis */
+    void planIndexes(InterpreterRelation& rel, const RamRelationReference& id);
+
+    /** Evaluate lattice unary function */
+    RamDomain evalLatticeUnaryFunction(const RamLatticeUnaryFunction& func, RamDomain arg);
+
+    /** Evaluate lattice binary function */
+    RamDomain evalLatticeBinaryFunction(const RamLatticeBinaryFunction& func, RamDomain lhs, RamDomain rhs);
+
+    /** Get the call site of a user-defined functor, shared by all its lowerings */
+    std::shared_ptr<FunctorCallSite> getCallSite(const RamUserDefinedOperator& op);
+
+    /** Lower the cases of lattice functions ahead of the evaluation */
+    void compileLatticeFunctions();
+
+    /** Precompute lattice functions over enum arguments */
+    void tabulateLatticeFunctions();
+
     /** Get symbol table */
     SymbolTable& getSymbolTable() {
         return translationUnit.getSymbolTable();
@@ -95,44 +145,40 @@ protected:
         return counter;
     }
 
-    /** Get Iteration Number */
-    size_t getIterationNumber() const {
-        return iteration;
-    }
-
     /** Increment counter */
     int incCounter() {
         return counter++;
     }
 
-    /** Increment iteration number */
-    void incIterationNumber() {
-        iteration++;
-    }
-
-    /** Reset iteration number */
-    void resetIterationNumber() {
-        iteration = 0;
-    }
-
     /** Create relation */
     void createRelation(const RamRelationReference& id) {
+        auto lease = environmentLock.acquire();
         InterpreterRelation* res = nullptr;
         assert(environment.find(id.getName()) == environment.end());
         if (id.getRepresentation() == RelationRepresentation::EQREL) {
             res = new InterpreterEqRelation(id.getArity());
+        } else if (id.getRepresentation() == RelationRepresentation::LATTICE) {
+            RamLatticeAssociation* lattice = translationUnit.getProgram()->getLattice();
+            res = new InterpreterLatticeRelation(id.getArity(),
+                    [this, lattice](RamDomain lhs, RamDomain rhs) {
+                        return evalLatticeBinaryFunction(lattice->getLUB(), lhs, rhs);
+                    },
+                    lattice->getTop());
         } else {
             res = new InterpreterRelation(id.getArity());
         }
+
+        planIndexes(*res, id);
         environment[id.getName()] = res;
+        getSlot(id.getName()) = res;
     }
 
     /** Get relation */
     InterpreterRelation& getRelation(const std::string& name) {
         // look up relation
-        auto pos = environment.find(name);
-        assert(pos != environment.end());
-        return *pos->second;
+        InterpreterRelation* rel = getSlot(name);
+        assert(rel != nullptr);
+        return *rel;
     }
 
     /** Get relation */
@@ -140,6 +186,32 @@ protected:
         return getRelation(id.getName());
     }
 
+    /** Get the slot of a relation; slots are assigned ahead of the evaluation,
+     *  so that strata and parallel queries look them up without a lock */
+    InterpreterRelation*& getSlot(const std::string& name) {
+        auto pos = slots.find(name);
+        assert(pos != slots.end() && "relation without slot");
+        return relations[pos->second];
+    }
+
+    /** Assign the next slot to a relation unless it has one */
+    void addSlot(const std::string& name) {
+        auto lease = slotsLock.acquire();
+        if (slots.find(name) == slots.end()) {
+            slots[name] = relations.size();
+            relations.push_back(nullptr);
+        }
+    }
+
+    /** Resolve a relation reference to its slot, whose address stays valid and
+     *  holds the relation currently bound to the name */
+    InterpreterRelation* const* resolveRelation(const RamRelationReference& id) {
+        return &getSlot(id.getName());
+    }
+
+    /** Assign slots to all relations of a statement ahead of the evaluation */
+    void assignSlots(const RamStatement& stmt);
+
     /** Get relation map */
     relation_map& getRelationMap() const {
         return const_cast<relation_map&>(environment);
@@ -147,21 +219,27 @@ protected:
 
     /** Drop relation */
     void dropRelation(const RamRelationReference& id) {
+        auto lease = environmentLock.acquire();
         InterpreterRelation& rel = getRelation(id);
         environment.erase(id.getName());
+        getSlot(id.getName()) = nullptr;
         delete &rel;
     }
 
     /** Swap relation */
     void swapRelation(const RamRelationReference& ramRel1, const RamRelationReference& ramRel2) {
+        auto lease = environmentLock.acquire();
         InterpreterRelation* rel1 = &getRelation(ramRel1);
         InterpreterRelation* rel2 = &getRelation(ramRel2);
         environment[ramRel1.getName()] = rel2;
         environment[ramRel2.getName()] = rel1;
+        std::swap(getSlot(ramRel1.getName()), getSlot(ramRel2.getName()));
     }
 
     /** Load dll */
     void* loadDLL() {
+        auto lease = dllLock.acquire();
+        (void)lease;
         if (dll == nullptr) {
             // check environment variable
             std::string fname = SOUFFLE_DLL;
@@ -183,20 +261,57 @@ private:
     /** relation environment */
     relation_map environment;
 
+    /** lock for changes of the environment by concurrent strata */
+    Lock environmentLock;
+
+    /** slots of relations by name */
+    std::map<std::string, size_t> slots;
+
+    /** lock for adding slots; the slots are only read once the evaluation starts */
+    Lock slotsLock;
+
+    /** relations by slot; a deque keeps the slot addresses held by closures stable */
+    std::deque<InterpreterRelation*> relations;
+
     /** counters for atom profiling */
     std::map<std::string, std::map<size_t, size_t>> frequencies;
 
     /** counters for non-existence checks */
     std::map<std::string, std::atomic<size_t>> reads;
 
-    /** counter for $ operator */
-    int counter;
+    /** queries lowered into closures ahead of the evaluation, by their operation */
+    std::map<const RamOperation*, OperationClosure> queries;
+
+    /** values of facts lowered into closures ahead of the evaluation */
+    std::map<const RamValue*, ValueClosure> values;
+
+    /** conditions of inserts and loop exits lowered into closures ahead of the evaluation */
+    std::map<const RamCondition*, ConditionClosure> conditions;
+
+    /** case of a lattice function lowered into closures; an empty condition always holds */
+    struct LatticeCaseClosure {
+        ConditionClosure condition;
+        ValueClosure output;
+    };
 
-    /** iteration number (in a fix-point calculation) */
-    size_t iteration;
+    /** cases of lattice functions lowered ahead of the evaluation, by their function;
+     *  consulted only when the table of a function misses */
+    std::map<const RamLatticeFunction*, std::vector<LatticeCaseClosure>> latticeCases;
+
+    /** call sites of user-defined functors, by their operator */
+    std::map<const RamUserDefinedOperator*, std::shared_ptr<FunctorCallSite>> callSites;
+
+    /** lock for adding call sites, e.g. by statements of concurrent strata */
+    Lock callSitesLock;
+
+    /** counter for $ operator */
+    std::atomic<int> counter;
 
     /** Dynamic library for user-defined functors */
     void* dll;
+
+    /** lock for loading the library, e.g. by the threads of a parallel query */
+    Lock dllLock;
 };
 
 }  // end of namespace souffle
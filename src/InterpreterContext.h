@@ -31,6 +31,7 @@ class InterpreterContext {
     std::vector<RamDomain>* returnValues = nullptr;
     std::vector<bool>* returnErrors = nullptr;
     const std::vector<RamDomain>* args = nullptr;
+    size_t iteration = 0;
 
 public:
     InterpreterContext(size_t size = 0) : data(size) {}
@@ -78,6 +79,15 @@ public:
         assert(args != nullptr && i < args->size() && "argument out of range");
         return (*args)[i];
     }
+
+    /** Get the iteration of the fix-point calculation of the stratum running the query */
+    size_t getIteration() const {
+        return iteration;
+    }
+
+    void setIteration(size_t i) {
+        iteration = i;
+    }
 };
 
 }  // end of namespace souffle
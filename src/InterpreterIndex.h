@@ -18,9 +18,20 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "BTree.h"
+#include "CompiledTuple.h"
+#include "EquivalenceRelation.h"
+#include "ParallelUtils.h"
 #include "RamTypes.h"
 #include "Util.h"
 
@@ -136,8 +147,432 @@ public:
 	std::vector<unsigned char> columns;
 };
 
-/* B-Tree indexes as default implementation for indexes */
+/* B-Tree indexes as default implementation for indexes; the tuples of the
+ * relation are copied into the nodes of the tree (see InterpreterInlineIndex) */
 class InterpreterIndex {
+protected:
+	/* storage for the position of an iterator of the underlying b-tree */
+	struct Position {
+		alignas(void*) unsigned char data[2 * sizeof(void*)];
+	};
+
+public:
+	/* maximal arity of the tuples an index decodes for its iterators */
+	static const size_t MAX_DECODED = 8;
+
+	/* iterator over the tuples of an index, yielding pointers into the index;
+	 * tuples stored in another order of columns, or derived by the index, are
+	 * decoded into the iterator */
+	class iterator: public std::iterator<std::forward_iterator_tag,
+			const RamDomain*> {
+	public:
+		iterator() = default;
+
+		const RamDomain* operator*() const {
+			return (tuple != nullptr && index->decodes) ? decoded : tuple;
+		}
+
+		/* tuples are stored at distinct addresses, so they identify the position
+		 * together with the offset of a tuple derived from a stored value */
+		bool operator==(const iterator& other) const {
+			return tuple == other.tuple && offset == other.offset;
+		}
+
+		bool operator!=(const iterator& other) const {
+			return !(*this == other);
+		}
+
+		iterator& operator++() {
+			index->next(*this);
+			return *this;
+		}
+
+	private:
+		friend class InterpreterIndex;
+
+		/* restore the order of the columns of a tuple given in the index order */
+		void decode(const RamDomain* values) {
+			if (tuple != nullptr && index->decodes) {
+				const auto& columns = index->theOrder.columns;
+				for (size_t i = 0; i < columns.size(); i++) {
+					decoded[columns[i]] = values[i];
+				}
+			}
+		}
+
+		const InterpreterIndex* index = nullptr;
+		const RamDomain* tuple = nullptr;
+		size_t offset = 0;
+		Position pos;
+		RamDomain decoded[MAX_DECODED];
+	};
+
+	/* ranges of an index covering about the same number of tuples */
+	using chunks = std::vector<std::pair<iterator, iterator>>;
+
+	InterpreterIndex(InterpreterIndexOrder order, bool decodes = false) :
+			theOrder(std::move(order)), decodes(decodes) {
+	}
+
+	virtual ~InterpreterIndex() = default;
+
+	/** create an index for the given complete order */
+	static std::unique_ptr<InterpreterIndex> create(
+			const InterpreterIndexOrder& order);
+
+	const InterpreterIndexOrder& order() const {
+		return theOrder;
+	}
+
+	/**
+	 * add tuple to the index
+	 *
+	 * precondition: tuple does not exist in the index
+	 */
+	virtual void insert(const RamDomain* tuple) = 0;
+
+	/**
+	 * add tuples to the index via an iterator
+	 *
+	 * precondition: the tuples do not exist in the index
+	 */
+	template<class Iter>
+	void insert(const Iter& a, const Iter& b) {
+		for (auto it = a; it != b; ++it) {
+			insert(*it);
+		}
+	}
+
+	/**
+	 * add tuples to the index in bulk, sorting them in parallel first
+	 *
+	 * precondition: the tuples are distinct and do not exist in the index
+	 */
+	virtual void bulkInsert(const std::vector<const RamDomain*>& tuples) = 0;
+
+	/** check whether the index stores copies of the tuples, not pointers to them */
+	virtual bool storesCopies() const = 0;
+
+	/** check whether the index derives its tuples while iterating, such that
+	 *  they do not outlive the iterator yielding them */
+	virtual bool derivesTuples() const {
+		return false;
+	}
+
+	/**
+	 * add a copy of a tuple to the index unless it exists already, from one
+	 * of several threads inserting concurrently; returns whether it was added
+	 *
+	 * precondition: the index stores copies of the tuples
+	 */
+	virtual bool insertCopy(const RamDomain* tuple) = 0;
+
+	/** check whether tuple exists in index */
+	virtual bool exists(const RamDomain* value) const = 0;
+
+	/**
+	 * overwrite the last column of the tuple agreeing with the given tuple on
+	 * all other columns
+	 *
+	 * precondition: the order ends with the last column and such a tuple exists
+	 */
+	virtual void updateLast(const RamDomain* tuple) = 0;
+
+	/** purge all hashes of index */
+	virtual void purge() = 0;
+
+	/** enables the index to be printed */
+	virtual void print(std::ostream& out) const = 0;
+
+	iterator begin() const {
+		return LowerBound(nullptr);
+	}
+
+	iterator end() const {
+		return iterator();
+	}
+
+	/** return start and end iterator of an equal range */
+	inline std::pair<iterator, iterator> equalRange(
+			const RamDomain* value) const {
+		return lowerUpperBound(value, value);
+	}
+
+	/** return start iterator of a range, the first tuple if low is nullptr */
+	virtual iterator LowerBound(const RamDomain* low) const = 0;
+
+	/** return end iterator of a range */
+	virtual iterator UpperBound(const RamDomain* high) const = 0;
+
+	/** return start and end iterator of a range */
+	inline std::pair<iterator, iterator> lowerUpperBound(const RamDomain* low,
+			const RamDomain* high) const {
+		return std::pair<iterator, iterator>(LowerBound(low), UpperBound(high));
+	}
+
+	/** return the last tuple not greater than the given one, the end if there is none */
+	virtual iterator floor(const RamDomain* high) const = 0;
+
+	/** count the tuples of a range */
+	virtual size_t count(const RamDomain* low, const RamDomain* high) const {
+		auto range = lowerUpperBound(low, high);
+		return std::distance(range.first, range.second);
+	}
+
+	/** split a range into up to num chunks of about the same size, e.g. for a
+	 *  parallel scan; the index must not be updated meanwhile */
+	virtual chunks partition(const iterator& a, const iterator& b,
+			size_t num) const = 0;
+
+protected:
+	/** advance an iterator of this index that is not at the end */
+	virtual void next(iterator& it) const = 0;
+
+	/** point an iterator at a tuple, given by its values in the index order;
+	 *  a tuple derived from a stored value is identified by its offset */
+	void load(iterator& it, const RamDomain* tuple, const RamDomain* values,
+			size_t offset = 0) const {
+		it.tuple = tuple;
+		it.offset = offset;
+		it.decode(values);
+	}
+
+	/** point an iterator at a stored tuple */
+	void load(iterator& it, const RamDomain* tuple) const {
+		load(it, tuple, tuple);
+	}
+
+	/** wrap a position of the underlying data structure, e.g. a b-tree iterator */
+	template<typename Iter>
+	iterator wrap(const Iter& it, const RamDomain* tuple,
+			const RamDomain* values, size_t offset = 0) const {
+		static_assert(sizeof(Iter) <= sizeof(Position), "b-tree iterator too large");
+		static_assert(std::is_trivially_destructible<Iter>::value,
+				"b-tree iterator needs cleanup");
+		iterator res;
+		res.index = this;
+		new (res.pos.data) Iter(it);
+		load(res, tuple, values, offset);
+		return res;
+	}
+
+	/** wrap an iterator of the underlying b-tree */
+	template<typename Iter>
+	iterator wrap(const Iter& it, const RamDomain* tuple) const {
+		return wrap(it, tuple, tuple);
+	}
+
+	/** access the position stored in an iterator */
+	template<typename Iter>
+	static Iter& unwrap(iterator& it) {
+		return *reinterpret_cast<Iter*>(it.pos.data);
+	}
+
+	/** access the position stored in an iterator that is not at the end */
+	template<typename Iter>
+	static const Iter& unwrap(const iterator& it) {
+		return *reinterpret_cast<const Iter*>(it.pos.data);
+	}
+
+	/** get the b-tree iterator of an iterator, the end of the set for end() */
+	template<typename Set>
+	static typename Set::iterator position(const Set& set, const iterator& it) {
+		return (it.tuple != nullptr) ?
+				unwrap<typename Set::iterator>(it) : set.end();
+	}
+
+	/** split a range of the b-tree set into chunks */
+	template<typename Set, typename Wrap>
+	static chunks partitionSet(const Set& set, const iterator& a,
+			const iterator& b, size_t num, const Wrap& wrapSet) {
+		chunks res;
+		for (const auto& cur : Set::iterator::partition(position(set, a),
+				position(set, b), num)) {
+			res.emplace_back(wrapSet(cur.begin()), wrapSet(cur.end()));
+		}
+		return res;
+	}
+
+	// retain the index order used to construct an object of this class
+	const InterpreterIndexOrder theOrder;
+
+	// whether tuples are stored in the index order, not in that of the relation
+	const bool decodes;
+};
+
+/**
+ * Index storing copies of the tuples of a relation with the given arity in
+ * its b-tree nodes, such that scans and lookups do not leave the tree. The
+ * columns are stored in the index order, so stored tuples compare
+ * lexicographically; iterators decode them into the order of the relation.
+ */
+template<size_t Arity>
+class InterpreterInlineIndex: public InterpreterIndex {
+public:
+	using tuple_type = std::array<RamDomain, Arity>;
+
+	/* lexicographical comparison operation on two stored tuples */
+	struct comparator {
+		/* comparison function */
+		int operator()(const tuple_type& x, const tuple_type& y) const {
+			for (size_t i = 0; i < Arity; i++) {
+				if (x[i] < y[i]) {
+					return -1;
+				}
+				if (x[i] > y[i]) {
+					return 1;
+				}
+			}
+			return 0;
+		}
+
+		/* less comparison */
+		bool less(const tuple_type& x, const tuple_type& y) const {
+			return operator()(x, y) < 0;
+		}
+
+		/* equal comparison */
+		bool equal(const tuple_type& x, const tuple_type& y) const {
+			return x == y;
+		}
+	};
+
+	/* btree for storing tuples with a given lexicographical order; as the
+	 * order covers all columns, each tuple is stored once */
+	using index_set = btree_set<tuple_type, comparator, std::allocator<tuple_type>, 512>;
+
+	InterpreterInlineIndex(const InterpreterIndexOrder& order) :
+			InterpreterIndex(order, !isIdentity(order)) {
+		static_assert(Arity <= MAX_DECODED, "tuples too large to decode");
+		for (size_t i = 0; i < Arity; i++) {
+			columns[i] = order[i];
+		}
+	}
+
+	void insert(const RamDomain* tuple) override {
+		set.insert(encode(tuple), hints);
+	}
+
+	void bulkInsert(const std::vector<const RamDomain*>& tuples) override {
+		std::vector<tuple_type> sorted(tuples.size());
+#pragma omp parallel for
+		for (size_t i = 0; i < tuples.size(); i++) {
+			sorted[i] = encode(tuples[i]);
+		}
+		const comparator comp;
+		parallelSort(sorted.begin(), sorted.end(),
+				[&](const tuple_type& x, const tuple_type& y) {return comp.less(x, y);});
+		set.insertSorted(sorted.begin(), sorted.end());
+		hints.clear();
+	}
+
+	bool storesCopies() const override {
+		return true;
+	}
+
+	bool insertCopy(const RamDomain* tuple) override {
+		// the hints are not shared between threads
+		return set.insert(encode(tuple));
+	}
+
+	bool exists(const RamDomain* value) const override {
+		return set.find(encode(value)) != set.end();
+	}
+
+	/* the last column is stored last, as the order ends with it */
+	void updateLast(const RamDomain* tuple) override {
+		tuple_type key = encode(tuple);
+		key[Arity - 1] = MIN_RAM_DOMAIN;
+		auto pos = set.lower_bound(key);
+		assert(pos != set.end());
+		const_cast<tuple_type&>(*pos)[Arity - 1] = tuple[Arity - 1];
+	}
+
+	void purge() override {
+		set.clear();
+		hints.clear();
+	}
+
+	void print(std::ostream& out) const override {
+		set.printStats(out);
+		out << "\n";
+	}
+
+	iterator LowerBound(const RamDomain* low) const override {
+		return wrapSet(low ? set.lower_bound(encode(low)) : set.begin());
+	}
+
+	iterator UpperBound(const RamDomain* high) const override {
+		return wrapSet(set.upper_bound(encode(high)));
+	}
+
+	iterator floor(const RamDomain* high) const override {
+		return wrapSet(set.floor(encode(high)));
+	}
+
+	size_t count(const RamDomain* low, const RamDomain* high) const override {
+		return set.rank(set.upper_bound(encode(high))) - (low ? set.rank(set.lower_bound(encode(low))) : 0);
+	}
+
+	chunks partition(const iterator& a, const iterator& b, size_t num) const override {
+		return partitionSet(set, a, b, num,
+				[this](const typename index_set::iterator& it) {return wrapSet(it);});
+	}
+
+protected:
+	void next(iterator& it) const override {
+		auto& cur = unwrap<typename index_set::iterator>(it);
+		++cur;
+		load(it, tupleAt(cur));
+	}
+
+private:
+	/* check whether an order keeps the columns of the relation in place */
+	static bool isIdentity(const InterpreterIndexOrder& order) {
+		for (size_t i = 0; i < Arity; i++) {
+			if (order[i] != i) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/* copy a tuple of the relation, its columns put in the index order */
+	tuple_type encode(const RamDomain* tuple) const {
+		tuple_type res;
+		if (decodes) {
+			for (size_t i = 0; i < Arity; i++) {
+				res[i] = tuple[columns[i]];
+			}
+		} else {
+			for (size_t i = 0; i < Arity; i++) {
+				res[i] = tuple[i];
+			}
+		}
+		return res;
+	}
+
+	const RamDomain* tupleAt(const typename index_set::iterator& it) const {
+		return (it != set.end()) ? (*it).data() : nullptr;
+	}
+
+	iterator wrapSet(const typename index_set::iterator& it) const {
+		return wrap(it, tupleAt(it));
+	}
+
+	// columns of the relation in the index order
+	std::array<unsigned char, Arity> columns;
+	// set storing the tuples of the relation
+	index_set set;
+	// hints exploiting locality of consecutive insertions
+	typename index_set::operation_hints hints;
+};
+
+/**
+ * Index storing pointers to the tuples of a relation, for arities too large
+ * for InterpreterInlineIndex.
+ */
+class InterpreterPointerIndex: public InterpreterIndex {
 public:
 	/* lexicographical comparison operation on two tuple pointers */
 	struct comparator {
@@ -180,89 +615,490 @@ public:
 	/* btree for storing tuple pointers with a given lexicographical order */
 	using index_set = btree_multiset<const RamDomain*, comparator, std::allocator<const RamDomain*>, 512>;
 
-	using iterator = index_set::iterator;
-
-	InterpreterIndex(InterpreterIndexOrder order) :
-			theOrder(std::move(order)), set(comparator(theOrder),
+	InterpreterPointerIndex(InterpreterIndexOrder order) :
+			InterpreterIndex(std::move(order)), set(comparator(theOrder),
 					comparator(theOrder)) {
 	}
 
-	const InterpreterIndexOrder& order() const {
-		return theOrder;
+	void insert(const RamDomain* tuple) override {
+		set.insert(tuple);
 	}
 
-	/**
-	 * add tuple to the index
-	 *
-	 * precondition: tuple does not exist in the index
-	 */
-	void insert(const RamDomain* tuple) {
-		set.insert(tuple);
+	void bulkInsert(const std::vector<const RamDomain*>& tuples) override {
+		std::vector<const RamDomain*> sorted(tuples);
+		const comparator comp(theOrder);
+		parallelSort(sorted.begin(), sorted.end(),
+				[&](const RamDomain* x, const RamDomain* y) {return comp.less(x, y);});
+		set.insertSorted(sorted.begin(), sorted.end());
 	}
 
-	/**
-	 * add tuples to the index via an iterator
-	 *
-	 * precondition: the tuples do not exist in the index
-	 */
-	template<class Iter>
-	void insert(const Iter& a, const Iter& b) {
-		set.insert(a, b);
+	bool storesCopies() const override {
+		return false;
 	}
-	;
 
-	/** check whether tuple exists in index */
-	bool exists(const RamDomain* value) {
+	bool insertCopy(const RamDomain* tuple) override {
+		assert(false && "pointer index does not store copies of tuples");
+		return false;
+	}
+
+	bool exists(const RamDomain* value) const override {
 		return set.find(value) != set.end();
 	}
 
-	/** purge all hashes of index */
-	void purge() {
+	/* the pointed-to tuple has been updated already */
+	void updateLast(const RamDomain* tuple) override {
+	}
+
+	void purge() override {
 		set.clear();
 	}
 
-	/** enables the index to be printed */
-	void print(std::ostream& out) const {
+	void print(std::ostream& out) const override {
 		set.printStats(out);
 		out << "\n";
 		set.printTree(out);
 	}
 
-	iterator begin() {
-		return set.begin();
+	iterator LowerBound(const RamDomain* low) const override {
+		return wrapSet(low ? set.lower_bound(low) : set.begin());
 	}
 
-	iterator end() {
-		return set.end();
+	iterator UpperBound(const RamDomain* high) const override {
+		return wrapSet(set.upper_bound(high));
 	}
 
-	/** return start and end iterator of an equal range */
-	inline std::pair<iterator, iterator> equalRange(
-			const RamDomain* value) const {
-		return lowerUpperBound(value, value);
+	iterator floor(const RamDomain* high) const override {
+		return wrapSet(set.floor(high));
 	}
 
-	/** return start iterator of a range */
-	inline iterator LowerBound(const RamDomain* low) const {
-		return set.lower_bound(low);
+	size_t count(const RamDomain* low, const RamDomain* high) const override {
+		return set.rank(set.upper_bound(high)) - (low ? set.rank(set.lower_bound(low)) : 0);
 	}
 
-	/** return end iterator of a range */
-	inline iterator UpperBound(const RamDomain* high) const {
-		return set.upper_bound(high);
+	chunks partition(const iterator& a, const iterator& b, size_t num) const override {
+		return partitionSet(set, a, b, num,
+				[this](const index_set::iterator& it) {return wrapSet(it);});
 	}
-	/** return start and end iterator of a range */
-	inline std::pair<iterator, iterator> lowerUpperBound(const RamDomain* low,
-			const RamDomain* high) const {
-		return std::pair<iterator, iterator>(set.lower_bound(low),
-				set.upper_bound(high));
+
+protected:
+	void next(iterator& it) const override {
+		auto& cur = unwrap<index_set::iterator>(it);
+		++cur;
+		load(it, tupleAt(cur));
 	}
 
 private:
-	// retain the index order used to construct an object of this class
-	const InterpreterIndexOrder theOrder;
+	const RamDomain* tupleAt(const index_set::iterator& it) const {
+		return (it != set.end()) ? *it : nullptr;
+	}
+
+	iterator wrapSet(const index_set::iterator& it) const {
+		return wrap(it, tupleAt(it));
+	}
+
 	// set storing tuple pointers of table
 	index_set set;
 };
 
+/**
+ * The pairs of an equivalence relation, kept as the disjoint sets of its
+ * elements. Once the sets changed, the elements of each set are sorted again
+ * and the pairs are derived from them, so no pair is ever stored.
+ */
+class InterpreterEqrelClasses {
+public:
+	InterpreterEqrelClasses() = default;
+
+	InterpreterEqrelClasses(const InterpreterEqrelClasses&) = delete;
+
+	/** add the pair of two elements, joining their sets; safe for several threads */
+	void insert(RamDomain a, RamDomain b) {
+		sets.insert(a, b);
+		stale.store(true, std::memory_order_release);
+	}
+
+	/** add the pairs of another equivalence relation, joining the sets in parallel */
+	void insertAll(const InterpreterEqrelClasses& other) {
+		sets.insertAll(other.sets);
+		stale.store(true, std::memory_order_release);
+	}
+
+	/** join the sets of another equivalence relation that share an element
+	 *  with this one into it, in parallel */
+	void extend(const InterpreterEqrelClasses& other) {
+		sets.extend(other.sets);
+		stale.store(true, std::memory_order_release);
+	}
+
+	/** check whether two elements form a pair */
+	bool contains(RamDomain a, RamDomain b) const {
+		return sets.contains(a, b);
+	}
+
+	/** get the number of pairs */
+	size_t size() const {
+		refresh();
+		return before.back();
+	}
+
+	/** remove all pairs */
+	void clear() {
+		sets.clear();
+		stale.store(true, std::memory_order_release);
+	}
+
+private:
+	friend class InterpreterEqrelIndex;
+
+	/** sort the elements of the sets unless they are up to date */
+	void refresh() const {
+		if (!stale.load(std::memory_order_acquire)) {
+			return;
+		}
+		auto lease = lock.acquire();
+		(void) lease;
+		if (!stale.load(std::memory_order_acquire)) {
+			return;
+		}
+
+		// the elements of each set, sorted
+		sets.collectSets(members, offsets);
+		const size_t numSets = offsets.size() - 1;
+#pragma omp parallel for schedule(dynamic, 64)
+		for (size_t s = 0; s < numSets; s++) {
+			std::sort(members.begin() + offsets[s], members.begin() + offsets[s + 1]);
+		}
+
+		// all elements, sorted, along with their sets
+		std::vector<std::pair<RamDomain, size_t>> sorted(members.size());
+#pragma omp parallel for schedule(dynamic, 64)
+		for (size_t s = 0; s < numSets; s++) {
+			for (size_t i = offsets[s]; i < offsets[s + 1]; i++) {
+				sorted[i] = std::make_pair(members[i], s);
+			}
+		}
+		parallelSort(sorted.begin(), sorted.end(),
+				[](const std::pair<RamDomain, size_t>& x,
+						const std::pair<RamDomain, size_t>& y) {return x.first < y.first;});
+		elements.resize(sorted.size());
+		setOf.resize(sorted.size());
+		before.resize(sorted.size() + 1);
+		before[0] = 0;
+		for (size_t i = 0; i < sorted.size(); i++) {
+			elements[i] = sorted[i].first;
+			setOf[i] = sorted[i].second;
+			before[i + 1] = before[i] + setSize(i);
+		}
+
+		stale.store(false, std::memory_order_release);
+	}
+
+	/** get the number of elements in the set of an element */
+	size_t setSize(size_t element) const {
+		return offsets[setOf[element] + 1] - offsets[setOf[element]];
+	}
+
+	/** get the position of the first element of the set of an element in members */
+	size_t setBegin(size_t element) const {
+		return offsets[setOf[element]];
+	}
+
+	// the disjoint sets of the elements
+	EquivalenceRelation<ram::Tuple<RamDomain, 2>> sets;
+
+	// the elements of the sets, set after set, each set sorted
+	mutable std::vector<RamDomain> members;
+	// the position of each set in members, followed by the number of elements
+	mutable std::vector<size_t> offsets;
+	// all elements, sorted
+	mutable std::vector<RamDomain> elements;
+	// the set of each element
+	mutable std::vector<size_t> setOf;
+	// the number of pairs whose first element precedes each element, followed by all pairs
+	mutable std::vector<size_t> before { 0 };
+
+	// whether the sorted elements lag behind the sets
+	mutable std::atomic<bool> stale { false };
+	// lock for sorting the elements on the first read of several threads
+	mutable Lock lock;
+};
+
+/**
+ * Index over the pairs of an equivalence relation. The pairs of an element are
+ * those with the elements of its set; taking the elements in order and those
+ * of each set in order yields the pairs in lexicographical order, as a b-tree
+ * would hold them. The pairs are symmetric, so the index of the other order of
+ * columns yields the same pairs with the columns swapped.
+ */
+class InterpreterEqrelIndex: public InterpreterIndex {
+public:
+	InterpreterEqrelIndex(const InterpreterIndexOrder& order,
+			InterpreterEqrelClasses& classes) :
+			InterpreterIndex(order, true), classes(classes) {
+		assert(order.size() == 2 && "equivalence relation of arity other than two");
+	}
+
+	void insert(const RamDomain* tuple) override {
+		classes.insert(tuple[0], tuple[1]);
+	}
+
+	void bulkInsert(const std::vector<const RamDomain*>& tuples) override {
+#pragma omp parallel for
+		for (size_t i = 0; i < tuples.size(); i++) {
+			insert(tuples[i]);
+		}
+	}
+
+	bool storesCopies() const override {
+		return false;
+	}
+
+	bool derivesTuples() const override {
+		return true;
+	}
+
+	bool insertCopy(const RamDomain* tuple) override {
+		bool fresh = !exists(tuple);
+		insert(tuple);
+		return fresh;
+	}
+
+	bool exists(const RamDomain* value) const override {
+		return classes.contains(value[0], value[1]);
+	}
+
+	void updateLast(const RamDomain* tuple) override {
+		assert(false && "equivalence relation without lattice column");
+	}
+
+	/* the classes are shared by the indexes of the relation */
+	void purge() override {
+		classes.clear();
+	}
+
+	void print(std::ostream& out) const override {
+		classes.refresh();
+		out << classes.elements.size() << " elements in "
+				<< (classes.offsets.size() - 1) << " sets\n";
+	}
+
+	iterator LowerBound(const RamDomain* low) const override {
+		classes.refresh();
+		if (low == nullptr) {
+			return at(0, 0);
+		}
+		return seek(low[theOrder[0]], low[theOrder[1]], false);
+	}
+
+	iterator UpperBound(const RamDomain* high) const override {
+		classes.refresh();
+		return seek(high[theOrder[0]], high[theOrder[1]], true);
+	}
+
+	iterator floor(const RamDomain* high) const override {
+		size_t r = rank(UpperBound(high));
+		return (r > 0) ? unrank(r - 1) : end();
+	}
+
+	size_t count(const RamDomain* low, const RamDomain* high) const override {
+		return rank(UpperBound(high)) - (low ? rank(LowerBound(low)) : 0);
+	}
+
+	chunks partition(const iterator& a, const iterator& b, size_t num) const override {
+		classes.refresh();
+		chunks res;
+		size_t first = rank(a);
+		size_t last = rank(b);
+		if (first >= last || num == 0) {
+			return res;
+		}
+		size_t step = (last - first + num - 1) / num;
+		for (size_t r = first; r < last; r += step) {
+			res.emplace_back(unrank(r), unrank(std::min(r + step, last)));
+		}
+		return res;
+	}
+
+protected:
+	void next(iterator& it) const override {
+		auto& cur = unwrap<Place>(it);
+		if (++cur.member == classes.setSize(cur.element)) {
+			cur.element++;
+			cur.member = 0;
+		}
+		if (cur.element == classes.elements.size()) {
+			load(it, nullptr);
+			return;
+		}
+		RamDomain values[2];
+		load(it, fill(cur, values), values, cur.member);
+	}
+
+private:
+	/* position of a pair: an element and an element of its set */
+	struct Place {
+		size_t element;
+		size_t member;
+	};
+
+	/* get the pair at a position, the end past the last element */
+	iterator at(size_t element, size_t member) const {
+		if (element >= classes.elements.size()) {
+			return end();
+		}
+		Place place { element, member };
+		RamDomain values[2];
+		const RamDomain* tuple = fill(place, values);
+		return wrap(place, tuple, values, member);
+	}
+
+	/* write the values of the pair at a position in the index order, returning
+	 * the address of its first element, which identifies the position */
+	const RamDomain* fill(const Place& place, RamDomain* values) const {
+		values[0] = classes.elements[place.element];
+		values[1] = classes.members[classes.setBegin(place.element) + place.member];
+		return &classes.elements[place.element];
+	}
+
+	/* find the first pair not less than, or greater than if upper, the given
+	 * pair in the index order */
+	iterator seek(RamDomain first, RamDomain second, bool upper) const {
+		const auto& elements = classes.elements;
+		size_t element = std::lower_bound(elements.begin(), elements.end(), first)
+				- elements.begin();
+		if (element == elements.size() || elements[element] != first) {
+			return at(element, 0);
+		}
+		auto begin = classes.members.begin() + classes.setBegin(element);
+		auto end = begin + classes.setSize(element);
+		size_t member = (upper ? std::upper_bound(begin, end, second) :
+				std::lower_bound(begin, end, second)) - begin;
+		if (member == classes.setSize(element)) {
+			return at(element + 1, 0);
+		}
+		return at(element, member);
+	}
+
+	/* get the number of pairs preceding a position */
+	size_t rank(const iterator& it) const {
+		if (it == end()) {
+			return classes.before.back();
+		}
+		const Place& place = unwrap<Place>(it);
+		return classes.before[place.element] + place.member;
+	}
+
+	/* get the position preceded by the given number of pairs */
+	iterator unrank(size_t r) const {
+		const auto& before = classes.before;
+		if (r >= before.back()) {
+			return end();
+		}
+		size_t element = std::upper_bound(before.begin(), before.end(), r)
+				- before.begin() - 1;
+		return at(element, r - before[element]);
+	}
+
+	// the sets of the relation, shared by its indexes
+	InterpreterEqrelClasses& classes;
+};
+
+inline std::unique_ptr<InterpreterIndex> InterpreterIndex::create(
+		const InterpreterIndexOrder& order) {
+	switch (order.size()) {
+	case 1:
+		return std::make_unique<InterpreterInlineIndex<1>>(order);
+	case 2:
+		return std::make_unique<InterpreterInlineIndex<2>>(order);
+	case 3:
+		return std::make_unique<InterpreterInlineIndex<3>>(order);
+	case 4:
+		return std::make_unique<InterpreterInlineIndex<4>>(order);
+	case 5:
+		return std::make_unique<InterpreterInlineIndex<5>>(order);
+	case 6:
+		return std::make_unique<InterpreterInlineIndex<6>>(order);
+	case 7:
+		return std::make_unique<InterpreterInlineIndex<7>>(order);
+	case 8:
+		return std::make_unique<InterpreterInlineIndex<8>>(order);
+	default:
+		return std::make_unique<InterpreterPointerIndex>(order);
+	}
+}
+
+/* B-Tree index over the key columns of a keyed lattice relation, i.e., all
+ * columns but the last one; as each key has a single cell, the index is a set */
+class InterpreterLatticeIndex {
+public:
+	/* lexicographical comparison operation on the key columns of two tuple pointers */
+	struct comparator {
+		size_t keys;
+
+		/* constructor to initialize state */
+		comparator(size_t keys) :
+				keys(keys) {
+		}
+
+		/* comparison function */
+		int operator()(const RamDomain* x, const RamDomain* y) const {
+			for (size_t i = 0; i < keys; i++) {
+				if (x[i] < y[i]) {
+					return -1;
+				}
+				if (x[i] > y[i]) {
+					return 1;
+				}
+			}
+			return 0;
+		}
+
+		/* less comparison */
+		bool less(const RamDomain* x, const RamDomain* y) const {
+			return operator()(x, y) < 0;
+		}
+
+		/* equal comparison */
+		bool equal(const RamDomain* x, const RamDomain* y) const {
+			for (size_t i = 0; i < keys; i++) {
+				if (x[i] != y[i]) {
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	/* btree for storing the cells of a relation by their key */
+	using index_set = btree_set<const RamDomain*, comparator, std::allocator<const RamDomain*>, 512>;
+
+	InterpreterLatticeIndex(size_t keys) :
+			set(comparator(keys), comparator(keys)) {
+	}
+
+	/**
+	 * add cell to the index
+	 *
+	 * precondition: the key of the cell does not exist in the index
+	 */
+	void insert(const RamDomain* cell) {
+		set.insert(cell);
+	}
+
+	/** get the cell of the key of a tuple, nullptr if there is none */
+	const RamDomain* find(const RamDomain* tuple) const {
+		auto pos = set.find(tuple);
+		return (pos != set.end()) ? *pos : nullptr;
+	}
+
+	/** purge all cells of index */
+	void purge() {
+		set.clear();
+	}
+
+private:
+	// set storing cell pointers of table
+	index_set set;
+};
+
 }  // end of namespace souffle
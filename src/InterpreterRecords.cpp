@@ -15,7 +15,11 @@
  ***********************************************************************/
 
 #include "InterpreterRecords.h"
+#include "CompiledRecord.h"
+#include "ParallelUtils.h"
+#include <algorithm>
 #include <cassert>
+#include <deque>
 #include <limits>
 #include <map>
 #include <vector>
@@ -27,7 +31,17 @@ namespace {
 using namespace std;
 
 /**
- * A bidirectional mapping between tuples and reference indices.
+ * The largest arity of records packed with inline keys into the concurrent record
+ * maps of the compiled execution; larger records use the generic map below.
+ */
+const int MAX_INLINE_ARITY = 16;
+
+/** The types of the functions packing and unpacking records of one arity */
+using PackFunction = RamDomain (*)(const RamDomain*);
+using UnpackFunction = const RamDomain* (*)(RamDomain);
+
+/**
+ * A bidirectional mapping between tuples of any arity and reference indices.
  */
 class RecordMap {
     /** The arity of the stored tuples */
@@ -37,7 +51,10 @@ class RecordMap {
     map<vector<RamDomain>, RamDomain> r2i;
 
     /** The mapping from indices to tuples */
-    vector<vector<RamDomain>> i2r;
+    deque<vector<RamDomain>> i2r;
+
+    /** a lock for the pack and unpack operations */
+    Lock access;
 
 public:
     RecordMap(int arity) : arity(arity), i2r(1) {}  // note: index 0 element left free
@@ -46,43 +63,30 @@ public:
      * Packs the given tuple -- and may create a new reference if necessary.
      */
     RamDomain pack(const RamDomain* tuple) {
-        vector<RamDomain> tmp(arity);
-        for (int i = 0; i < arity; i++) {
-            tmp[i] = tuple[i];
-        }
+        vector<RamDomain> tmp(tuple, tuple + arity);
 
-        RamDomain index;
-#pragma omp critical(record_pack)
-        {
-            auto pos = r2i.find(tmp);
-            if (pos != r2i.end()) {
-                index = pos->second;
-            } else {
-#pragma omp critical(record_unpack)
-                {
-                    i2r.push_back(tmp);
-                    index = i2r.size() - 1;
-                    r2i[tmp] = index;
-
-                    // assert that new index is smaller than the range
-                    assert(index != std::numeric_limits<RamDomain>::max());
-                }
-            }
+        auto lease = access.acquire();
+        (void)lease;  // avoid warning
+        auto pos = r2i.find(tmp);
+        if (pos != r2i.end()) {
+            return pos->second;
         }
+        i2r.push_back(tmp);
+        RamDomain index = i2r.size() - 1;
+        r2i[tmp] = index;
 
+        // assert that new index is smaller than the range
+        assert(index != std::numeric_limits<RamDomain>::max());
         return index;
     }
 
     /**
      * Obtains a pointer to the tuple addressed by the given index.
      */
-    RamDomain* unpack(RamDomain index) {
-        RamDomain* res;
-
-#pragma omp critical(record_unpack)
-        res = &(i2r[index][0]);
-
-        return res;
+    const RamDomain* unpack(RamDomain index) {
+        auto lease = access.acquire();
+        (void)lease;  // avoid warning
+        return i2r[index].data();
     }
 };
 
@@ -92,26 +96,75 @@ public:
 RecordMap& getForArity(int arity) {
     // the static container -- filled on demand
     static map<int, RecordMap> maps;
+    static Lock lock;
+
+    auto lease = lock.acquire();
+    (void)lease;  // avoid warning
+    return maps.emplace(arity, arity).first->second;
+}
+
+/**
+ * Packing and unpacking of records of an arity known at compile time, with
+ * their tuples as keys of the record map of that arity.
+ */
+template <int Arity>
+struct InlineRecords {
+    using tuple_type = ram::Tuple<RamDomain, Arity>;
+
+    static RamDomain pack(const RamDomain* tuple) {
+        tuple_type key;
+        std::copy(tuple, tuple + Arity, key.data);
+        return detail::getRecordMap<tuple_type>().pack(key);
+    }
 
-    // get container if present
-    auto pos = maps.find(arity);
-    if (pos != maps.end()) {
-        return pos->second;
+    static const RamDomain* unpack(RamDomain ref) {
+        return detail::getRecordMap<tuple_type>().unpack(ref).data;
     }
 
-    // create new container if required
-    maps.emplace(arity, arity);
-    return getForArity(arity);
+    /** Register the functions of this arity and all smaller ones */
+    static void enlist(PackFunction* packs, UnpackFunction* unpacks) {
+        packs[Arity] = &pack;
+        unpacks[Arity] = &unpack;
+        InlineRecords<Arity - 1>::enlist(packs, unpacks);
+    }
+};
+
+template <>
+struct InlineRecords<0> {
+    static void enlist(PackFunction*, UnpackFunction*) {}
+};
+
+/**
+ * The pack and unpack functions of records with inline keys, indexed by arity.
+ */
+struct InlineRecordTable {
+    PackFunction packs[MAX_INLINE_ARITY + 1] = {};
+    UnpackFunction unpacks[MAX_INLINE_ARITY + 1] = {};
+
+    InlineRecordTable() {
+        InlineRecords<MAX_INLINE_ARITY>::enlist(packs, unpacks);
+    }
+};
+
+const InlineRecordTable& getInlineRecords() {
+    static const InlineRecordTable table;
+    return table;
 }
 }  // namespace
 
-RamDomain pack(RamDomain* tuple, int arity) {
+RamDomain pack(const RamDomain* tuple, int arity) {
     // conduct the packing
+    if (0 < arity && arity <= MAX_INLINE_ARITY) {
+        return getInlineRecords().packs[arity](tuple);
+    }
     return getForArity(arity).pack(tuple);
 }
 
-RamDomain* unpack(RamDomain ref, int arity) {
+const RamDomain* unpack(RamDomain ref, int arity) {
     // conduct the unpacking
+    if (0 < arity && arity <= MAX_INLINE_ARITY) {
+        return getInlineRecords().unpacks[arity](ref);
+    }
     return getForArity(arity).unpack(ref);
 }
 
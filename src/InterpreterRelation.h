@@ -22,7 +22,11 @@
 
 #include "RamLatticeAssociation.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <vector>
@@ -31,11 +35,29 @@ namespace souffle {
 
 /**
  * Interpreter Relation
+ *
+ * The tuples of a relation of up to 8 columns are stored in its total index
+ * only, which keeps copies of them in its b-tree nodes. Larger tuples and the
+ * cells of lattice relations are stored in blocks, the indexes of larger
+ * tuples pointing into them.
  */
 class InterpreterRelation {
 public:
-	InterpreterRelation(size_t relArity) :
-			arity(relArity), num_tuples(0), totalIndex(nullptr) {
+	InterpreterRelation(size_t relArity, bool inlined = true) :
+			arity(relArity), num_tuples(0), version(nextVersion()), totalIndex(
+					nullptr) {
+		if (inlined && arity > 0) {
+			InterpreterIndexOrder order;
+			for (size_t i = 0; i < arity; i++) {
+				order.append(i);
+			}
+			std::unique_ptr<InterpreterIndex> index = InterpreterIndex::create(order);
+			if (index->storesCopies()) {
+				storage = index.get();
+				totalIndex = storage;
+				indices[order] = std::move(index);
+			}
+		}
 	}
 
 	InterpreterRelation(const InterpreterRelation& other) = delete;
@@ -49,14 +71,20 @@ public:
 
 	/** Check whether relation is empty */
 	bool empty() const {
-		return num_tuples == 0;
+		return size() == 0;
 	}
 
 	/** Gets the number of contained tuples */
-	size_t size() const {
+	virtual size_t size() const {
 		return num_tuples;
 	}
 
+	/** Get a stamp of the contents of this relation, changing with every update;
+	 *  stamps are never shared by different relations */
+	size_t getVersion() const {
+		return version;
+	}
+
 	const InterpreterIndex* getTotalIndex() const {
 		if (!totalIndex) {
 			totalIndex = getIndex(getTotalIndexKey());
@@ -70,7 +98,10 @@ public:
 		// check for null-arity
 		if (arity == 0) {
 			// set number of tuples to one -- that's it
-			num_tuples = 1;
+			if (num_tuples == 0) {
+				num_tuples = 1;
+				touch();
+			}
 			return;
 		}
 
@@ -81,6 +112,166 @@ public:
 			return;
 		}
 
+		store(tuple);
+	}
+
+	/** Insert tuple from one of several threads running a query in parallel;
+	 *  the indexes must have been frozen before */
+	virtual void insertConcurrently(const RamDomain* tuple) {
+		assert(frozen && "concurrent insert without frozen indexes");
+
+		// indexes pointing into the blocks need the tuple stored first
+		if (storage == nullptr) {
+			insertLocked(tuple);
+			return;
+		}
+
+		// the storage admits each tuple once, then the other indexes take
+		// it while other threads insert theirs
+		if (!storage->insertCopy(tuple)) {
+			return;
+		}
+		num_tuples++;
+		touch();
+		for (const auto& cur : indices) {
+			if (cur.second.get() != storage) {
+				cur.second->insertCopy(tuple);
+			}
+		}
+	}
+
+	/** Merge another relation into this relation */
+	virtual void insert(const InterpreterRelation& other) {
+		assert(getArity() == other.getArity());
+		if (arity == 0) {
+			if (num_tuples < other.num_tuples) {
+				num_tuples = other.num_tuples.load();
+				touch();
+			}
+			return;
+		}
+
+		// tuples derived while iterating do not outlive their iterator
+		if (other.storage != nullptr && other.storage->derivesTuples()) {
+			for (const RamDomain* cur : other) {
+				insert(cur);
+			}
+			return;
+		}
+
+		std::vector<const RamDomain*> tuples(other.begin(), other.end());
+		storeAll(tuples);
+	}
+
+	/** Build all planned indexes and the total index, and freeze the set of
+	 *  indexes while the threads of a parallel query insert into this relation */
+	virtual void freezeIndexes() {
+		buildPlannedIndexes();
+		if (arity > 0) {
+			getTotalIndex();
+		}
+		frozen = true;
+	}
+
+	/** Allow indexes to be built again once the parallel inserts are done */
+	void thawIndexes() {
+		frozen = false;
+	}
+
+	/** Insert a range of tuples, e.g. a batch read from a file */
+	template<typename Range>
+	void insertAll(const Range& range) {
+		std::vector<const RamDomain*> tuples(range.begin(), range.end());
+		insertBulk(tuples);
+	}
+
+	/** Insert tuples, which may repeat, adding the new ones to the indexes in bulk */
+	virtual void insertBulk(std::vector<const RamDomain*>& tuples) {
+		if (arity == 0) {
+			if (!tuples.empty()) {
+				insert(tuples.front());
+			}
+			return;
+		}
+
+		// drop the repetitions within the batch
+		size_t width = arity;
+		parallelSort(tuples.begin(), tuples.end(),
+				[width](const RamDomain* x, const RamDomain* y) {
+					return std::lexicographical_compare(x, x + width, y, y + width);
+				});
+		tuples.erase(std::unique(tuples.begin(), tuples.end(),
+				[width](const RamDomain* x, const RamDomain* y) {
+					return std::equal(x, x + width, y);
+				}), tuples.end());
+		storeAll(tuples);
+	}
+
+protected:
+	/** Store the distinct tuples that do not exist yet, adding them to the indexes in bulk */
+	void storeAll(const std::vector<const RamDomain*>& tuples) {
+		// find the new tuples
+		std::vector<char> fresh(tuples.size());
+		getTotalIndex();
+#pragma omp parallel for
+		for (size_t i = 0; i < tuples.size(); i++) {
+			fresh[i] = !exists(tuples[i]);
+		}
+
+		std::vector<const RamDomain*> added;
+		for (size_t i = 0; i < tuples.size(); i++) {
+			if (fresh[i]) {
+				added.push_back(tuples[i]);
+			}
+		}
+		appendAll(added);
+	}
+
+	/** Store distinct tuples known not to exist yet, adding them to the indexes in bulk */
+	void appendAll(const std::vector<const RamDomain*>& tuples) {
+		if (storage != nullptr) {
+			for (const auto& cur : indices) {
+				cur.second->bulkInsert(tuples);
+			}
+			num_tuples += tuples.size();
+			touch();
+			return;
+		}
+		std::vector<const RamDomain*> stored;
+		stored.reserve(tuples.size());
+		for (const RamDomain* cur : tuples) {
+			stored.push_back(append(cur));
+		}
+		for (const auto& cur : indices) {
+			cur.second->bulkInsert(stored);
+		}
+	}
+
+	/** Insert tuple from one of several threads, one at a time */
+	void insertLocked(const RamDomain* tuple) {
+		auto lease = insertLock.acquire();
+		(void) lease;
+		insert(tuple);
+	}
+
+	/** Store a tuple that does not exist yet and add it to all indexes */
+	void store(const RamDomain* tuple) {
+		if (storage != nullptr) {
+			num_tuples++;
+			touch();
+		} else {
+			tuple = append(tuple);
+		}
+
+		// update all indexes with new tuple
+		for (const auto& cur : indices) {
+			cur.second->insert(tuple);
+		}
+	}
+
+	/** Copy a tuple that does not exist yet to the end of the blocks, without indexing it */
+	RamDomain* append(const RamDomain* tuple) {
+		assert(storage == nullptr && "tuples stored in the total index");
 		int blockIndex = num_tuples / (BLOCK_SIZE / arity);
 		int tupleIndex = (num_tuples % (BLOCK_SIZE / arity)) * arity;
 
@@ -93,23 +284,25 @@ public:
 			newTuple[i] = tuple[i];
 		}
 
-		// update all indexes with new tuple
-		for (const auto& cur : indices) {
-			cur.second->insert(newTuple);
-		}
-
 		// increment relation size
 		num_tuples++;
+		touch();
+		return newTuple;
 	}
 
-	/** Merge another relation into this relation */
-	void insert(const InterpreterRelation& other) {
-		assert(getArity() == other.getArity());
-		for (const auto& cur : other) {
-			insert(cur);
+	/** Build the indexes planned for the searches of this relation */
+	void buildPlannedIndexes() {
+		for (const auto& order : plannedOrders) {
+			getIndex(order);
 		}
 	}
 
+	/** Record an update of the contents of this relation */
+	void touch() {
+		version = nextVersion();
+	}
+
+public:
 	/** Find the biggest lattice element for each cell, and insert
 	 *  to both itself and the other relation **/
 	/*latnorm is visided after merge, eg:
@@ -169,12 +362,13 @@ public:
 //		}
 //	}
 	/** Purge table */
-	void purge() {
+	virtual void purge() {
 		blockList.clear();
 		for (const auto& cur : indices) {
 			cur.second->purge();
 		}
 		num_tuples = 0;
+		touch();
 	}
 
 	/** get index for a given set of keys using a cached index as a helper. Keys are encoded as bits for each
@@ -187,8 +381,30 @@ public:
 		return getIndex(cachedIndex->order());
 	}
 
+	/** plan the index of the given order for a search, to be built on its first use */
+	void planIndex(SearchColumns key, const InterpreterIndexOrder& order) {
+		assert(order.isComplete() && order.size() == getArity());
+		size_t slot = 0;
+		while (slot < plannedOrders.size() && plannedOrders[slot].columns != order.columns) {
+			slot++;
+		}
+		if (slot == plannedOrders.size()) {
+			plannedOrders.push_back(order);
+			plannedIndices.emplace_back(nullptr);
+		}
+		plannedSearches[key] = slot;
+	}
+
 	/** get index for a given set of keys. Keys are encoded as bits for each column */
 	InterpreterIndex* getIndex(const SearchColumns& key) const {
+		// use the planned index of the search, built on its first use
+		auto planned = plannedSearches.find(key);
+		if (planned != plannedSearches.end()) {
+			InterpreterIndex* res = plannedIndices[planned->second].load(
+					std::memory_order_acquire);
+			return res ? res : getIndex(plannedOrders[planned->second]);
+		}
+
 		// suffix for order, if no matching prefix exists
 		std::vector<unsigned char> suffix;
 		suffix.reserve(getArity());
@@ -232,22 +448,33 @@ public:
 
 	/** get index for a given order. Keys are encoded as bits for each column */
 	InterpreterIndex* getIndex(const InterpreterIndexOrder& order) const {
-		// TODO: improve index usage by re-using indices with common prefix
-		InterpreterIndex* res = nullptr;
 		{
 			auto lease = lock.acquire();
 			(void) lease;
 			auto pos = indices.find(order);
-			if (pos == indices.end()) {
-				std::unique_ptr<InterpreterIndex>& newIndex = indices[order];
-				newIndex = std::make_unique<InterpreterIndex>(order);
-				newIndex->insert(this->begin(), this->end());
-				res = newIndex.get();
-			} else {
-				res = pos->second.get();
+			if (pos != indices.end()) {
+				return pos->second.get();
 			}
 		}
-		return res;
+
+		// build the index from the sorted tuples without holding the lock; the
+		// tuples do not change meanwhile, as no thread inserts concurrently
+		assert(!frozen && "index built while inserting concurrently");
+		std::unique_ptr<InterpreterIndex> newIndex = InterpreterIndex::create(order);
+		newIndex->bulkInsert(std::vector<const RamDomain*>(begin(), end()));
+
+		auto lease = lock.acquire();
+		(void) lease;
+		std::unique_ptr<InterpreterIndex>& res = indices[order];
+		if (!res) {
+			res = std::move(newIndex);
+			for (size_t i = 0; i < plannedOrders.size(); i++) {
+				if (plannedOrders[i].columns == order.columns) {
+					plannedIndices[i].store(res.get(), std::memory_order_release);
+				}
+			}
+		}
+		return res.get();
 	}
 
 	/** Obtains a full index-key for this relation */
@@ -256,7 +483,7 @@ public:
 	}
 
 	/** check whether a tuple exists in the relation */
-	bool exists(const RamDomain* tuple) const {
+	virtual bool exists(const RamDomain* tuple) const {
 		// handle arity 0
 		if (getArity() == 0) {
 			return !empty();
@@ -276,26 +503,40 @@ public:
 	public:
 		iterator() = default;
 
-		iterator(const InterpreterRelation* const relation) :
-				relation(relation), tuple(
+		/** iterator over the blocks, starting at the given position */
+		iterator(const InterpreterRelation* relation, size_t index) :
+				relation(relation), index(index), tuple(
 						relation->arity == 0 ?
-								reinterpret_cast<RamDomain*>(this) :
-								&relation->blockList[0][0]) {
+								reinterpret_cast<const RamDomain*>(this) :
+								relation->getTuple(index)) {
+		}
+
+		/** iterator over the tuples stored in the total index */
+		iterator(const InterpreterIndex::iterator& stored) :
+				stored(stored) {
 		}
 
 		const RamDomain* operator*() {
-			return tuple;
+			return (relation == nullptr) ? *stored : tuple;
 		}
 
+		/* the iterator over the blocks or that over the total index is the
+		 * default one, so both identify the position */
 		bool operator==(const iterator& other) const {
-			return tuple == other.tuple;
+			return tuple == other.tuple && stored == other.stored;
 		}
 
 		bool operator!=(const iterator& other) const {
-			return (tuple != other.tuple);
+			return !(*this == other);
 		}
 
 		iterator& operator++() {
+			// support tuples stored in the total index
+			if (relation == nullptr) {
+				++stored;
+				return *this;
+			}
+
 			// support 0-arity
 			if (relation->arity == 0) {
 				tuple = nullptr;
@@ -304,23 +545,15 @@ public:
 
 			// support all other arities
 			++index;
-			if (index == relation->num_tuples) {
-				tuple = nullptr;
-				return *this;
-			}
-
-			int blockIndex = index / (BLOCK_SIZE / relation->arity);
-			int tupleIndex = (index % (BLOCK_SIZE / relation->arity))
-					* relation->arity;
-
-			tuple = &relation->blockList[blockIndex][tupleIndex];
+			tuple = relation->getTuple(index);
 			return *this;
 		}
 
 	private:
-		const InterpreterRelation* const relation = nullptr;
+		const InterpreterRelation* relation = nullptr;
 		size_t index = 0;
-		RamDomain* tuple = nullptr;
+		InterpreterIndex::iterator stored;
+		const RamDomain* tuple = nullptr;
 	};
 
 	/** get iterator begin of relation */
@@ -329,8 +562,10 @@ public:
 		if (empty()) {
 			return end();
 		}
-
-		return iterator(this);
+		if (storage != nullptr) {
+			return iterator(storage->begin());
+		}
+		return iterator(this, 0);
 	}
 
 	/** get iterator begin of relation */
@@ -338,6 +573,31 @@ public:
 		return iterator();
 	}
 
+	/** Split the tuples into up to num ranges of about the same size, e.g. for
+	 *  the threads of a parallel scan */
+	std::vector<std::pair<iterator, iterator>> partition(size_t num) const {
+		std::vector<std::pair<iterator, iterator>> res;
+		if (empty()) {
+			return res;
+		}
+		if (storage != nullptr) {
+			for (const auto& cur : storage->partition(storage->begin(),
+					storage->end(), num)) {
+				res.emplace_back(iterator(cur.first), iterator(cur.second));
+			}
+			return res;
+		}
+		if (arity == 0) {
+			res.emplace_back(begin(), end());
+			return res;
+		}
+		size_t step = (num_tuples + num - 1) / num;
+		for (size_t i = 0; i < num_tuples; i += step) {
+			res.emplace_back(iterator(this, i), iterator(this, i + step));
+		}
+		return res;
+	}
+
 	/** Extend tuple */
 	virtual std::vector<RamDomain*> extend(const RamDomain* tuple) {
 		std::vector<RamDomain*> newTuples;
@@ -352,102 +612,325 @@ public:
 	virtual void extend(const InterpreterRelation& rel) {
 	}
 
-private:
+protected:
 	/** Arity of relation */
 	const size_t arity;
 
 	/** Size of blocks containing tuples */
 	static const int BLOCK_SIZE = 1024;
 
-	/** Number of tuples in relation */
-	size_t num_tuples;
+	/** Number of tuples in relation; read by other threads of a parallel query */
+	std::atomic<size_t> num_tuples;
+
+	/** Stamp of the contents of the relation; read by other threads of a parallel query */
+	std::atomic<size_t> version;
 
 	std::deque<std::unique_ptr<RamDomain[]>> blockList;
 
+	/** Total index storing or deriving the tuples instead of the blocks, if any */
+	InterpreterIndex* storage = nullptr;
+
 	/** List of indices */
 	mutable std::map<InterpreterIndexOrder, std::unique_ptr<InterpreterIndex>> indices;
 
 	/** Total index for existence checks */
 	mutable InterpreterIndex* totalIndex;
 
+	/** Orders of the indices planned by the index set analysis */
+	std::vector<InterpreterIndexOrder> plannedOrders;
+
+	/** Planned indices once built, by the position of their order */
+	mutable std::deque<std::atomic<InterpreterIndex*>> plannedIndices;
+
+	/** Position of the planned order of each search */
+	std::map<SearchColumns, size_t> plannedSearches;
+
 	/** Lock for parallel execution */
 	mutable Lock lock;
+
+	/** Lock for inserts of parallel queries */
+	Lock insertLock;
+
+	/** Whether the set of indexes is frozen for inserts of a parallel query;
+	 *  only changed before and after the parallel region */
+	bool frozen = false;
+
+private:
+	/** get the tuple at a position in the blocks, nullptr past the last one */
+	const RamDomain* getTuple(size_t index) const {
+		if (index >= num_tuples) {
+			return nullptr;
+		}
+		return &blockList[index / (BLOCK_SIZE / arity)][(index
+				% (BLOCK_SIZE / arity)) * arity];
+	}
+
+	/** Draw a fresh stamp for the contents of a relation */
+	static size_t nextVersion() {
+		static std::atomic<size_t> counter(0);
+		return ++counter;
+	}
 };
 
 /**
- * Interpreter Equivalence Relation
+ * Interpreter Lattice Relation
+ *
+ * Stores a single lattice cell per key, i.e., per assignment of the first
+ * arity-1 columns; the last column holds the lattice element of the cell.
+ * Inserting a tuple joins its lattice element into the cell in place.
  */
-
-class InterpreterEqRelation: public InterpreterRelation {
+class InterpreterLatticeRelation: public InterpreterRelation {
 public:
-	InterpreterEqRelation(size_t relArity) :
-			InterpreterRelation(relArity) {
+	/** Least upper bound of two lattice elements */
+	using lub_function = std::function<RamDomain(RamDomain, RamDomain)>;
+
+	InterpreterLatticeRelation(size_t relArity, lub_function lub,
+			RamDomain top) :
+			InterpreterRelation(relArity, false), cells(relArity - 1), lub(std::move(lub)), top(top) {
+		assert(relArity > 0 && "lattice relation without lattice column");
 	}
 
 	/** Insert tuple */
 	void insert(const RamDomain* tuple) override {
-		// TODO: (pnappa) an eqrel check here is all that appears to be needed for implicit additions
-		// TODO: future optimisation would require this as a member datatype
-		// brave soul required to pass this quest
-		// // specialisation for eqrel defs
-		// std::unique_ptr<binaryrelation> eqreltuples;
-		// in addition, it requires insert functions to insert into that, and functions
-		// which allow reading of stored values must be changed to accommodate.
-		// e.g. insert =>  eqRelTuples->insert(tuple[0], tuple[1]);
+		join(tuple);
+	}
+
+	/** Insert tuples, joining them one by one */
+	void insertBulk(std::vector<const RamDomain*>& tuples) override {
+		for (const RamDomain* cur : tuples) {
+			join(cur);
+		}
+	}
+
+	/** Insert tuple from one of several threads; cells are joined one at a time */
+	void insertConcurrently(const RamDomain* tuple) override {
+		insertLocked(tuple);
+	}
 
-		// for now, we just have a naive & extremely slow version, otherwise known as a O(n^2) insertion
-		// ):
+	/** Build all planned indexes; cells are found by their own index, so the
+	 *  total index is not needed. Raising a cell drops out-of-order indexes,
+	 *  which only the thread holding the insert lock touches */
+	void freezeIndexes() override {
+		buildPlannedIndexes();
+		frozen = true;
+	}
 
-		for (auto* newTuple : extend(tuple)) {
-			InterpreterRelation::insert(newTuple);
-			delete[] newTuple;
+	/** Merge another relation into this relation, joining tuple by tuple */
+	void insert(const InterpreterRelation& other) override {
+		for (const RamDomain* cur : other) {
+			join(cur);
 		}
 	}
 
-	/** Find the new knowledge generated by inserting a tuple */
-	std::vector<RamDomain*> extend(const RamDomain* tuple) override {
-		std::vector<RamDomain*> newTuples;
+	/** Join the lattice element of a tuple into the cell of its key.
+	 *  Returns true if the cell is new or its lattice element went up. */
+	bool join(const RamDomain* tuple) {
+		RamDomain* cell = findCell(tuple);
+		if (cell == nullptr) {
+			cell = append(tuple);
+			for (const auto& cur : indices) {
+				cur.second->insert(cell);
+			}
+			cells.insert(cell);
+			if (tuple[arity - 1] == top) {
+				saturatedCells++;
+			}
+			return true;
+		}
 
-		newTuples.push_back(new RamDomain[2] { tuple[0], tuple[0] });
-		newTuples.push_back(new RamDomain[2] { tuple[0], tuple[1] });
-		newTuples.push_back(new RamDomain[2] { tuple[1], tuple[0] });
-		newTuples.push_back(new RamDomain[2] { tuple[1], tuple[1] });
-
-		std::vector<const RamDomain*> relevantStored;
-		for (const RamDomain* vals : *this) {
-			if (vals[0] == tuple[0] || vals[0] == tuple[1]
-					|| vals[1] == tuple[0] || vals[1] == tuple[1]) {
-				relevantStored.push_back(vals);
+		RamDomain& value = cell[arity - 1];
+		if (value == top || value == tuple[arity - 1]) {
+			return false;
+		}
+		RamDomain joined = lub(value, tuple[arity - 1]);
+		if (joined == value) {
+			return false;
+		}
+		value = joined;
+		touch();
+		if (joined == top) {
+			saturatedCells++;
+		}
+
+		updateIndices(cell);
+		return true;
+	}
+
+	/** Check whether the cell of the key of a tuple holds a lattice element
+	 *  at least as big as the one of the tuple, i.e., joining would not raise it */
+	bool subsumes(const RamDomain* tuple) const {
+		const RamDomain* cell = findCell(tuple);
+		if (cell == nullptr) {
+			return false;
+		}
+		RamDomain value = cell[arity - 1];
+		return value == top || value == tuple[arity - 1]
+				|| lub(value, tuple[arity - 1]) == value;
+	}
+
+	/** Check whether the cell of the key of a tuple is saturated, i.e., holds
+	 *  the top element; the lattice column of the tuple is ignored */
+	bool isSaturated(const RamDomain* tuple) const {
+		if (saturatedCells == 0) {
+			return false;
+		}
+		const RamDomain* cell = findCell(tuple);
+		return cell != nullptr && cell[arity - 1] == top;
+	}
+
+	/** Check whether a tuple exists in the relation, i.e., is the cell of its key */
+	bool exists(const RamDomain* tuple) const override {
+		const RamDomain* cell = findCell(tuple);
+		return cell != nullptr && cell[arity - 1] == tuple[arity - 1];
+	}
+
+	/** Purge table */
+	void purge() override {
+		InterpreterRelation::purge();
+		cells.purge();
+		saturatedCells = 0;
+	}
+
+	/** Get the cell of the key of a tuple, nullptr if the key has no cell */
+	const RamDomain* getCell(const RamDomain* tuple) const {
+		return findCell(tuple);
+	}
+
+private:
+	/** Find the cell of the key of a tuple */
+	RamDomain* findCell(const RamDomain* tuple) const {
+		return const_cast<RamDomain*>(cells.find(tuple));
+	}
+
+	/** Propagate the raised lattice element of a cell to the indexes. Indexes
+	 *  whose order does not end with the lattice column are out of order now
+	 *  and dropped; they are rebuilt on their next use. The interpreter only
+	 *  plans such orders for searches bounding the lattice column but not the
+	 *  whole key, see Interpreter::planIndexes */
+	void updateIndices(const RamDomain* cell) {
+		auto lease = lock.acquire();
+		(void) lease;
+		for (auto it = indices.begin(); it != indices.end();) {
+			if (it->first[it->first.size() - 1] != arity - 1) {
+				for (size_t i = 0; i < plannedOrders.size(); i++) {
+					if (plannedOrders[i].columns == it->first.columns) {
+						plannedIndices[i].store(nullptr, std::memory_order_release);
+					}
+				}
+				if (totalIndex == it->second.get()) {
+					totalIndex = nullptr;
+				}
+				it = indices.erase(it);
+			} else {
+				it->second->updateLast(cell);
+				++it;
 			}
 		}
+	}
+
+	/** Cells of the relation by their key */
+	InterpreterLatticeIndex cells;
+
+	/** Least upper bound of the lattice */
+	const lub_function lub;
+
+	/** Top element of the lattice */
+	const RamDomain top;
+
+	/** Number of cells holding the top element */
+	std::atomic<size_t> saturatedCells{0};
+};
+
+/**
+ * Interpreter Equivalence Relation
+ *
+ * Keeps the disjoint sets of the elements of a binary equivalence relation;
+ * its two indexes derive the pairs from the sets.
+ */
+class InterpreterEqRelation: public InterpreterRelation {
+public:
+	InterpreterEqRelation(size_t relArity) :
+			InterpreterRelation(relArity, false) {
+		InterpreterIndexOrder order( { 0, 1 });
+		InterpreterIndexOrder swapped( { 1, 0 });
+		indices[order] = std::make_unique<InterpreterEqrelIndex>(order, classes);
+		indices[swapped] = std::make_unique<InterpreterEqrelIndex>(swapped, classes);
+		storage = indices[order].get();
+		totalIndex = storage;
+	}
+
+	/** Gets the number of contained pairs */
+	size_t size() const override {
+		return classes.size();
+	}
+
+	/** Insert tuple, joining the classes of its elements */
+	void insert(const RamDomain* tuple) override {
+		classes.insert(tuple[0], tuple[1]);
+		touch();
+	}
+
+	/** Insert tuples, joining classes in parallel */
+	void insertBulk(std::vector<const RamDomain*>& tuples) override {
+		storage->bulkInsert(tuples);
+		touch();
+	}
 
-		for (const auto vals : relevantStored) {
-			newTuples.push_back(new RamDomain[2] { vals[0], tuple[0] });
-			newTuples.push_back(new RamDomain[2] { vals[0], tuple[1] });
-			newTuples.push_back(new RamDomain[2] { vals[1], tuple[0] });
-			newTuples.push_back(new RamDomain[2] { vals[1], tuple[1] });
-			newTuples.push_back(new RamDomain[2] { tuple[0], vals[0] });
-			newTuples.push_back(new RamDomain[2] { tuple[0], vals[1] });
-			newTuples.push_back(new RamDomain[2] { tuple[1], vals[0] });
-			newTuples.push_back(new RamDomain[2] { tuple[1], vals[1] });
+	/** Insert tuple from one of several threads; the classes admit concurrent joins */
+	void insertConcurrently(const RamDomain* tuple) override {
+		assert(frozen && "concurrent insert without frozen indexes");
+		insert(tuple);
+	}
+
+	/** Merge another relation into this relation */
+	void insert(const InterpreterRelation& other) override {
+		if (const auto* eqrel = dynamic_cast<const InterpreterEqRelation*>(&other)) {
+			classes.insertAll(eqrel->classes);
+		} else {
+			for (const RamDomain* cur : other) {
+				classes.insert(cur[0], cur[1]);
+			}
 		}
+		touch();
+	}
 
-		return newTuples;
+	/**
+	 * Merge a relation into this relation. An equivalence relation being merged
+	 * is extended by the classes of this relation it touches first, such that
+	 * it holds all the new knowledge.
+	 */
+	void merge(InterpreterRelation& added) {
+		added.extend(*this);
+		insert(added);
 	}
-	/** Extend this relation with new knowledge generated by inserting all tuples from a relation */
-	void extend(const InterpreterRelation& rel) override {
+
+	/** Find the new knowledge generated by inserting a tuple */
+	std::vector<RamDomain*> extend(const RamDomain* tuple) override {
+		InterpreterEqrelClasses joined;
+		joined.insert(tuple[0], tuple[1]);
+		joined.extend(classes);
 		std::vector<RamDomain*> newTuples;
-		// store all values that will be implicitly relevant to the those that we will insert
-		for (const auto* tuple : rel) {
-			for (auto* newTuple : extend(tuple)) {
-				newTuples.push_back(newTuple);
+		for (const RamDomain* cur : InterpreterEqrelIndex(InterpreterIndexOrder( { 0, 1 }), joined)) {
+			if (!classes.contains(cur[0], cur[1])) {
+				newTuples.push_back(new RamDomain[2] { cur[0], cur[1] });
 			}
 		}
-		for (const auto* newTuple : newTuples) {
-			InterpreterRelation::insert(newTuple);
-			delete[] newTuple;
+		return newTuples;
+	}
+
+	/** Extend this relation with the classes of an equivalence relation it
+	 *  shares elements with, i.e., the new knowledge generated by inserting
+	 *  this relation into it */
+	void extend(const InterpreterRelation& rel) override {
+		if (const auto* eqrel = dynamic_cast<const InterpreterEqRelation*>(&rel)) {
+			classes.extend(eqrel->classes);
+			touch();
 		}
 	}
+
+private:
+	/** The classes of this relation; its pairs are those within each class */
+	InterpreterEqrelClasses classes;
 };
 
 }  // end of namespace souffle
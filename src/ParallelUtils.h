@@ -17,7 +17,11 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
 
 #ifdef _OPENMP
 
@@ -609,4 +613,114 @@ inline Lock& getOutputLock() {
     return outputLock;
 }
 
+/**
+ * Sorts a random-access range by sorting slices of it in parallel and
+ * merging neighbouring slices pairwise, again in parallel.
+ */
+template <typename Iter, typename Less>
+void parallelSort(Iter begin, Iter end, Less less) {
+    const std::size_t size = end - begin;
+    const std::size_t minSlice = 1 << 14;
+    const std::size_t slices = std::max<std::size_t>(1, std::min<std::size_t>(MAX_THREADS, size / minSlice));
+    if (slices == 1) {
+        std::sort(begin, end, less);
+        return;
+    }
+
+    std::vector<Iter> bounds;
+    for (std::size_t i = 0; i <= slices; i++) {
+        bounds.push_back(begin + (size * i / slices));
+    }
+
+#ifdef IS_PARALLEL
+#pragma omp parallel for
+#endif
+    for (std::size_t i = 0; i < slices; i++) {
+        std::sort(bounds[i], bounds[i + 1], less);
+    }
+
+    for (std::size_t width = 1; width < slices; width *= 2) {
+#ifdef IS_PARALLEL
+#pragma omp parallel for
+#endif
+        for (std::size_t i = 0; i < slices - width; i += 2 * width) {
+            std::inplace_merge(bounds[i], bounds[i + width], bounds[std::min(i + 2 * width, slices)], less);
+        }
+    }
+}
+
+namespace detail {
+
+/**
+ * The state of a graph of tasks run by runTaskGraph().
+ */
+template <typename Task>
+class TaskGraph {
+public:
+    TaskGraph(const std::vector<Task>& tasks, const std::vector<std::vector<std::size_t>>& dependencies)
+            : tasks(tasks), successors(tasks.size()), pending(new std::atomic<std::size_t>[tasks.size()]),
+              threads(MAX_THREADS), running(0) {
+        for (std::size_t i = 0; i < tasks.size(); i++) {
+            pending[i] = dependencies[i].size();
+            for (std::size_t dependency : dependencies[i]) {
+                successors[dependency].push_back(i);
+            }
+        }
+    }
+
+    // runs the given task and spawns the successors it completes
+    void spawn(std::size_t i) {
+#ifdef _OPENMP
+#pragma omp task firstprivate(i)
+#endif
+        {
+#ifdef _OPENMP
+            omp_set_num_threads(std::max(1, threads / ++running));
+#endif
+            tasks[i]();
+            --running;
+            for (std::size_t successor : successors[i]) {
+                if (--pending[successor] == 0) {
+                    spawn(successor);
+                }
+            }
+        }
+    }
+
+private:
+    const std::vector<Task>& tasks;
+    std::vector<std::vector<std::size_t>> successors;
+    std::unique_ptr<std::atomic<std::size_t>[]> pending;
+    const int threads;
+    std::atomic<int> running;
+};
+
+}  // namespace detail
+
+/**
+ * Runs a graph of tasks, starting each task as soon as the tasks it depends on
+ * are complete. Ready tasks run concurrently, each sharing the threads evenly
+ * with the tasks running at its start for its own parallel regions. Tasks only
+ * depend on tasks preceding them, such that they may also run in order.
+ */
+template <typename Task>
+void runTaskGraph(const std::vector<Task>& tasks, const std::vector<std::vector<std::size_t>>& dependencies) {
+    detail::TaskGraph<Task> graph(tasks, dependencies);
+#ifdef _OPENMP
+    // tasks open parallel regions of their own within the region running them
+    const int levels = omp_get_max_active_levels();
+    omp_set_max_active_levels(std::max(levels, omp_get_active_level() + 2));
+#pragma omp parallel
+#pragma omp single
+#endif
+    for (std::size_t i = 0; i < tasks.size(); i++) {
+        if (dependencies[i].empty()) {
+            graph.spawn(i);
+        }
+    }
+#ifdef _OPENMP
+    omp_set_max_active_levels(levels);
+#endif
+}
+
 }  // end of namespace souffle
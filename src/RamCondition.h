@@ -370,6 +370,87 @@ protected:
     }
 };
 
+/**
+ * Subsumption check for a tuple in a keyed lattice relation, i.e.,
+ * the cell of its key holds a lattice element at least as big as its own
+ */
+class RamSubsumptionCheck : public RamAbstractExistenceCheck {
+public:
+    RamSubsumptionCheck(std::unique_ptr<RamRelationReference> rel, std::vector<std::unique_ptr<RamValue>> vals)
+            : RamAbstractExistenceCheck(RN_SubsumptionCheck, std::move(rel), std::move(vals)) {
+        assert(relation->getRepresentation() == RelationRepresentation::LATTICE);
+        assert(values.size() == relation->getArity());
+    }
+
+    /** Print */
+    void print(std::ostream& os) const override {
+        os << "(" << join(values, ",", print_deref<std::unique_ptr<RamValue>>()) << ") ⊑ "
+           << relation->getName();
+    }
+
+    /** Create clone */
+    RamSubsumptionCheck* clone() const override {
+        std::vector<std::unique_ptr<RamValue>> newValues;
+        for (auto& cur : values) {
+            newValues.emplace_back(cur->clone());
+        }
+        RamSubsumptionCheck* res = new RamSubsumptionCheck(
+                std::unique_ptr<RamRelationReference>(relation->clone()), std::move(newValues));
+        return res;
+    }
+
+protected:
+    /** Check equality */
+    bool equal(const RamNode& node) const override {
+        assert(nullptr != dynamic_cast<const RamSubsumptionCheck*>(&node));
+        return RamAbstractExistenceCheck::equal(node);
+    }
+};
+
+/**
+ * Saturation check for a key in a keyed lattice relation, i.e.,
+ * the cell of the key holds the top element; the lattice column is undefined
+ */
+class RamSaturationCheck : public RamAbstractExistenceCheck {
+public:
+    RamSaturationCheck(std::unique_ptr<RamRelationReference> rel, std::vector<std::unique_ptr<RamValue>> vals)
+            : RamAbstractExistenceCheck(RN_SaturationCheck, std::move(rel), std::move(vals)) {
+        assert(relation->getRepresentation() == RelationRepresentation::LATTICE);
+        assert(values.size() == relation->getArity() && values.back() == nullptr);
+    }
+
+    /** Print */
+    void print(std::ostream& os) const override {
+        os << "(";
+        for (size_t i = 0; i < values.size() - 1; i++) {
+            os << *values[i] << ",";
+        }
+        os << "⊤) ∈ " << relation->getName();
+    }
+
+    /** Create clone */
+    RamSaturationCheck* clone() const override {
+        std::vector<std::unique_ptr<RamValue>> newValues;
+        for (auto& cur : values) {
+            RamValue* val = nullptr;
+            if (cur != nullptr) {
+                val = cur->clone();
+            }
+            newValues.emplace_back(val);
+        }
+        RamSaturationCheck* res = new RamSaturationCheck(
+                std::unique_ptr<RamRelationReference>(relation->clone()), std::move(newValues));
+        return res;
+    }
+
+protected:
+    /** Check equality */
+    bool equal(const RamNode& node) const override {
+        assert(nullptr != dynamic_cast<const RamSaturationCheck*>(&node));
+        return RamAbstractExistenceCheck::equal(node);
+    }
+};
+
 /**
  * Emptiness check for a relation
  */
@@ -75,6 +75,26 @@ size_t RamConditionLevelAnalysis::getLevel(const RamCondition* condition) const
             return level;
         }
 
+        // subsumption check
+        size_t visitSubsumptionCheck(const RamSubsumptionCheck& subsumption) override {
+            size_t level = 0;
+            for (const auto& cur : subsumption.getValues()) {
+                level = std::max(level, rvla->getLevel(cur));
+            }
+            return level;
+        }
+
+        // saturation check
+        size_t visitSaturationCheck(const RamSaturationCheck& saturation) override {
+            size_t level = 0;
+            for (const auto& cur : saturation.getValues()) {
+                if (cur) {
+                    level = std::max(level, rvla->getLevel(cur));
+                }
+            }
+            return level;
+        }
+
         // emptiness check
         size_t visitEmptinessCheck(const RamEmptinessCheck& emptiness) override {
             return 0;  // can be in the top level
@@ -22,15 +22,203 @@
 #include "RamValue.h"
 #include "RamTypes.h"
 #include "RamCondition.h"
+#include "RamQuestionMark.h"
+#include <cassert>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 #include <iostream>
 
 namespace souffle {
 
+/**
+ * Precomputed outputs of a lattice function over the symbols of enum types
+ *
+ * Enum symbols are packed from MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_1 on, so
+ * the slot of a symbol is found by a single offset into a small vector. The
+ * outputs of all combinations of slots are stored densely, i.e. N entries for
+ * a unary and N x M entries for a binary function. Arguments without a slot
+ * (e.g. the numbers of an enum that admits numbers) miss the table and must
+ * be evaluated case by case.
+ */
+class RamLatticeTable {
+public:
+	/** Add the enum symbols the next argument ranges over */
+	void addDomain(const std::vector<RamDomain>& symbols) {
+		std::vector<int> slot;
+		for (size_t i = 0; i < symbols.size(); i++) {
+			size_t offset = getOffset(symbols[i]);
+			assert(offset < ENUM_SYMBOL_OFFSET_1 - ENUM_SYMBOL_OFFSET_2
+					&& "Only enum symbols can be tabulated!");
+			if (offset >= slot.size()) {
+				slot.resize(offset + 1, -1);
+			}
+			slot[offset] = i;
+		}
+		domains.push_back(symbols);
+		slots.push_back(std::move(slot));
+	}
+
+	/** Get number of tabulated arguments */
+	size_t getArity() const {
+		return domains.size();
+	}
+
+	/** Get the enum symbols of an argument */
+	const std::vector<RamDomain>& getDomain(size_t arg) const {
+		assert(arg < domains.size());
+		return domains[arg];
+	}
+
+	/** Get number of entries, i.e. the number of combinations of arguments */
+	size_t size() const {
+		if (domains.empty()) {
+			return 0;
+		}
+		size_t res = 1;
+		for (const auto& cur : domains) {
+			res *= cur.size();
+		}
+		return res;
+	}
+
+	/** Check whether the outputs have been computed */
+	bool isComputed() const {
+		return !outputs.empty();
+	}
+
+	/** Set outputs, ordered by the slot of the first argument, then the second */
+	void setOutputs(std::vector<RamDomain> outs) {
+		assert(outs.size() == size());
+		outputs = std::move(outs);
+	}
+
+	/** Get outputs */
+	const std::vector<RamDomain>& getOutputs() const {
+		return outputs;
+	}
+
+	/** Look up the output of a unary function; false if not tabulated */
+	bool lookup(RamDomain arg, RamDomain& out) const {
+		if (outputs.empty()) {
+			return false;
+		}
+		int i = getSlot(0, arg);
+		if (i < 0) {
+			return false;
+		}
+		out = outputs[i];
+		return true;
+	}
+
+	/** Look up the output of a binary function; false if not tabulated */
+	bool lookup(RamDomain lhs, RamDomain rhs, RamDomain& out) const {
+		if (outputs.empty()) {
+			return false;
+		}
+		int i = getSlot(0, lhs);
+		int j = getSlot(1, rhs);
+		if (i < 0 || j < 0) {
+			return false;
+		}
+		out = outputs[i * domains[1].size() + j];
+		return true;
+	}
+
+private:
+	/** Offset of a value from the first enum symbol; wraps for non-enum values */
+	static size_t getOffset(RamDomain value) {
+		using URamDomain = std::make_unsigned<RamDomain>::type;
+		return static_cast<URamDomain>(value)
+				- static_cast<URamDomain>(MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_1);
+	}
+
+	/** Slot of a value in the domain of an argument, or -1 */
+	int getSlot(size_t arg, RamDomain value) const {
+		size_t offset = getOffset(value);
+		return offset < slots[arg].size() ? slots[arg][offset] : -1;
+	}
+
+	/* enum symbols of each argument */
+	std::vector<std::vector<RamDomain>> domains;
+
+	/* slot of each enum symbol offset per argument, -1 if not in the domain */
+	std::vector<std::vector<int>> slots;
+
+	/* outputs of all combinations of slots */
+	std::vector<RamDomain> outputs;
+};
+
 class RamLatticeFunction: public RamNode {
 public:
 	RamLatticeFunction(RamNodeType type): RamNode(type) {}
+
+	/** Get table of precomputed outputs */
+	RamLatticeTable& getTable() const {
+		return table;
+	}
+
+protected:
+	/**
+	 * Check whether a match or output can be evaluated ahead of time, i.e. it
+	 * only depends on the arguments and has no side effects. Symbol table
+	 * accesses, counters, user-defined functors and divisions are excluded.
+	 */
+	static bool isTabulable(const RamNode& node) {
+		switch (node.getNodeType()) {
+		case RN_Number:
+		case RN_Argument:
+			return true;
+		case RN_Conjunction:
+		case RN_Negation:
+			break;
+		case RN_Constraint:
+			if (!isNumericBinaryConstraintOp(
+					static_cast<const RamConstraint&>(node).getOperator())) {
+				return false;
+			}
+			break;
+		case RN_IntrinsicOperator:
+			switch (static_cast<const RamIntrinsicOperator&>(node).getOperator()) {
+			case FunctorOp::NEG:
+			case FunctorOp::BNOT:
+			case FunctorOp::LNOT:
+			case FunctorOp::ADD:
+			case FunctorOp::SUB:
+			case FunctorOp::MUL:
+			case FunctorOp::EXP:
+			case FunctorOp::BAND:
+			case FunctorOp::BOR:
+			case FunctorOp::BXOR:
+			case FunctorOp::LAND:
+			case FunctorOp::LOR:
+			case FunctorOp::MAX:
+			case FunctorOp::MIN:
+				break;
+			default:
+				return false;
+			}
+			break;
+		case RN_QuestionMark: {
+			const auto& qmark = static_cast<const RamQuestionMark&>(node);
+			return isTabulable(qmark.getCondition())
+					&& isTabulable(qmark.getFirstRet())
+					&& isTabulable(qmark.getSecondRet());
+		}
+		default:
+			return false;
+		}
+		for (const RamNode* cur : node.getChildNodes()) {
+			if (!isTabulable(*cur)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/* precomputed outputs over enum arguments; outputs are filled by the evaluator */
+	mutable RamLatticeTable table;
 };
 
 /**
@@ -87,6 +275,17 @@ public:
 		return Unarycases;
 	}
 
+	/** Check whether all cases can be evaluated ahead of time */
+	bool isTabulable() const {
+		for (const auto& cur : Unarycases) {
+			if ((cur.constraint != nullptr && !RamLatticeFunction::isTabulable(*cur.constraint))
+					|| !RamLatticeFunction::isTabulable(*cur.output)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
 	/** Create clone */
 	RamLatticeUnaryFunction* clone() const override {
 		RamLatticeUnaryFunction* res = new RamLatticeUnaryFunction();
@@ -167,6 +366,17 @@ public:
 		return cases;
 	}
 
+	/** Check whether all cases can be evaluated ahead of time */
+	bool isTabulable() const {
+		for (const auto& cur : cases) {
+			if ((cur.match != nullptr && !RamLatticeFunction::isTabulable(*cur.match))
+					|| !RamLatticeFunction::isTabulable(*cur.output)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
 	/** Create clone */
 	RamLatticeBinaryFunction* clone() const override {
 		RamLatticeBinaryFunction* res = new RamLatticeBinaryFunction();
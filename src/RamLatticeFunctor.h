@@ -59,6 +59,10 @@ public:
 		return ref.get();
 	}
 
+	const std::string& getName() const {
+		return name;
+	}
+
 	void setFunc(std::shared_ptr<RamLatticeUnaryFunction> f) {
 		func = f;
 	}
@@ -203,6 +207,10 @@ public:
 //		return lattice.get();
 //	}
 
+	const std::string& getName() const {
+		return name;
+	}
+
 	void setFunc(std::shared_ptr<RamLatticeBinaryFunction> f) {
 		func = f;
 	}
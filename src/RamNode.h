@@ -53,6 +53,8 @@ enum RamNodeType {
     // Conditions
     RN_ExistenceCheck,
     RN_ProvenanceExistenceCheck,
+    RN_SubsumptionCheck,
+    RN_SaturationCheck,
     RN_EmptinessCheck,
     RN_Conjunction,
     RN_Negation,
@@ -80,6 +82,7 @@ enum RamNodeType {
     RN_Merge,
 	RN_LatNorm,
 	RN_LatClean,
+	RN_LatMerge,
 //	RN_LatExt,
     RN_Swap,
 
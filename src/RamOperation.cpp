@@ -189,6 +189,26 @@ size_t getLevel(const RamCondition* condition) {
             return level;
         }
 
+        // subsumption check for a keyed lattice relation
+        size_t visitSubsumptionCheck(const RamSubsumptionCheck& subsumption) override {
+            size_t level = 0;
+            for (const auto& cur : subsumption.getValues()) {
+                level = std::max(level, getLevel(cur));
+            }
+            return level;
+        }
+
+        // saturation check for a keyed lattice relation
+        size_t visitSaturationCheck(const RamSaturationCheck& saturation) override {
+            size_t level = 0;
+            for (const auto& cur : saturation.getValues()) {
+                if (cur != nullptr) {
+                    level = std::max(level, getLevel(cur));
+                }
+            }
+            return level;
+        }
+
         // emptiness check
         size_t visitEmptinessCheck(const RamEmptinessCheck& emptiness) override {
             return 0;  // can be in the top level
@@ -138,6 +138,11 @@ public:
 		lattice = std::move(lat);
 	}
 
+	/** Check whether a lattice is declared */
+	bool hasLattice() const {
+		return lattice != nullptr;
+	}
+
 	/** Get lattice */
 	RamLatticeAssociation* getLattice() const {
 		assert(lattice);
@@ -157,6 +162,11 @@ public:
 		return it == LUFs.end() ? nullptr : it->second;
 	}
 
+	/** get all lattice unary functions **/
+	const std::map<std::string, std::shared_ptr<RamLatticeUnaryFunction>>& getLUFs() const {
+		return LUFs;
+	}
+
 	/** add lattice binary function **/
 	void addLBF(std::string name,
 			std::shared_ptr<RamLatticeBinaryFunction> lbf) {
@@ -175,6 +185,11 @@ public:
 		return it == LBFs.end() ? nullptr : it->second;
 	}
 
+	/** get all lattice binary functions **/
+	const std::map<std::string, std::shared_ptr<RamLatticeBinaryFunction>>& getLBFs() const {
+		return LBFs;
+	}
+
 	/** Create clone */
 	RamProgram* clone() const override {
 		RamProgram* res = new RamProgram(
@@ -27,6 +27,7 @@
 #include <algorithm>
 #include <memory>
 #include <ostream>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -459,6 +460,86 @@ protected:
 	}
 };
 
+/**
+ * Join the new knowledge of a keyed lattice relation into the relation,
+ * and collect the cells whose lattice element went up as the next delta
+ */
+class RamLatMerge: public RamStatement {
+protected:
+	std::unique_ptr<RamRelationReference> target;
+	std::unique_ptr<RamRelationReference> source;
+	std::unique_ptr<RamRelationReference> delta;
+
+public:
+	RamLatMerge(std::unique_ptr<RamRelationReference> t,
+			std::unique_ptr<RamRelationReference> s,
+			std::unique_ptr<RamRelationReference> d) :
+			RamStatement(RN_LatMerge), target(std::move(t)), source(
+					std::move(s)), delta(std::move(d)) {
+		assert(target->getArity() == source->getArity());
+		assert(target->getArity() == delta->getArity());
+		assert(target->getRepresentation() == RelationRepresentation::LATTICE);
+	}
+
+	/** Get keyed lattice relation */
+	const RamRelationReference& getTargetRelation() const {
+		return *target;
+	}
+
+	/** Get new knowledge */
+	const RamRelationReference& getSourceRelation() const {
+		return *source;
+	}
+
+	/** Get relation receiving the raised cells */
+	const RamRelationReference& getDeltaRelation() const {
+		return *delta;
+	}
+
+	/** Pretty print */
+	void print(std::ostream& os, int tabpos) const override {
+		os << std::string(tabpos, '\t');
+		os << "LATMERGE ";
+		os << source->getName();
+		os << " INTO ";
+		os << target->getName();
+		os << " DELTA ";
+		os << delta->getName();
+	}
+
+	/** Obtain list of child nodes */
+	std::vector<const RamNode*> getChildNodes() const override {
+		return std::vector<const RamNode*>( { target.get(), source.get(),
+				delta.get() });
+	}
+
+	/** Create clone */
+	RamLatMerge* clone() const override {
+		RamLatMerge* res = new RamLatMerge(
+				std::unique_ptr<RamRelationReference>(target->clone()),
+				std::unique_ptr<RamRelationReference>(source->clone()),
+				std::unique_ptr<RamRelationReference>(delta->clone()));
+		return res;
+	}
+
+	/** Apply mapper */
+	void apply(const RamNodeMapper& map) override {
+		target = map(std::move(target));
+		source = map(std::move(source));
+		delta = map(std::move(delta));
+	}
+
+protected:
+	/** Check equality */
+	bool equal(const RamNode& node) const override {
+		assert(nullptr != dynamic_cast<const RamLatMerge*>(&node));
+		const auto& other = static_cast<const RamLatMerge&>(node);
+		return getTargetRelation() == other.getTargetRelation()
+				&& getSourceRelation() == other.getSourceRelation()
+				&& getDeltaRelation() == other.getDeltaRelation();
+	}
+};
+
 /**
  * Extract lattice elements from two lattice relations
  */
@@ -1209,9 +1290,14 @@ protected:
 	std::unique_ptr<RamStatement> body;
 	const int index;
 
+	/** Indices of the strata to be completed before this one */
+	const std::set<size_t> dependencies;
+
 public:
-	RamStratum(std::unique_ptr<RamStatement> b, const int i) :
-			RamStatement(RN_Stratum), body(std::move(b)), index(i) {
+	RamStratum(std::unique_ptr<RamStatement> b, const int i,
+			std::set<size_t> deps = std::set<size_t>()) :
+			RamStatement(RN_Stratum), body(std::move(b)), index(i), dependencies(
+					std::move(deps)) {
 	}
 
 	/** Get stratum body */
@@ -1224,10 +1310,19 @@ public:
 		return index;
 	}
 
+	/** Get indices of the strata this stratum depends on */
+	const std::set<size_t>& getDependencies() const {
+		return dependencies;
+	}
+
 	/** Pretty print */
 	void print(std::ostream& os, int tabpos) const override {
 		os << std::string(tabpos, '\t');
-		os << "BEGIN_STRATUM_" << index << "\n";
+		os << "BEGIN_STRATUM_" << index;
+		if (!dependencies.empty()) {
+			os << " AFTER " << join(dependencies, ",");
+		}
+		os << "\n";
 		body->print(os, tabpos + 1);
 		os << "\n";
 		os << std::string(tabpos, '\t');
@@ -1242,7 +1337,8 @@ public:
 	/** Create clone */
 	RamStratum* clone() const override {
 		RamStratum* res = new RamStratum(
-				std::unique_ptr<RamStatement>(body->clone()), index);
+				std::unique_ptr<RamStatement>(body->clone()), index,
+				dependencies);
 		return res;
 	}
 
@@ -1256,7 +1352,8 @@ protected:
 	bool equal(const RamNode& node) const override {
 		assert(nullptr != dynamic_cast<const RamStratum*>(&node));
 		const auto& other = static_cast<const RamStratum&>(node);
-		return *body == *other.body && index == other.index;
+		return *body == *other.body && index == other.index
+				&& dependencies == other.dependencies;
 	}
 };
 
@@ -104,6 +104,8 @@ struct RamVisitor : public ram_visitor_tag {
             FORWARD(EmptinessCheck);
             FORWARD(ExistenceCheck);
             FORWARD(ProvenanceExistenceCheck);
+            FORWARD(SubsumptionCheck);
+            FORWARD(SaturationCheck);
             FORWARD(Conjunction);
             FORWARD(Negation);
             FORWARD(Constraint);
@@ -130,6 +132,7 @@ struct RamVisitor : public ram_visitor_tag {
             FORWARD(Merge);
             FORWARD(LatNorm);
             FORWARD(LatClean);
+            FORWARD(LatMerge);
 //            FORWARD(LatExt);
             FORWARD(Swap);
 
@@ -186,6 +189,7 @@ protected:
     LINK(Merge, Statement);
     LINK(LatNorm, Statement);
     LINK(LatClean, Statement);
+    LINK(LatMerge, Statement);
 //    LINK(LatExt, Statement);
     LINK(Swap, Statement);
 
@@ -219,6 +223,8 @@ protected:
     LINK(Constraint, Condition)
     LINK(ExistenceCheck, Condition)
     LINK(ProvenanceExistenceCheck, Condition)
+    LINK(SubsumptionCheck, Condition)
+    LINK(SaturationCheck, Condition)
     LINK(EmptinessCheck, Condition)
 
     LINK(Condition, Node)
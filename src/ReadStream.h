@@ -20,10 +20,70 @@
 #include "EnumTypeMask.h"
 #include "SymbolTable.h"
 
+#include <iterator>
 #include <memory>
 
 namespace souffle {
 
+/**
+ * A batch of tuples read by a stream, stored one after another in a buffer
+ * owned by the stream, as a range of pointers to the tuples.
+ */
+class TupleBatch {
+public:
+    class iterator : public std::iterator<std::forward_iterator_tag, const RamDomain*> {
+    public:
+        iterator(const RamDomain* tuples, size_t stride, size_t index)
+                : tuples(tuples), stride(stride), index(index) {}
+
+        const RamDomain* operator*() const {
+            return tuples + index * stride;
+        }
+
+        iterator& operator++() {
+            ++index;
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const {
+            return index == other.index;
+        }
+
+        bool operator!=(const iterator& other) const {
+            return index != other.index;
+        }
+
+    private:
+        const RamDomain* tuples;
+        size_t stride;
+        size_t index;
+    };
+
+    TupleBatch(const RamDomain* tuples, size_t stride, size_t count)
+            : tuples(tuples), stride(stride), count(count) {}
+
+    iterator begin() const {
+        return iterator(tuples, stride, 0);
+    }
+
+    iterator end() const {
+        return iterator(tuples, stride, count);
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+private:
+    const RamDomain* tuples;
+    size_t stride;
+    size_t count;
+};
+
 class ReadStream {
 public:
     ReadStream(const SymbolMask& symbolMask, const EnumTypeMask& enumTypeMask, SymbolTable& symbolTable, const bool prov)
@@ -31,11 +91,11 @@ public:
               arity(symbolMask.getArity() - (prov ? 2 : 0)) {}
     template <typename T>
     void readAll(T& relation) {
-        auto lease = symbolTable.acquireLock();
-        (void)lease;
-        while (const auto next = readNextTuple()) {
-            const RamDomain* ramDomain = next.get();
-            relation.insert(ramDomain);
+        const size_t stride = symbolMask.getArity();
+        const RamDomain* tuples;
+        while (size_t count = readNextTuples(tuples)) {
+            TupleBatch batch(tuples, stride, count);
+            relation.insertAll(batch);
         }
     }
 
@@ -43,11 +103,27 @@ public:
 
 protected:
     virtual std::unique_ptr<RamDomain[]> readNextTuple() = 0;
+
+    /**
+     * Read the next batch of tuples into a buffer owned by the stream, which stays valid until the
+     * next read.
+     *
+     * Returns the number of tuples read, 0 if no tuple was readable.
+     */
+    virtual size_t readNextTuples(const RamDomain*& tuples) {
+        next = readNextTuple();
+        tuples = next.get();
+        return (next) ? 1 : 0;
+    }
+
     const SymbolMask& symbolMask;
     const EnumTypeMask& enumTypeMask;
     SymbolTable& symbolTable;
     const bool isProvenance;
     const uint8_t arity;
+
+private:
+    std::unique_ptr<RamDomain[]> next;
 };
 
 class ReadStreamFactory {
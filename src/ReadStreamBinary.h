@@ -0,0 +1,234 @@
+/*
+ * Souffle - A Datalog Compiler
+ * Copyright (c) 2013, 2014, Oracle and/or its affiliates. All rights reserved
+ * Licensed under the Universal Permissive License v 1.0 as shown at:
+ * - https://opensource.org/licenses/UPL
+ * - <souffle root>/licenses/SOUFFLE-UPL.txt
+ */
+
+/************************************************************************
+ *
+ * @file ReadStreamBinary.h
+ *
+ ***********************************************************************/
+
+#pragma once
+
+#include "BinaryFormat.h"
+#include "IODirectives.h"
+#include "RamTypes.h"
+#include "ReadStream.h"
+#include "SymbolMask.h"
+#include "EnumTypeMask.h"
+#include "SymbolTable.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cctype>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace souffle {
+
+/**
+ * Reads a relation in the columnar binary format, see BinaryFormat.h.
+ *
+ * The file is mapped into memory; each symbol of the dictionary is looked up once and
+ * tuples are assembled from the columns in batches.
+ */
+class ReadFileBinary : public ReadStream {
+public:
+    ReadFileBinary(const SymbolMask& symbolMask, const EnumTypeMask& enumTypeMask, SymbolTable& symbolTable,
+            const IODirectives& ioDirectives, const bool provenance = false)
+            : ReadStream(symbolMask, enumTypeMask, symbolTable, provenance),
+              baseName(souffle::baseName(ioDirectives.getFileName())) {
+        int fd = open(ioDirectives.getFileName().c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::invalid_argument("Cannot open fact file " + baseName + "\n");
+        }
+        struct stat status;
+        if (fstat(fd, &status) == 0 && status.st_size > 0) {
+            length = status.st_size;
+            void* addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                data = static_cast<const char*>(addr);
+                madvise(addr, length, MADV_SEQUENTIAL);
+            }
+        }
+        close(fd);
+
+        if (data == nullptr || length < sizeof(BinaryHeader)) {
+            throwCorrupt();
+        }
+        std::memcpy(&header, data, sizeof(BinaryHeader));
+        if (!header.isValid(arity) || !header.matchesLength(length)) {
+            throwCorrupt();
+        }
+        columns = reinterpret_cast<const RamDomain*>(data + sizeof(BinaryHeader));
+        offsets = reinterpret_cast<const uint64_t*>(data + sizeof(BinaryHeader) + header.columnBytes());
+        characters = reinterpret_cast<const char*>(offsets + header.symbols + 1);
+        symbols.assign(header.symbols, RamDomain(UNRESOLVED));
+        enums.assign(header.symbols, RamDomain(UNRESOLVED));
+        numerals.assign(header.symbols, false);
+
+        buffer.reset(new RamDomain[BATCH_SIZE * std::max<size_t>(symbolMask.getArity(), 1)]());
+    }
+
+    ~ReadFileBinary() override {
+        if (data != nullptr) {
+            munmap(const_cast<char*>(data), length);
+        }
+    }
+
+protected:
+    std::unique_ptr<RamDomain[]> readNextTuple() override {
+        if (next >= header.size) {
+            return nullptr;
+        }
+        std::unique_ptr<RamDomain[]> tuple(new RamDomain[symbolMask.getArity()]());
+        assemble(1, tuple.get());
+        return tuple;
+    }
+
+    size_t readNextTuples(const RamDomain*& tuples) override {
+        if (next >= header.size) {
+            return 0;
+        }
+        size_t count = std::min<uint64_t>(BATCH_SIZE, header.size - next);
+        assemble(count, buffer.get());
+        tuples = buffer.get();
+        return count;
+    }
+
+private:
+    /** Marker of dictionary entries not looked up yet; no symbol table index uses it */
+    static constexpr RamDomain UNRESOLVED = MIN_RAM_DOMAIN;
+
+    enum { BATCH_SIZE = 4096 };
+
+    /** Assemble the next count tuples from the columns */
+    void assemble(size_t count, RamDomain* tuples) {
+        const size_t stride = symbolMask.getArity();
+        for (size_t col = 0; col < arity; ++col) {
+            const RamDomain* column = columns + col * header.size + next;
+            RamDomain* target = tuples + col;
+            if (symbolMask.isSymbol(col)) {
+                for (size_t i = 0; i < count; ++i) {
+                    target[i * stride] = resolveSymbol(column[i]);
+                }
+            } else if (enumTypeMask.isEnumType(col)) {
+                for (size_t i = 0; i < count; ++i) {
+                    target[i * stride] = resolveEnum(column[i], col);
+                }
+            } else {
+                for (size_t i = 0; i < count; ++i) {
+                    target[i * stride] = column[i];
+                }
+            }
+        }
+        next += count;
+    }
+
+    void throwCorrupt() const {
+        throw std::invalid_argument("Cannot read binary fact file " + baseName + "\n");
+    }
+
+    std::string symbolAt(RamDomain id) const {
+        if (id < 0 || static_cast<uint64_t>(id) >= header.symbols || offsets[id] > offsets[id + 1] ||
+                offsets[id + 1] > header.symbolBytes) {
+            throwCorrupt();
+        }
+        return std::string(characters + offsets[id], characters + offsets[id + 1]);
+    }
+
+    RamDomain resolveSymbol(RamDomain id) {
+        if (id < 0 || static_cast<uint64_t>(id) >= header.symbols) {
+            throwCorrupt();
+        }
+        RamDomain& value = symbols[id];
+        if (value == UNRESOLVED) {
+            value = symbolTable.unsafeLookup(symbolAt(id));
+        }
+        return value;
+    }
+
+    RamDomain resolveEnum(RamDomain id, size_t column) {
+        if (id < 0 || static_cast<uint64_t>(id) >= header.symbols) {
+            throwCorrupt();
+        }
+        RamDomain& value = enums[id];
+        if (value == UNRESOLVED) {
+            const std::string symbol = symbolAt(id);
+            size_t start = (!symbol.empty() && symbol[0] == '-') ? 1 : 0;
+            numerals[id] = start < symbol.size() && std::all_of(symbol.begin() + start, symbol.end(),
+                                                                [](unsigned char c) { return std::isdigit(c); });
+            if (numerals[id]) {
+                try {
+#if RAM_DOMAIN_SIZE == 64
+                    value = std::stoll(symbol);
+#else
+                    value = std::stoi(symbol);
+#endif
+                } catch (const std::out_of_range&) {
+                    throw std::invalid_argument("Error search <" + symbol + "> within enum type in fact file " +
+                                                baseName + "\n");
+                }
+            } else if (symbolTable.exist(symbol)) {
+                value = symbolTable.unsafeLookup(symbol);
+                if (value < MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_1 ||
+                        value >= MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_2) {
+                    throw std::invalid_argument("Error search <" + symbol + "> within enum type in fact file " +
+                                                baseName + "\n");
+                }
+            } else {
+                throw std::invalid_argument("Symbol Table does not include the symbol: " + symbol + "!\n");
+            }
+        }
+        // a numeral is only admitted by the enum types containing numbers, as in CSV files
+        if (numerals[id] && !enumTypeMask.is_Enum_hasNUMBER(column)) {
+            throw std::invalid_argument("Enum Type does not support number type: " + symbolAt(id) + "!\n");
+        }
+        return value;
+    }
+
+    const std::string baseName;
+    const char* data = nullptr;
+    size_t length = 0;
+
+    BinaryHeader header;
+    const RamDomain* columns = nullptr;
+    const uint64_t* offsets = nullptr;
+    const char* characters = nullptr;
+
+    /** Symbol table indices of the dictionary entries, for symbol and enum columns */
+    std::vector<RamDomain> symbols;
+    std::vector<RamDomain> enums;
+    /** Whether the dictionary entries resolved for enum columns are numerals */
+    std::vector<bool> numerals;
+
+    std::unique_ptr<RamDomain[]> buffer;
+    uint64_t next = 0;
+};
+
+class ReadFileBinaryFactory : public ReadStreamFactory {
+public:
+    std::unique_ptr<ReadStream> getReader(const SymbolMask& symbolMask, const EnumTypeMask& enumTypeMask,
+            SymbolTable& symbolTable, const IODirectives& ioDirectives, const bool provenance) override {
+        return std::make_unique<ReadFileBinary>(symbolMask, enumTypeMask, symbolTable, ioDirectives, provenance);
+    }
+    const std::string& getName() const override {
+        static const std::string name = "binary";
+        return name;
+    }
+    ~ReadFileBinaryFactory() override = default;
+};
+
+} /* namespace souffle */
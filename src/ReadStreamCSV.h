@@ -28,11 +28,26 @@
 #include <fstream>
 #endif
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <exception>
 #include <map>
 #include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace souffle {
 
@@ -48,6 +63,7 @@ public:
 			int size = inputMap.size();
 			inputMap[size] = size;
 		}
+		buffer = std::make_unique<RamDomain[]>(symbolMask.getArity());
 	}
 
 	~ReadStreamCSV() override = default;
@@ -60,124 +76,195 @@ protected:
 	 * @return
 	 */
 	std::unique_ptr<RamDomain[]> readNextTuple() override {
-		if (file.eof()) {
+		const RamDomain* next = nullptr;
+		if (ReadStreamCSV::readNextTuples(next) == 0) {
 			return nullptr;
 		}
-		std::string line;
 		std::unique_ptr<RamDomain[]> tuple = std::make_unique<RamDomain[]>(
 				symbolMask.getArity());
+		std::copy(next, next + symbolMask.getArity(), tuple.get());
+		return tuple;
+	}
 
+	/**
+	 * Read the next line into the reused tuple buffer.
+	 *
+	 * Returns the number of tuples read, 0 if no tuple was readable.
+	 */
+	size_t readNextTuples(const RamDomain*& tuples) override {
+		if (file.eof()) {
+			return 0;
+		}
 		if (!getline(file, line)) {
-			return nullptr;
+			return 0;
 		}
+		++lineNumber;
+
+		const char* begin = line.data();
+		const char* end = begin + line.size();
 		// Handle Windows line endings on non-Windows systems
-		if (line.back() == '\r') {
-			line = line.substr(0, line.length() - 1);
+		if (begin != end && end[-1] == '\r') {
+			--end;
 		}
-		++lineNumber;
+		RamDomain* tuple = buffer.get();
+		parseLine(begin, end, tuple, lineNumber,
+				[&](size_t pos, uint32_t column, const char* first, const char* last) {
+					tuple[pos] = resolveSymbol(column, first, last, lineNumber);
+				});
+		tuples = tuple;
+		return 1;
+	}
 
-		size_t start = 0, end = 0, columnsFilled = 0;
+	/**
+	 * Parse the columns of a line into a tuple, without allocating.
+	 *
+	 * Symbols, which need the symbol table, are handed to defer together with
+	 * their position in the tuple and their column.
+	 */
+	template<typename Defer>
+	void parseLine(const char* begin, const char* end, RamDomain* tuple,
+			size_t lineNumber, Defer defer) const {
+		const char* start = begin;
+		size_t columnsFilled = 0;
 		for (uint32_t column = 0; columnsFilled < arity; column++) {
-			end = line.find(delimiter, start);
-			if (end == std::string::npos) {
-				end = line.length();
-			}
-			std::string element;
-			if (start <= end) {
-				element = line.substr(start, end - start);
-			} else {
+			if (start > end) {
 				std::stringstream errorMessage;
 				errorMessage << "Values missing in line " << lineNumber << "; ";
 				throw std::invalid_argument(errorMessage.str());
 			}
-			start = end + delimiter.size();
-			if (inputMap.count(column) == 0) {
+			const char* stop = findDelimiter(start, end);
+			const char* element = start;
+			start = stop + delimiter.size();
+			auto pos = inputMap.find(column);
+			if (pos == inputMap.end()) {
 				continue;
 			}
 			++columnsFilled;
 
 			if (symbolMask.isSymbol(column)) {
-				tuple[inputMap[column]] = symbolTable.unsafeLookup(element);
+				defer(pos->second, column, element, stop);
 
 			} else if (enumTypeMask.isEnumType(column)) {
 				// added by Qing Gong
 				// check if the element is an integer
-				bool isNumber = !element.empty()
-						&& ((element.find_first_not_of("0123456789")
-								== std::string::npos)
-								|| (element[0] == '-'
-										&& element.find_first_not_of(
-												"0123456789", 1)
-												== std::string::npos));
-				if (isNumber) {
+				if (isInteger(element, stop)) {
 					// element is a number
 					if (!enumTypeMask.is_Enum_hasNUMBER(column)) {
 						std::stringstream errorMessage;
 						errorMessage
 								<< "Enum Type does not support number type: "
-								<< element << "!\n";
+								<< std::string(element, stop) << "!\n";
 						throw std::invalid_argument(errorMessage.str());
 					}
 					// put number into tuple
-					try {
-#if RAM_DOMAIN_SIZE == 64
-						tuple[inputMap[column]] = std::stoll(element);
-#else
-						tuple[inputMap[column]] = std::stoi(element);
-#endif
-					} catch (...) {
-						std::stringstream errorMessage;
-						errorMessage
-								<< "Error converting number <" + element
-										+ "> in column " << column + 1
-								<< " in line " << lineNumber << "; ";
-						throw std::invalid_argument(errorMessage.str());
+					if (!parseNumber(element, stop, tuple[pos->second])) {
+						throwConversionError(element, stop, column, lineNumber);
 					}
-
 				} else {
 					// element is a symbol
-					if (!symbolTable.exist(element)) {
-						std::stringstream errorMessage;
-						errorMessage
-								<< "Symbol Table does not include the symbol: "
-								<< element << "!\n";
-						throw std::invalid_argument(errorMessage.str());
-					}
-					RamDomain ele = symbolTable.unsafeLookup(element);
-					if (ele >= MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_1
-							&& ele < MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_2) {
-						// is valid enum symbol
-						tuple[inputMap[column]] = ele;
-					} else {
-						std::stringstream errorMessage;
-						errorMessage
-								<< "Error search <" + element
-										+ "> within enum type, in column "
-								<< column + 1 << " in line " << lineNumber
-								<< "; ";
-						throw std::invalid_argument(errorMessage.str());
-					}
+					defer(pos->second, column, element, stop);
 				}
 
-			} else {
-				try {
-#if RAM_DOMAIN_SIZE == 64
-					tuple[inputMap[column]] = std::stoll(element);
-#else
-					tuple[inputMap[column]] = std::stoi(element);
-#endif
-				} catch (...) {
-					std::stringstream errorMessage;
-					errorMessage
-							<< "Error converting number <" + element
-									+ "> in column " << column + 1
-							<< " in line " << lineNumber << "; ";
-					throw std::invalid_argument(errorMessage.str());
-				}
+			} else if (!parseNumber(element, stop, tuple[pos->second])) {
+				throwConversionError(element, stop, column, lineNumber);
 			}
 		}
+	}
 
-		return tuple;
+	/** Look up the symbol of a symbol or enum column */
+	RamDomain resolveSymbol(uint32_t column, const char* begin,
+			const char* end, size_t lineNumber) {
+		symbol.assign(begin, end);
+		if (symbolMask.isSymbol(column)) {
+			return symbolTable.unsafeLookup(symbol);
+		}
+
+		if (!symbolTable.exist(symbol)) {
+			std::stringstream errorMessage;
+			errorMessage << "Symbol Table does not include the symbol: "
+					<< symbol << "!\n";
+			throw std::invalid_argument(errorMessage.str());
+		}
+		RamDomain ele = symbolTable.unsafeLookup(symbol);
+		if (ele >= MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_1
+				&& ele < MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_2) {
+			// is valid enum symbol
+			return ele;
+		}
+		std::stringstream errorMessage;
+		errorMessage
+				<< "Error search <" + symbol + "> within enum type, in column "
+				<< column + 1 << " in line " << lineNumber << "; ";
+		throw std::invalid_argument(errorMessage.str());
+	}
+
+	/** Find the next delimiter, or the end of the line if there is none */
+	const char* findDelimiter(const char* begin, const char* end) const {
+		if (delimiter.size() == 1) {
+			const void* pos = memchr(begin, delimiter[0], end - begin);
+			return (pos) ? static_cast<const char*>(pos) : end;
+		}
+		return std::search(begin, end, delimiter.begin(), delimiter.end());
+	}
+
+	/** Check whether an element consists of digits, with an optional minus sign */
+	static bool isInteger(const char* begin, const char* end) {
+		if (begin == end) {
+			return false;
+		}
+		if (*begin == '-') {
+			++begin;
+		}
+		for (; begin != end; ++begin) {
+			if (!std::isdigit(static_cast<unsigned char>(*begin))) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Parse the decimal number at the start of an element as std::stoi does,
+	 * without allocating or throwing.
+	 *
+	 * Returns false if there is no number or it is out of range.
+	 */
+	static bool parseNumber(const char* begin, const char* end,
+			RamDomain& result) {
+		using Magnitude = std::make_unsigned<RamDomain>::type;
+		while (begin != end && std::isspace(static_cast<unsigned char>(*begin))) {
+			++begin;
+		}
+		bool negative = false;
+		if (begin != end && (*begin == '-' || *begin == '+')) {
+			negative = (*begin == '-');
+			++begin;
+		}
+		if (begin == end || !std::isdigit(static_cast<unsigned char>(*begin))) {
+			return false;
+		}
+		const Magnitude limit = static_cast<Magnitude>(MAX_RAM_DOMAIN)
+				+ (negative ? 1 : 0);
+		Magnitude value = 0;
+		for (; begin != end && std::isdigit(static_cast<unsigned char>(*begin));
+				++begin) {
+			Magnitude digit = *begin - '0';
+			if (value > (limit - digit) / 10) {
+				return false;
+			}
+			value = value * 10 + digit;
+		}
+		result = static_cast<RamDomain>(negative ? (0 - value) : value);
+		return true;
+	}
+
+	[[noreturn]] static void throwConversionError(const char* begin,
+			const char* end, uint32_t column, size_t lineNumber) {
+		std::stringstream errorMessage;
+		errorMessage << "Error converting number <" + std::string(begin, end)
+				+ "> in column " << column + 1 << " in line " << lineNumber
+				<< "; ";
+		throw std::invalid_argument(errorMessage.str());
 	}
 
 	std::string getDelimiter(const IODirectives& ioDirectives) const {
@@ -219,6 +306,10 @@ protected:
 	std::istream& file;
 	size_t lineNumber;
 	std::map<int, int> inputMap;
+	// buffers reused across lines
+	std::string line;
+	std::string symbol;
+	std::unique_ptr<RamDomain[]> buffer;
 };
 
 class ReadFileCSV: public ReadStreamCSV {
@@ -240,8 +331,10 @@ public:
 					&& ioDirectives.get("headers") == "true") {
 				std::string line;
 				getline(file, line);
+				skipHeader = true;
 			}
 		}
+		mapFile(getFileName(ioDirectives));
 	}
 	/**
 	 * Read and return the next tuple.
@@ -260,9 +353,206 @@ public:
 		}
 	}
 
-	~ReadFileCSV() override = default;
+	/**
+	 * Read the tuples of the next chunk of a mapped file, or the next line
+	 * of a file that cannot be mapped.
+	 *
+	 * Returns the number of tuples read, 0 if no tuple was readable.
+	 */
+	size_t readNextTuples(const RamDomain*& tuples) override {
+		try {
+			if (mapBegin == nullptr) {
+				return ReadStreamCSV::readNextTuples(tuples);
+			}
+			return readMappedTuples(tuples);
+		} catch (std::exception& e) {
+			std::stringstream errorMessage;
+			errorMessage << e.what();
+			errorMessage << "cannot parse fact file " << baseName << "!\n";
+			throw std::invalid_argument(errorMessage.str());
+		}
+	}
+
+	~ReadFileCSV() override {
+		if (mapBegin != nullptr) {
+			munmap(const_cast<char*>(mapBegin), mapEnd - mapBegin);
+		}
+	}
 
 protected:
+	/** Symbol of a parsed tuple that is looked up once its chunk is read */
+	struct DeferredSymbol {
+		size_t slot;
+		uint32_t column;
+		size_t line;
+		const char* begin;
+		const char* end;
+	};
+
+	/** Line-aligned part of a mapped file, parsed by one thread */
+	struct Chunk {
+		Chunk(const char* begin, const char* end) :
+				begin(begin), end(end) {
+		}
+		const char* begin;
+		const char* end;
+		std::vector<RamDomain> tuples;
+		std::vector<DeferredSymbol> symbols;
+		// number of lines parsed successfully
+		size_t lines = 0;
+		// start of the line that failed to parse, if any
+		const char* failure = nullptr;
+	};
+
+	/** Size of the chunks parsed by each thread */
+	static constexpr size_t CHUNK_SIZE = 1 << 22;
+
+	/** Map a regular, uncompressed file into memory; others are read from the stream */
+	void mapFile(const std::string& fileName) {
+		int fd = open(fileName.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return;
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size < 2) {
+			close(fd);
+			return;
+		}
+		size_t size = info.st_size;
+		void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED) {
+			return;
+		}
+		const char* begin = static_cast<const char*>(data);
+		// leave gzip-compressed fact files to the stream
+		if (static_cast<unsigned char>(begin[0]) == 0x1f
+				&& static_cast<unsigned char>(begin[1]) == 0x8b) {
+			munmap(data, size);
+			return;
+		}
+		madvise(data, size, MADV_SEQUENTIAL);
+		mapBegin = begin;
+		mapEnd = begin + size;
+		position = mapBegin;
+		if (skipHeader) {
+			const void* eol = memchr(position, '\n', mapEnd - position);
+			position = (eol) ? static_cast<const char*>(eol) + 1 : mapEnd;
+		}
+	}
+
+	/** Hand out the tuples of the next chunk, parsing chunks in parallel as needed */
+	size_t readMappedTuples(const RamDomain*& tuples) {
+		if (pendingError) {
+			std::rethrow_exception(pendingError);
+		}
+		while (nextChunk == chunks.size()) {
+			if (position == mapEnd) {
+				return 0;
+			}
+			parseChunks();
+		}
+		Chunk& chunk = chunks[nextChunk++];
+
+		// intern the symbols of the chunk in order, as a sequential read would
+		size_t count = chunk.lines;
+		for (const DeferredSymbol& cur : chunk.symbols) {
+			try {
+				chunk.tuples[cur.slot] = resolveSymbol(cur.column, cur.begin,
+						cur.end, lineNumber + cur.line);
+			} catch (...) {
+				pendingError = std::current_exception();
+				count = cur.line - 1;
+				break;
+			}
+		}
+
+		// reproduce the error of a line that failed to parse
+		if (!pendingError && chunk.failure != nullptr) {
+			const char* end = findLineEnd(chunk.failure, chunk.end);
+			try {
+				parseLine(chunk.failure, end, buffer.get(),
+						lineNumber + chunk.lines + 1,
+						[&](size_t pos, uint32_t column, const char* first, const char* last) {
+							buffer[pos] = resolveSymbol(column, first, last,
+									lineNumber + chunk.lines + 1);
+						});
+			} catch (...) {
+				pendingError = std::current_exception();
+			}
+		}
+
+		lineNumber += count;
+		if (count == 0 && pendingError) {
+			std::rethrow_exception(pendingError);
+		}
+		tuples = chunk.tuples.data();
+		return count;
+	}
+
+	/** Split the next part of the file into line-aligned chunks and parse them in parallel */
+	void parseChunks() {
+		chunks.clear();
+		nextChunk = 0;
+#ifdef _OPENMP
+		size_t threads = omp_get_max_threads();
+#else
+		size_t threads = 1;
+#endif
+		for (size_t i = 0; i < threads && position != mapEnd; ++i) {
+			const char* end = position
+					+ std::min(size_t(CHUNK_SIZE), static_cast<size_t>(mapEnd - position));
+			if (end != mapEnd) {
+				const void* eol = memchr(end, '\n', mapEnd - end);
+				end = (eol) ? static_cast<const char*>(eol) + 1 : mapEnd;
+			}
+			chunks.emplace_back(position, end);
+			position = end;
+		}
+#pragma omp parallel for schedule(dynamic, 1)
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			parseChunk(chunks[i]);
+		}
+	}
+
+	/** Parse the lines of a chunk, deferring its symbols */
+	void parseChunk(Chunk& chunk) const {
+		const size_t stride = symbolMask.getArity();
+		chunk.tuples.reserve((chunk.end - chunk.begin) / 4);
+		for (const char* cur = chunk.begin; cur != chunk.end;) {
+			const char* end = findLineEnd(cur, chunk.end);
+			const char* next = (end == chunk.end) ? end : end + 1;
+			// Handle Windows line endings on non-Windows systems
+			if (end != cur && end[-1] == '\r') {
+				--end;
+			}
+			size_t slot = chunk.tuples.size();
+			size_t symbols = chunk.symbols.size();
+			chunk.tuples.resize(slot + stride, 0);
+			try {
+				parseLine(cur, end, chunk.tuples.data() + slot,
+						chunk.lines + 1,
+						[&](size_t pos, uint32_t column, const char* first, const char* last) {
+							chunk.symbols.push_back( {slot + pos, column,
+									chunk.lines + 1, first, last});
+						});
+			} catch (std::invalid_argument&) {
+				chunk.tuples.resize(slot);
+				chunk.symbols.resize(symbols);
+				chunk.failure = cur;
+				return;
+			}
+			++chunk.lines;
+			cur = next;
+		}
+	}
+
+	/** Find the end of the line starting at a position, excluding the newline */
+	static const char* findLineEnd(const char* begin, const char* end) {
+		const void* eol = memchr(begin, '\n', end - begin);
+		return (eol) ? static_cast<const char*>(eol) : end;
+	}
+
 	std::string getFileName(const IODirectives& ioDirectives) const {
 		if (ioDirectives.has("filename")) {
 			return ioDirectives.get("filename");
@@ -275,6 +565,14 @@ protected:
 #else
 	std::ifstream fileHandle;
 #endif
+	bool skipHeader = false;
+	// mapped file and the position up to which it has been split into chunks
+	const char* mapBegin = nullptr;
+	const char* mapEnd = nullptr;
+	const char* position = nullptr;
+	std::vector<Chunk> chunks;
+	size_t nextChunk = 0;
+	std::exception_ptr pendingError;
 };
 
 class ReadCinCSVFactory: public ReadStreamFactory {
@@ -29,7 +29,9 @@ enum class RelationRepresentation {
     // btree data-structure
     BRIE,
     // equivalence relation
-    EQREL
+    EQREL,
+    // one lattice cell per key, joined in place
+    LATTICE
 };
 
 inline std::ostream& operator<<(std::ostream& os, RelationRepresentation structure) {
@@ -43,6 +45,9 @@ inline std::ostream& operator<<(std::ostream& os, RelationRepresentation structu
         case RelationRepresentation::EQREL:
             os << "eqrel";
             break;
+        case RelationRepresentation::LATTICE:
+            os << "lattice";
+            break;
         default:
             break;
     }
@@ -24,14 +24,20 @@
 
 #ifdef USE_MPI
 #include "Mpi.h"
-#include <thread>
 #endif
 
+#include <atomic>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <deque>
 #include <initializer_list>
 #include <iostream>
+#include <memory>
+#include <new>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <unordered_map>
 
 namespace souffle {
@@ -63,6 +69,9 @@ private:
 	mutable std::unordered_map<std::string, size_t> strToNumCache;
 	mutable std::unordered_map<size_t, std::string> numToStrCache;
 
+	/** A lock to synchronize parallel accesses to the caches */
+	mutable Lock access;
+
 	RamDomain cacheLookup(const std::string& symbol, const int tag) const {
 		auto lease = access.acquire();
 		(void)lease;  // avoid warning;
@@ -177,58 +186,261 @@ public:
 #endif
 
 private:
-	/** A lock to synchronize parallel accesses */
-	mutable Lock access;
+	/** A symbol as a view of its characters, with their hash */
+	struct SymbolKey {
+		const char* data;
+		size_t length;
+		uint64_t hash;
+
+		bool operator==(const SymbolKey& other) const {
+			return length == other.length
+					&& std::memcmp(data, other.data, length) == 0;
+		}
+	};
+
+	/** Hash function of the symbol index, the hash is computed once per key */
+	struct SymbolHash {
+		size_t operator()(const SymbolKey& key) const {
+			return static_cast<size_t>(key.hash);
+		}
+	};
+
+	/** A part of the symbol index, guarded by its own lock */
+	struct Shard {
+		Lock access;
+		std::unordered_map<SymbolKey, size_t, SymbolHash> index;
+	};
+
+	enum {
+		/** Number of shards of the symbol index, a power of two */
+		SHARD_BITS = 6,
+		SHARDS = 1 << SHARD_BITS,
+		/** Number of symbols in the first block; block b holds BLOCK_SIZE << b */
+		BLOCK_SIZE = 1024,
+		/** Number of blocks, enough for any domain of symbols */
+		BLOCKS = 48
+	};
+
+	/**
+	 * Symbols are stored in blocks that never move, so that they are resolved
+	 * without locking while new symbols are appended. The index from strings
+	 * to numbers refers to the stored characters and is split into shards.
+	 */
+	struct Storage {
+		/** Blocks of symbols, allocated as raw storage when first used; a
+		 *  symbol is constructed in its slot once it is written */
+		std::atomic<std::string*> blocks[BLOCKS];
+
+		/** Bitsets of the symbols of a block that have been moved to the enum
+		 *  range, allocated once a symbol of the block is moved */
+		std::atomic<std::atomic<uint64_t>*> moved[BLOCKS];
+
+		/** Number of positions handed out to new symbols */
+		std::atomic<size_t> reserved;
+
+		/** Number of symbols in the table, published once their positions are written */
+		std::atomic<size_t> count;
+
+		/** Shards of the index from symbols to numbers */
+		Shard shards[SHARDS];
+
+		/** Lock for allocating blocks */
+		Lock grow;
+
+		Storage() : reserved(0), count(0) {
+			for (size_t b = 0; b < BLOCKS; b++) {
+				blocks[b].store(nullptr, std::memory_order_relaxed);
+				moved[b].store(nullptr, std::memory_order_relaxed);
+			}
+		}
+
+		~Storage() {
+			// every reserved position has been written
+			size_t written = reserved.load(std::memory_order_relaxed);
+			for (size_t pos = 0; pos < written; pos++) {
+				size_t block, offset;
+				locate(pos, block, offset);
+				blocks[block].load(std::memory_order_relaxed)[offset].~basic_string();
+			}
+			for (size_t b = 0; b < BLOCKS; b++) {
+				::operator delete(blocks[b].load(std::memory_order_relaxed));
+				delete[] moved[b].load(std::memory_order_relaxed);
+			}
+		}
+	};
+
+	std::unique_ptr<Storage> store;
+
+	/** First number of the enum range */
+	static RamDomain enumBase() {
+		return MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_1;
+	}
+
+	/** Check whether a number is in the range of enum symbols */
+	static bool isEnum(const RamDomain index) {
+		return index >= MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_1
+				&& index < MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_2;
+	}
+
+	/** Create the key of a symbol, hashed with FNV-1a */
+	static SymbolKey makeKey(const std::string& symbol) {
+		uint64_t hash = 14695981039346656037ull;
+		for (char c : symbol) {
+			hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+		}
+		return SymbolKey { symbol.data(), symbol.size(), hash };
+	}
+
+	Shard& shardOf(const SymbolKey& key) const {
+		return store->shards[key.hash >> (64 - SHARD_BITS)];
+	}
+
+	/** Find the block and the offset in the block of a position */
+	static void locate(size_t pos, size_t& block, size_t& offset) {
+		size_t n = pos / BLOCK_SIZE + 1;
+		block = 63 - __builtin_clzll(n);
+		offset = pos - BLOCK_SIZE * ((size_t(1) << block) - 1);
+	}
+
+	/** The symbol stored at a position */
+	const std::string& at(size_t pos) const {
+		size_t block, offset;
+		locate(pos, block, offset);
+		return store->blocks[block].load(std::memory_order_acquire)[offset];
+	}
+
+	/** Write a symbol to its reserved position, allocating the block if needed;
+	 *  the pages of a block are only committed once its slots are written */
+	std::string& place(size_t pos, const std::string& symbol) {
+		size_t block, offset;
+		locate(pos, block, offset);
+		std::string* symbols = store->blocks[block].load(std::memory_order_acquire);
+		if (symbols == nullptr) {
+			auto lease = store->grow.acquire();
+			(void) lease;  // avoid warning;
+			symbols = store->blocks[block].load(std::memory_order_relaxed);
+			if (symbols == nullptr) {
+				symbols = static_cast<std::string*>(::operator new(
+						sizeof(std::string) * (size_t(BLOCK_SIZE) << block)));
+				store->blocks[block].store(symbols, std::memory_order_release);
+			}
+		}
+		return *new (&symbols[offset]) std::string(symbol);
+	}
+
+	/** Mark the symbol at a position as moved to the enum range */
+	void markMoved(size_t pos) {
+		size_t block, offset;
+		locate(pos, block, offset);
+		std::atomic<uint64_t>* bits = store->moved[block].load(std::memory_order_acquire);
+		if (bits == nullptr) {
+			auto lease = store->grow.acquire();
+			(void) lease;  // avoid warning;
+			bits = store->moved[block].load(std::memory_order_relaxed);
+			if (bits == nullptr) {
+				bits = new std::atomic<uint64_t>[((size_t(BLOCK_SIZE) << block) + 63) / 64]();
+				store->moved[block].store(bits, std::memory_order_release);
+			}
+		}
+		bits[offset / 64].fetch_or(uint64_t(1) << (offset % 64), std::memory_order_release);
+	}
 
-	/** Map indices to strings. */
-	//std::deque<std::string> numToStr;
-	std::unordered_map<size_t, std::string> numToStr;
+	bool isMoved(size_t pos) const {
+		size_t block, offset;
+		locate(pos, block, offset);
+		const std::atomic<uint64_t>* bits = store->moved[block].load(std::memory_order_acquire);
+		return bits != nullptr
+				&& (bits[offset / 64].load(std::memory_order_acquire) >> (offset % 64)) & 1;
+	}
 
-	/** Map strings to indices. */
-	std::unordered_map<std::string, size_t> strToNum;
+	/** Find the symbol of a number, or null if there is none */
+	const std::string* find(const RamDomain index) const {
+		bool inEnum = isEnum(index);
+		auto pos = static_cast<size_t>(inEnum ? index - enumBase() : index);
+		if (pos >= store->count.load(std::memory_order_acquire)
+				|| inEnum != isMoved(pos)) {
+			return nullptr;
+		}
+		return &at(pos);
+	}
 
 	/** Convenience method to place a new symbol in the table, if it does not exist, and return the index of
 	 * it. */
 	inline size_t newSymbolOfIndex(const std::string& symbol) {
-		size_t index;
-		auto it = strToNum.find(symbol);
-		if (it == strToNum.end()) {
-			index = numToStr.size();
-			strToNum[symbol] = index;
-			//numToStr.push_back(symbol);
-			numToStr[index] = symbol;
-		} else {
-			index = it->second;
+		SymbolKey key = makeKey(symbol);
+		Shard& shard = shardOf(key);
+		auto lease = shard.access.acquire();
+		(void) lease;  // avoid warning;
+		auto it = shard.index.find(key);
+		if (it != shard.index.end()) {
+			return it->second;
 		}
+		size_t index = store->reserved.fetch_add(1, std::memory_order_relaxed);
+		std::string& stored = place(index, symbol);
+		// publish the positions in order, so that every counted symbol is written
+		size_t published = index;
+		while (!store->count.compare_exchange_weak(published, index + 1,
+				std::memory_order_release, std::memory_order_relaxed)) {
+			published = index;
+			std::this_thread::yield();
+		}
+		key.data = stored.data();
+		shard.index.emplace(key, index);
 		return index;
 	}
 
 	/** Convenience method to place a new symbol in the table, if it does not exist. */
 	inline void newSymbol(const std::string& symbol) {
-		if (strToNum.find(symbol) == strToNum.end()) {
-			strToNum[symbol] = numToStr.size();
-			//numToStr.push_back(symbol);
-			numToStr[numToStr.size()] = symbol;
+		newSymbolOfIndex(symbol);
+	}
+
+	/** Find the index of a symbol, returns false if it is not in the table */
+	bool findIndex(const std::string& symbol, size_t& index) const {
+		SymbolKey key = makeKey(symbol);
+		Shard& shard = shardOf(key);
+		auto lease = shard.access.acquire();
+		(void) lease;  // avoid warning;
+		auto it = shard.index.find(key);
+		if (it == shard.index.end()) {
+			return false;
+		}
+		index = it->second;
+		return true;
+	}
+
+	/** Replace the contents of this table by a copy of another table */
+	void copy(const SymbolTable& other) {
+		store.reset(new Storage());
+		size_t count = other.store->count.load();
+		for (size_t pos = 0; pos < count; pos++) {
+			std::string& stored = place(pos, other.at(pos));
+			if (other.isMoved(pos)) {
+				markMoved(pos);
+			}
+			SymbolKey key = makeKey(stored);
+			shardOf(key).index.emplace(key,
+					isMoved(pos) ? enumBase() + pos : pos);
 		}
+		store->reserved.store(count);
+		store->count.store(count);
 	}
 
 public:
 	/** Empty constructor. */
-	SymbolTable() = default;
+	SymbolTable() : store(new Storage()) {
+	}
 
 	/** Copy constructor, performs a deep copy. */
-	SymbolTable(const SymbolTable& other) :
-			numToStr(other.numToStr), strToNum(other.strToNum) {
+	SymbolTable(const SymbolTable& other) {
+		copy(other);
 	}
 
 	/** Copy constructor for r-value reference. */
-	SymbolTable(SymbolTable&& other) noexcept {
-		numToStr.swap(other.numToStr);
-		strToNum.swap(other.strToNum);
+	SymbolTable(SymbolTable&& other) noexcept : store(new Storage()) {
+		store.swap(other.store);
 	}
 
-	SymbolTable(std::initializer_list<std::string> symbols) {
-		strToNum.reserve(symbols.size());
+	SymbolTable(std::initializer_list<std::string> symbols) : store(new Storage()) {
 		for (const auto& symbol : symbols) {
 			newSymbol(symbol);
 		}
@@ -242,15 +454,13 @@ public:
 		if (this == &other) {
 			return *this;
 		}
-		numToStr = other.numToStr;
-		strToNum = other.strToNum;
+		copy(other);
 		return *this;
 	}
 
 	/** Assignment operator for r-value references. */
 	SymbolTable& operator=(SymbolTable&& other) noexcept {
-		numToStr.swap(other.numToStr);
-		strToNum.swap(other.strToNum);
+		store.swap(other.store);
 		return *this;
 	}
 
@@ -262,11 +472,7 @@ public:
 			return cacheLookup(symbol, LOOKUP);
 		} else
 #endif
-		{
-			auto lease = access.acquire();
-			(void) lease;  // avoid warning;
-			return static_cast<RamDomain>(newSymbolOfIndex(symbol));
-		}
+		return static_cast<RamDomain>(newSymbolOfIndex(symbol));
 	}
 
 	/** Finds the index of a symbol in the table, giving an error if it's not found */
@@ -277,24 +483,20 @@ public:
 		} else
 #endif
 		{
-			auto lease = access.acquire();
-			(void) lease;  // avoid warning;
-			auto result = strToNum.find(symbol);
-			if (result == strToNum.end()) {
+			size_t index;
+			if (!findIndex(symbol, index)) {
 				std::cerr
 						<< "Error string not found in call to SymbolTable::lookupExisting.\n";
 				exit(1);
 			}
-			return static_cast<RamDomain>(result->second);
+			return static_cast<RamDomain>(index);
 		}
 	}
 
 	bool exist(const std::string& symbol) const {
 		// TODO: MPI
-//		auto lease = access.acquire();
-//		(void) lease;  // avoid warning;
-		auto result = strToNum.find(symbol);
-		return result != strToNum.end();
+		size_t index;
+		return findIndex(symbol, index);
 	}
 
 	/** Find the index of a symbol in the table, inserting a new symbol if it does not exist there
@@ -313,8 +515,10 @@ public:
 	 */
 	std::vector<size_t> getIndices() const {
 		std::vector<size_t> indices;
-		for (const auto& p : numToStr) {
-			indices.push_back(p.first);
+		size_t count = store->count.load();
+		indices.reserve(count);
+		for (size_t pos = 0; pos < count; pos++) {
+			indices.push_back(isMoved(pos) ? enumBase() + pos : pos);
 		}
 		return indices;
 	}
@@ -329,16 +533,14 @@ public:
 		} else
 #endif
 		{
-			auto lease = access.acquire();
-			(void) lease;  // avoid warning;
-			auto pos = static_cast<size_t>(index);
-			if (numToStr.find(pos) == numToStr.end()) { //pos >= size()
-					// TODO: use different error reporting here!!
+			const std::string* symbol = find(index);
+			if (symbol == nullptr) {
+				// TODO: use different error reporting here!!
 				std::cerr
 						<< "Error index out of bounds in call to SymbolTable::resolve.\n";
 				exit(1);
 			}
-			return numToStr.at(pos);
+			return *symbol;
 		}
 	}
 
@@ -348,8 +550,13 @@ public:
 			return cacheResolve(index, UNSAFE_RESOLVE);
 		} else
 #endif
-
-		return numToStr.at(static_cast<size_t>(index));
+		{
+			const std::string* symbol = find(index);
+			if (symbol == nullptr) {
+				throw std::out_of_range("Error index out of bounds in call to SymbolTable::unsafeResolve.");
+			}
+			return *symbol;
+		}
 	}
 
 	// added by Qing Gong, MPI not finished
@@ -362,8 +569,16 @@ public:
 		} else
 #endif
 
-		return (index >= MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_1 && index < MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_2) ?
-				numToStr.at(static_cast<size_t>(index)) : std::to_string(index);
+		if (!isEnum(index)) {
+			return std::to_string(index);
+		}
+		const std::string* symbol = find(index);
+		if (symbol == nullptr) {
+			std::cerr
+					<< "Error index out of bounds in call to SymbolTable::enumTypeResolve.\n";
+			exit(1);
+		}
+		return *symbol;
 	}
 
 	/* Return the size of the symbol table, being the number of symbols it currently holds. */
@@ -376,7 +591,7 @@ public:
 			return size;
 		} else
 #endif
-		return numToStr.size();
+		return store->count.load();
 	}
 
 	/** Bulk insert symbols into the table, note that this operation is more efficient than repeated
@@ -389,9 +604,6 @@ public:
 		} else
 #endif
 		{
-			auto lease = access.acquire();
-			(void) lease;  // avoid warning;
-			strToNum.reserve(size() + symbols.size());
 			for (auto& symbol : symbols) {
 				newSymbol(symbol);
 			}
@@ -407,22 +619,21 @@ public:
 			mpi::send(symbol, 0, INSERT_STRING);
 		} else
 #endif
-		{
-			auto lease = access.acquire();
-			(void) lease;  // avoid warning;
-			newSymbol(symbol);
-		}
+		newSymbol(symbol);
 	}
 
 	// added by Qing Gong
-	/** Move the index for a symbol to the end */
+	/** Move the index for a symbol to the end; the symbol keeps its position
+	 * and is flagged as moved, such that resolving it concurrently stays safe */
 	void moveToEnd(const std::string& symbol) {
 		// TODO: MPI
-		auto lease = access.acquire();
+		SymbolKey key = makeKey(symbol);
+		Shard& shard = shardOf(key);
+		auto lease = shard.access.acquire();
 		(void) lease;  // avoid warning;
-		auto it = strToNum.find(symbol);
+		auto it = shard.index.find(key);
 		assert(
-				it != strToNum.end()
+				it != shard.index.end()
 						&& "It's not in the symbol table when moving to the end!");
 		size_t org_index = it->second;
 		// move to the end, and avoid using the maximum value, which may be used in numeric variable
@@ -430,12 +641,7 @@ public:
 				org_index >= 0 && org_index < (ENUM_SYMBOL_OFFSET_1 - ENUM_SYMBOL_OFFSET_2));
 		it->second = MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_1 + org_index;
 
-		auto it2 = numToStr.find(org_index);
-		assert(
-				it2 != numToStr.end()
-						&& "Fail to locate the original index when moving to the end!");
-		numToStr.erase(it2);
-		numToStr[it->second] = symbol;
+		markMoved(org_index);
 	}
 
 	/** Print the symbol table to the given stream. */
@@ -447,19 +653,16 @@ public:
 #endif
 		{
 			out << "SymbolTable: {\n\t";
+			std::vector<size_t> indices = getIndices();
 			out
-					<< join(strToNum, "\n\t",
-							[](std::ostream& out, const std::pair<std::string, std::size_t>& entry) {
-								out << entry.first << "\t => " << entry.second;
+					<< join(indices, "\n\t",
+							[&](std::ostream& out, size_t index) {
+								out << resolve(index) << "\t => " << index;
 							}) << "\n";
 			out << "}\n";
 		}
 	}
 
-	Lock::Lease acquireLock() const {
-		return access.acquire();
-	}
-
 	/** Stream operator, used as a convenience for print. */
 	friend std::ostream& operator<<(std::ostream& out,
 			const SymbolTable& table) {
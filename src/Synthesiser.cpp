@@ -23,6 +23,9 @@
 #include "RamCondition.h"
 #include "RamExistenceCheckAnalysis.h"
 #include "RamIndexScanKeys.h"
+#include "RamLatticeAssociation.h"
+#include "RamLatticeFunction.h"
+#include "RamLatticeFunctor.h"
 #include "RamNode.h"
 #include "RamOperation.h"
 #include "RamProgram.h"
@@ -42,6 +45,7 @@
 #include <cstdlib>
 #include <functional>
 #include <iostream>
+#include <sstream>
 #include <typeinfo>
 #include <utility>
 #include <vector>
@@ -137,6 +141,15 @@ const std::string Synthesiser::getOpContextName(
 	return getRelationName(rel) + "_op_ctxt";
 }
 
+/** Get the type of the data structure of a relation */
+std::unique_ptr<SynthesiserRelation> Synthesiser::getRelationType(
+		const RamRelationReference& rel) {
+	bool isProvInfo = rel.getName().find("@info") != std::string::npos;
+	return SynthesiserRelation::getSynthesiserRelation(rel,
+			translationUnit.getAnalysis<IndexSetAnalysis>()->getIndexes(rel),
+			Global::config().has("provenance") && !isProvInfo);
+}
+
 /** Get relation type struct */
 void Synthesiser::generateRelationTypeStruct(std::ostream& out,
 		std::unique_ptr<SynthesiserRelation> relationType) {
@@ -170,6 +183,18 @@ std::string Synthesiser::toIndex(SearchColumns key) {
 	return tmp.str();
 }
 
+/* Convert an enum type mask to its constructor expression */
+std::string Synthesiser::toEnumTypeMask(const EnumTypeMask& mask,
+		size_t arity) {
+	std::vector<bool> enums, numbers;
+	for (size_t i = 0; i < arity; i++) {
+		enums.push_back(mask.isEnumType(i));
+		numbers.push_back(mask.is_Enum_hasNUMBER(i));
+	}
+	return "EnumTypeMask({" + toString(join(enums)) + "},{"
+			+ toString(join(numbers)) + "})";
+}
+
 /** Get referenced relations */
 std::set<RamRelationReference> Synthesiser::getReferencedRelations(
 		const RamOperation& op) {
@@ -184,6 +209,10 @@ std::set<RamRelationReference> Synthesiser::getReferencedRelations(
 					res.insert(exists->getRelation());
 				} else if (auto provExists = dynamic_cast<const RamProvenanceExistenceCheck*>(&node)) {
 					res.insert(provExists->getRelation());
+				} else if (auto subsumption = dynamic_cast<const RamSubsumptionCheck*>(&node)) {
+					res.insert(subsumption->getRelation());
+				} else if (auto saturation = dynamic_cast<const RamSaturationCheck*>(&node)) {
+					res.insert(saturation->getRelation());
 				} else if (auto project = dynamic_cast<const RamProject*>(&node)) {
 					res.insert(project->getRelation());
 				}
@@ -191,7 +220,7 @@ std::set<RamRelationReference> Synthesiser::getReferencedRelations(
 	return res;
 }
 
-void Synthesiser::emitCode(std::ostream& out, const RamStatement& stmt) {
+void Synthesiser::emitCode(std::ostream& out, const RamNode& node) {
 	class CodeEmitter: public RamVisitor<void, std::ostream&> {
 	private:
 		Synthesiser& synthesiser;
@@ -251,7 +280,7 @@ void Synthesiser::emitCode(std::ostream& out, const RamStatement& stmt) {
 				out << "std::map<std::string, std::string> directiveMap(";
 				out << ioDirectives << ");\n";
 				out
-						<< R"_(if (!inputDirectory.empty() && directiveMap["IO"] == "file" && )_";
+						<< R"_(if (!inputDirectory.empty() && (directiveMap["IO"] == "file" || directiveMap["IO"] == "binary") && )_";
 				out << "directiveMap[\"filename\"].front() != '/') {";
 				out
 						<< R"_(directiveMap["filename"] = inputDirectory + "/" + directiveMap["filename"];)_";
@@ -260,6 +289,10 @@ void Synthesiser::emitCode(std::ostream& out, const RamStatement& stmt) {
 				out << "IOSystem::getInstance().getReader(";
 				out << "SymbolMask({" << load.getRelation().getSymbolMask()
 						<< "})";
+				out << ", "
+						<< synthesiser.toEnumTypeMask(
+								load.getRelation().getEnumTypeMask(),
+								load.getRelation().getArity());
 				out << ", symTable, ioDirectives";
 				out << ", " << Global::config().has("provenance");
 				out << ")->readAll(*"
@@ -270,7 +303,6 @@ void Synthesiser::emitCode(std::ostream& out, const RamStatement& stmt) {
 								"'\\n';}\n";
 			}
 			out << "}\n";
-			//TODO: const EnumTypeMask& enumTypeMask
 			PRINT_END_COMMENT(out);
 		}
 
@@ -282,7 +314,7 @@ void Synthesiser::emitCode(std::ostream& out, const RamStatement& stmt) {
 				out << "std::map<std::string, std::string> directiveMap("
 						<< ioDirectives << ");\n";
 				out
-						<< R"_(if (!outputDirectory.empty() && directiveMap["IO"] == "file" && )_";
+						<< R"_(if (!outputDirectory.empty() && (directiveMap["IO"] == "file" || directiveMap["IO"] == "binary") && )_";
 				out << "directiveMap[\"filename\"].front() != '/') {";
 				out
 						<< R"_(directiveMap["filename"] = outputDirectory + "/" + directiveMap["filename"];)_";
@@ -291,6 +323,10 @@ void Synthesiser::emitCode(std::ostream& out, const RamStatement& stmt) {
 				out << "IOSystem::getInstance().getWriter(";
 				out << "SymbolMask({" << store.getRelation().getSymbolMask()
 						<< "})";
+				out << ", "
+						<< synthesiser.toEnumTypeMask(
+								store.getRelation().getEnumTypeMask(),
+								store.getRelation().getArity());
 				out << ", symTable, ioDirectives";
 				out << ", " << Global::config().has("provenance");
 				out << ")->writeAll(*"
@@ -461,10 +497,97 @@ void Synthesiser::emitCode(std::ostream& out, const RamStatement& stmt) {
 		}
 
 		//added by Qing Gong
+		/** Get the range of the lattice cell of tuple cur in a relation */
+		static std::string getCell(const std::string& rel, SearchColumns keys) {
+			if (keys == 0) {
+				// a relation without key columns is a single cell
+				return "make_range(" + rel + "->begin(), " + rel + "->end())";
+			}
+			return rel + "->equalRange_" + std::to_string(keys) + "(cur)";
+		}
+
 		void visitLatNorm(const RamLatNorm& latNorm, std::ostream& out)
 				override {
 			PRINT_BEGIN_COMMENT(out);
-			out << "//TODO: visitLatNorm\n";
+			const auto& inRel = latNorm.getRelation_IN_Rel();
+			const std::string& in = synthesiser.getRelationName(inRel);
+			const std::string& outRel = synthesiser.getRelationName(
+					latNorm.getRelation_OUT_Rel());
+			size_t arity = inRel.getArity();
+			SearchColumns keys = (SearchColumns(1) << (arity - 1)) - 1;
+			RamDomain top =
+					synthesiser.getTranslationUnit().getP().getLattice()->getTop();
+
+			// join each cell of the input into a single tuple of the output;
+			// a cell is visited once per element, so skip it once it is joined
+			out << "for (const auto& cur : *" << in << ") {\n";
+			out << "if (!" << getCell(outRel, keys) << ".empty()) continue;\n";
+			out << "RamDomain value = cur[" << arity - 1 << "];\n";
+			out << "for (const auto& other : " << getCell(in, keys) << ") {\n";
+			out << "if (value == " << top << ") break;\n";
+			out << "if (other != cur) value = lattice.lub(value, other["
+					<< arity - 1 << "]);\n";
+			out << "}\n";
+			out << "Tuple<RamDomain," << arity << "> tuple(cur);\n";
+			out << "tuple[" << arity - 1 << "] = value;\n";
+			out << outRel << "->insert(tuple);\n";
+			out << "}\n";
+			PRINT_END_COMMENT(out);
+		}
+
+		void visitLatMerge(const RamLatMerge& latMerge, std::ostream& out)
+				override {
+			PRINT_BEGIN_COMMENT(out);
+			const auto& targetRel = latMerge.getTargetRelation();
+			const std::string& target = synthesiser.getRelationName(targetRel);
+			const std::string& source = synthesiser.getRelationName(
+					latMerge.getSourceRelation());
+			const std::string& delta = synthesiser.getRelationName(
+					latMerge.getDeltaRelation());
+			SearchColumns keys = (SearchColumns(1) << (targetRel.getArity() - 1)) - 1;
+
+			// only the cells whose lattice element went up are touched
+			out << "for (const auto& cur : *" << source << ") {\n";
+			out << "if (!" << target << "->insert(cur)) continue;\n";
+			out << "for (const auto& cell : " << getCell(target, keys)
+					<< ") " << delta << "->insert(cell);\n";
+			out << "}\n";
+			PRINT_END_COMMENT(out);
+		}
+
+		void visitLatClean(const RamLatClean& latClean, std::ostream& out)
+				override {
+			PRINT_BEGIN_COMMENT(out);
+			const auto& originRel = latClean.getRelation_IN_Origin();
+			const std::string& origin = synthesiser.getRelationName(originRel);
+			const std::string& in = synthesiser.getRelationName(
+					latClean.getRelation_IN_New());
+			const std::string& outRel = synthesiser.getRelationName(
+					latClean.getRelation_OUT_New());
+			size_t arity = originRel.getArity();
+			SearchColumns keys = (SearchColumns(1) << (arity - 1)) - 1;
+			RamDomain top =
+					synthesiser.getTranslationUnit().getP().getLattice()->getTop();
+
+			// join each cell of the new knowledge with its cell in the origin,
+			// and keep the result only if the origin does not hold it already
+			out << "for (const auto& cur : *" << in << ") {\n";
+			out << "RamDomain value = cur[" << arity - 1 << "];\n";
+			out << "for (const auto& other : " << getCell(in, keys) << ") {\n";
+			out << "if (value == " << top << ") break;\n";
+			out << "if (other != cur) value = lattice.lub(value, other["
+					<< arity - 1 << "]);\n";
+			out << "}\n";
+			out << "for (const auto& other : " << getCell(origin, keys)
+					<< ") {\n";
+			out << "if (value == " << top << ") break;\n";
+			out << "value = lattice.lub(value, other[" << arity - 1 << "]);\n";
+			out << "}\n";
+			out << "Tuple<RamDomain," << arity << "> tuple(cur);\n";
+			out << "tuple[" << arity - 1 << "] = value;\n";
+			out << "if (!" << origin << "->contains(tuple)) " << outRel
+					<< "->insert(tuple);\n";
+			out << "}\n";
 			PRINT_END_COMMENT(out);
 		}
 
@@ -856,11 +979,33 @@ void Synthesiser::emitCode(std::ostream& out, const RamStatement& stmt) {
 			}
 			out << "RamDomain res = " << init << ";\n";
 
-			// get range to aggregate
+			// the b-tree of an index counts a range from the ranks of its ends,
+			// and finds a MIN or MAX of a column at the ends of the range if
+			// the index orders the range by that column
 			auto keys = aggregate.getRangeQueryColumns();
+			auto relationType = synthesiser.getRelationType(rel);
+			bool ranked = relationType->hasRankedIndexes();
+			int column = -1;
+			if (ranked && (aggregate.getFunction() == RamAggregate::MIN
+					|| aggregate.getFunction() == RamAggregate::MAX)) {
+				if (const auto* access =
+						dynamic_cast<const RamElementAccess*>(aggregate.getTargetExpression())) {
+					std::vector<int> order = relationType->getSearchOrder(keys);
+					size_t bound = 0;
+					while (bound < arity && ((keys >> order[bound]) & 1)) {
+						bound++;
+					}
+					int element = access->getElement();
+					if (access->getIdentifier() == identifier
+							&& (((keys >> element) & 1) || (bound < arity && order[bound] == element))) {
+						column = element;
+					}
+				}
+			}
+			bool countRange = ranked && aggregate.getFunction() == RamAggregate::COUNT;
 
-			// check whether there is an index to use
-			if (keys == 0) {
+			// get range to aggregate
+			if (keys == 0 && column < 0) {
 				// no index => use full relation
 				out << "auto& range = " << "*" << relName << ";\n";
 			} else {
@@ -879,12 +1024,13 @@ void Synthesiser::emitCode(std::ostream& out, const RamStatement& stmt) {
 				};
 
 				// get index
-				auto index = synthesiser.toIndex(keys);
 				out << "const " << tuple_type << " key({{";
 				printKeyTuple();
 				out << "}});\n";
-				out << "auto range = " << relName << "->" << "equalRange_"
-						<< keys << "(key," << ctxName << ");\n";
+				if (!countRange) {
+					out << "auto range = " << relName << "->" << "equalRange_"
+							<< keys << "(key," << ctxName << ");\n";
+				}
 			}
 
 			// add existence check
@@ -892,43 +1038,55 @@ void Synthesiser::emitCode(std::ostream& out, const RamStatement& stmt) {
 				out << "if(!range.empty()) {\n";
 			}
 
-			// aggregate result
-			out << "for(const auto& cur : range) {\n";
-
-			// create aggregation code
-			if (aggregate.getFunction() == RamAggregate::COUNT) {
-				// count is easy
-				out << "++res\n;";
-			} else if (aggregate.getFunction() == RamAggregate::SUM) {
-				out << "env" << identifier << " = cur;\n";
-				out << "res += ";
-				visit(*aggregate.getTargetExpression(), out);
-				out << ";\n";
+			if (countRange) {
+				out << "res = " << relName << "->count_" << keys << "(key,"
+						<< ctxName << ");\n";
+			} else if (column >= 0) {
+				if (aggregate.getFunction() == RamAggregate::MIN) {
+					out << "res = (*range.begin())[" << column << "];\n";
+				} else {
+					out << "res = " << relName << "->last_" << keys << "(key,"
+							<< ctxName << ")[" << column << "];\n";
+				}
 			} else {
-				// pick function
-				std::string fun = "min";
-				switch (aggregate.getFunction()) {
-				case RamAggregate::MIN:
-					fun = "std::min";
-					break;
-				case RamAggregate::MAX:
-					fun = "std::max";
-					break;
-				case RamAggregate::COUNT:
-					assert(false);
-				case RamAggregate::SUM:
-					assert(false);
+				// aggregate result
+				out << "for(const auto& cur : range) {\n";
+
+				// create aggregation code
+				if (aggregate.getFunction() == RamAggregate::COUNT) {
+					// count is easy
+					out << "++res\n;";
+				} else if (aggregate.getFunction() == RamAggregate::SUM) {
+					out << "env" << identifier << " = cur;\n";
+					out << "res += ";
+					visit(*aggregate.getTargetExpression(), out);
+					out << ";\n";
+				} else {
+					// pick function
+					std::string fun = "min";
+					switch (aggregate.getFunction()) {
+					case RamAggregate::MIN:
+						fun = "std::min";
+						break;
+					case RamAggregate::MAX:
+						fun = "std::max";
+						break;
+					case RamAggregate::COUNT:
+						assert(false);
+					case RamAggregate::SUM:
+						assert(false);
+					}
+
+					out << "env" << identifier << " = cur;\n";
+					out << "res = " << fun << "(res,";
+					visit(*aggregate.getTargetExpression(), out);
+					out << ");\n";
 				}
 
-				out << "env" << identifier << " = cur;\n";
-				out << "res = " << fun << "(res,";
-				visit(*aggregate.getTargetExpression(), out);
-				out << ");\n";
+				// end aggregator loop
+				out << "}\n";
 			}
 
-			// end aggregator loop
-			out << "}\n";
-
 			// write result into environment tuple
 			out << "env" << identifier << "[0] = res;\n";
 
@@ -1151,6 +1309,65 @@ void Synthesiser::emitCode(std::ostream& out, const RamStatement& stmt) {
 			PRINT_END_COMMENT(out);
 		}
 
+		void visitSubsumptionCheck(const RamSubsumptionCheck& subsumption,
+				std::ostream& out) override {
+			PRINT_BEGIN_COMMENT(out);
+			// get some details
+			const auto& rel = subsumption.getRelation();
+			auto relName = synthesiser.getRelationName(rel);
+			auto ctxName = "READ_OP_CONTEXT("
+					+ synthesiser.getOpContextName(rel) + ")";
+			auto arity = rel.getArity();
+			std::string after;
+			if (Global::config().has("profile")
+					&& !subsumption.getRelation().isTemp()) {
+				out << R"_((reads[)_"
+						<< synthesiser.lookupReadIdx(rel.getName())
+						<< R"_(]++,)_";
+				after = ")";
+			}
+
+			// the relation looks up the cell of the key and compares elements
+			out << relName << "->" << "subsumes(Tuple<RamDomain," << arity
+					<< ">({{" << join(subsumption.getValues(), ",", rec)
+					<< "}})," << ctxName << ")" << after;
+			PRINT_END_COMMENT(out);
+		}
+
+		void visitSaturationCheck(const RamSaturationCheck& saturation,
+				std::ostream& out) override {
+			PRINT_BEGIN_COMMENT(out);
+			// get some details
+			const auto& rel = saturation.getRelation();
+			auto relName = synthesiser.getRelationName(rel);
+			auto ctxName = "READ_OP_CONTEXT("
+					+ synthesiser.getOpContextName(rel) + ")";
+			auto arity = rel.getArity();
+			std::string after;
+			if (Global::config().has("profile")
+					&& !saturation.getRelation().isTemp()) {
+				out << R"_((reads[)_"
+						<< synthesiser.lookupReadIdx(rel.getName())
+						<< R"_(]++,)_";
+				after = ")";
+			}
+
+			// the lattice column is not bound
+			out << relName << "->" << "saturated(Tuple<RamDomain," << arity
+					<< ">({{";
+			out
+					<< join(saturation.getValues(), ",",
+							[&](std::ostream& out, RamValue* value) {
+								if (!value) {
+									out << "0";
+								} else {
+									visit(*value, out);
+								}
+							});
+			out << "}})," << ctxName << ")" << after;
+			PRINT_END_COMMENT(out);
+		}
+
 		void visitProvenanceExistenceCheck(
 				const RamProvenanceExistenceCheck& provExists,
 				std::ostream& out) override {
@@ -1195,7 +1412,35 @@ void Synthesiser::emitCode(std::ostream& out, const RamStatement& stmt) {
 		void visitLatticeGLB(const RamLatticeGLB& rGLB, std::ostream& out)
 				override {
 			PRINT_BEGIN_COMMENT(out);
-			out << "//TODO: visitLatticeGLB\n";
+			const auto* refs = rGLB.getRefs();
+			for (size_t i = 1; i < refs->size(); i++) {
+				out << "lattice.glb(";
+			}
+			auto it = refs->begin();
+			out << "env" << it->identifier << "[" << it->element << "]";
+			for (++it; it != refs->end(); ++it) {
+				out << ", env" << it->identifier << "[" << it->element << "])";
+			}
+			PRINT_END_COMMENT(out);
+		}
+
+		void visitLatticeUnaryFunctor(const RamLatticeUnaryFunctor& luf,
+				std::ostream& out) override {
+			PRINT_BEGIN_COMMENT(out);
+			out << "lattice.luf_" << luf.getName() << "(";
+			visit(luf.getRef(), out);
+			out << ")";
+			PRINT_END_COMMENT(out);
+		}
+
+		void visitLatticeBinaryFunctor(const RamLatticeBinaryFunctor& lbf,
+				std::ostream& out) override {
+			PRINT_BEGIN_COMMENT(out);
+			out << "lattice.lbf_" << lbf.getName() << "(";
+			visit(lbf.getRef1(), out);
+			out << ", ";
+			visit(lbf.getRef2(), out);
+			out << ")";
 			PRINT_END_COMMENT(out);
 		}
 
@@ -1444,7 +1689,13 @@ void Synthesiser::emitCode(std::ostream& out, const RamStatement& stmt) {
 		void visitQuestionMark(const RamQuestionMark& qmark, std::ostream& out)
 				override {
 			PRINT_BEGIN_COMMENT(out);
-			out << "//TODO: visitQuestionMark\n";
+			out << "((";
+			visit(qmark.getCondition(), out);
+			out << ") ? (";
+			visit(qmark.getFirstRet(), out);
+			out << ") : (";
+			visit(qmark.getSecondRet(), out);
+			out << "))";
 			PRINT_END_COMMENT(out);
 		}
 
@@ -1561,11 +1812,190 @@ void Synthesiser::emitCode(std::ostream& out, const RamStatement& stmt) {
 	};
 
 	// emit code
-	CodeEmitter(*this).visit(stmt, out);
+	CodeEmitter(*this).visit(node, out);
+}
+
+/** Generate a lattice function of the lattice struct */
+void Synthesiser::emitLatticeFunction(std::ostream& out,
+		const std::string& name, const RamLatticeFunction& func) {
+	// collect the cases of the function
+	std::vector<std::pair<const RamCondition*, const RamValue*>> cases;
+	size_t arity;
+	if (const auto* unary =
+			dynamic_cast<const RamLatticeUnaryFunction*>(&func)) {
+		arity = 1;
+		for (const auto& cur : unary->getLatCase()) {
+			cases.emplace_back(cur.constraint.get(), cur.output.get());
+		}
+	} else {
+		const auto& binary = static_cast<const RamLatticeBinaryFunction&>(func);
+		arity = 2;
+		for (const auto& cur : binary.getLatCase()) {
+			cases.emplace_back(cur.match.get(), cur.output.get());
+		}
+	}
+
+	std::vector<std::string> decls, params;
+	for (size_t i = 0; i < arity; i++) {
+		decls.push_back("RamDomain arg" + std::to_string(i));
+		params.push_back("arg" + std::to_string(i));
+	}
+
+	// the first case whose match holds determines the output
+	out << "RamDomain eval_" << name << "(" << join(decls, ", ")
+			<< ") const {\n";
+	out << "const RamDomain args[" << arity << "] = {" << join(params, ", ")
+			<< "};\n";
+	bool exhaustive = false;
+	for (const auto& cur : cases) {
+		if (cur.first == nullptr) {
+			out << "return ";
+			emitCode(out, *cur.second);
+			out << ";\n";
+			exhaustive = true;
+			break;
+		}
+		out << "if (";
+		emitCode(out, *cur.first);
+		out << ") return ";
+		emitCode(out, *cur.second);
+		out << ";\n";
+	}
+	if (!exhaustive) {
+		out << "std::cerr << \"Failed to find a match for a lattice "
+				<< (arity == 1 ? "unary" : "binary")
+				<< " functor!\" << std::endl;\n";
+		out << "exit(1);\n";
+	}
+	out << "}\n";
+
+	// without a table every call evaluates the cases
+	const RamLatticeTable& table = func.getTable();
+	if (table.size() == 0) {
+		out << "RamDomain " << name << "(" << join(decls, ", ")
+				<< ") const {\n";
+		out << "return eval_" << name << "(" << join(params, ", ") << ");\n";
+		out << "}\n";
+		return;
+	}
+
+	// enum arguments are mapped to their slot in the table by a switch
+	for (size_t i = 0; i < arity; i++) {
+		const auto& domain = table.getDomain(i);
+		out << "static int slot_" << name << "_" << i
+				<< "(RamDomain arg) {\n";
+		out << "switch (arg) {\n";
+		for (size_t j = 0; j < domain.size(); j++) {
+			out << "case " << domain[j] << ": return " << j << ";\n";
+		}
+		out << "default: return -1;\n";
+		out << "}\n";
+		out << "}\n";
+	}
+	out << "RamDomain table_" << name << "[" << table.size() << "];\n";
+	out << "RamDomain " << name << "(" << join(decls, ", ") << ") const {\n";
+	for (size_t i = 0; i < arity; i++) {
+		out << "int slot" << i << " = slot_" << name << "_" << i << "(arg"
+				<< i << ");\n";
+	}
+	if (arity == 1) {
+		out << "if (slot0 >= 0) return table_" << name << "[slot0];\n";
+	} else {
+		out << "if (slot0 >= 0 && slot1 >= 0) return table_" << name
+				<< "[slot0 * " << table.getDomain(1).size() << " + slot1];\n";
+	}
+	out << "return eval_" << name << "(" << join(params, ", ") << ");\n";
+	out << "}\n";
+}
+
+/** Generate the lattice struct holding the lattice operations and functions */
+void Synthesiser::generateLatticeStruct(std::ostream& out,
+		const RamProgram& prog) {
+	std::vector<std::pair<std::string, const RamLatticeFunction*>> funcs;
+	if (prog.hasLattice()) {
+		funcs.emplace_back("lub", &prog.getLattice()->getLUB());
+		funcs.emplace_back("glb", &prog.getLattice()->getGLB());
+	}
+	for (const auto& cur : prog.getLUFs()) {
+		funcs.emplace_back("luf_" + cur.first, cur.second.get());
+	}
+	for (const auto& cur : prog.getLBFs()) {
+		funcs.emplace_back("lbf_" + cur.first, cur.second.get());
+	}
+	if (funcs.empty()) {
+		return;
+	}
+
+	out << "struct t_lattice {\n";
+	out << "SymbolTable& symTable;\n";
+	if (prog.hasLattice()) {
+		out << "static constexpr RamDomain bot = "
+				<< prog.getLattice()->getBot() << ";\n";
+		out << "static constexpr RamDomain top = "
+				<< prog.getLattice()->getTop() << ";\n";
+	}
+
+	// the constructor precomputes the outputs over enum arguments
+	out << "t_lattice(SymbolTable& symTable) : symTable(symTable) {\n";
+	for (const auto& cur : funcs) {
+		const std::string& name = cur.first;
+		const RamLatticeTable& table = cur.second->getTable();
+		if (table.size() == 0) {
+			continue;
+		}
+		out << "{\n";
+		for (size_t i = 0; i < table.getArity(); i++) {
+			out << "const RamDomain domain" << i << "[] = {"
+					<< join(table.getDomain(i), ",") << "};\n";
+		}
+		if (table.getArity() == 1) {
+			out << "for (size_t i = 0; i < " << table.size() << "; i++) {\n";
+			out << "table_" << name << "[i] = eval_" << name
+					<< "(domain0[i]);\n";
+			out << "}\n";
+		} else {
+			size_t width = table.getDomain(1).size();
+			out << "for (size_t i = 0; i < " << table.getDomain(0).size()
+					<< "; i++) {\n";
+			out << "for (size_t j = 0; j < " << width << "; j++) {\n";
+			out << "table_" << name << "[i * " << width << " + j] = eval_"
+					<< name << "(domain0[i], domain1[j]);\n";
+			out << "}\n";
+			out << "}\n";
+		}
+		out << "}\n";
+	}
+	out << "}\n";
+
+	for (const auto& cur : funcs) {
+		emitLatticeFunction(out, cur.first, *cur.second);
+	}
+	out << "};\n";
 }
 
 void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 		bool& withSharedLibrary) {
+	generateProgram(os, nullptr, nullptr, "", id, withSharedLibrary);
+}
+
+void Synthesiser::generateCode(std::ostream& header, std::ostream& os,
+		std::vector<std::string>& units, const std::string& headerName,
+		const std::string& id, bool& withSharedLibrary) {
+	generateProgram(os, &header, &units, headerName, id, withSharedLibrary);
+}
+
+void Synthesiser::generateProgram(std::ostream& source, std::ostream* header,
+		std::vector<std::string>* units, const std::string& headerName,
+		const std::string& id, bool& withSharedLibrary) {
+	// declarations go to the header if the program is split into units
+	std::ostream& os = (header != nullptr) ? *header : source;
+
+	// member functions defined out of the class by the units, and definitions
+	// accompanying the main function
+	std::vector<std::string> definitions;
+	std::stringstream declarations;
+	std::stringstream sourceDefinitions;
+
 	// ---------------------------------------------------------------
 	//                      Auto-Index Generation
 	// ---------------------------------------------------------------
@@ -1589,6 +2019,9 @@ void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 #endif
 
 	// generate C++ program
+	if (header != nullptr) {
+		os << "#pragma once\n";
+	}
 	os << "\n#include \"souffle/CompiledSouffle.h\"\n";
 	if (Global::config().has("provenance")) {
 		os << "#include <mutex>\n";
@@ -1634,16 +2067,12 @@ void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 	os << "namespace souffle {\n";
 	os << "using namespace ram;\n";
 
+	// lattice operations are shared by lattice relations and rules
+	generateLatticeStruct(os, prog);
+
 	visitDepthFirst(*(prog.getMain()), [&](const RamCreate& create) {
 		// get some table details
-			const RamRelationReference& rel = create.getRelation();
-			const std::string& raw_name = rel.getName();
-
-			bool isProvInfo = raw_name.find("@info") != std::string::npos;
-			auto relationType = SynthesiserRelation::getSynthesiserRelation(
-					rel, idxAnalysis->getIndexes(rel), Global::config().has("provenance") && !isProvInfo);
-
-			generateRelationTypeStruct(os, std::move(relationType));
+			generateRelationTypeStruct(os, getRelationType(create.getRelation()));
 		});
 	os << '\n';
 
@@ -1721,22 +2150,50 @@ void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 
 	os << "public:\n";
 
-	// TODO: Qing Gong, avoid conflict in Symbol Table!
 	// declare symbol table
+	// symbols are listed in the order of their original index; enum symbols
+	// have been moved to the end of the domain and are moved again on construction
+	std::vector<std::string> enumSymbols;
 	os << "// -- initialize symbol table --\n";
 	{
-		os << "SymbolTable symTable\n";
+		const RamDomain enumBase = MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_1;
+		std::vector<std::string> symbols(symTable.size());
+		for (size_t i : symTable.getIndices()) {
+			RamDomain index = i;
+			if (index >= enumBase) {
+				index -= enumBase;
+				enumSymbols.push_back(symTable.resolve(i));
+			}
+			assert((size_t) index < symbols.size() && "symbol indices are not dense");
+			symbols[index] = symTable.resolve(i);
+		}
+		// the symbols are defined with the main function if the program is split into
+		// units, such that new symbols do not change the header shared by all units
+		std::ostream& symbolOs = (header != nullptr) ? sourceDefinitions : os;
+		if (header != nullptr) {
+			os << "static SymbolTable initialSymbols();\n";
+			os << "SymbolTable symTable = initialSymbols();";
+			symbolOs << "SymbolTable " << classname << "::initialSymbols() {\n";
+			symbolOs << "return SymbolTable";
+		} else {
+			symbolOs << "SymbolTable symTable\n";
+		}
 		if (symTable.size() > 0) {
-			os << "{\n";
-			for (size_t i : symTable.getIndices()) {
-				os << "\tR\"_(" << symTable.resolve(i) << ")_\",\n";
+			symbolOs << "{\n";
+			for (const std::string& symbol : symbols) {
+				symbolOs << "\tR\"_(" << symbol << ")_\",\n";
 			}
-//            for (size_t i = 0; i < symTable.size(); i++) {
-//                os << "\tR\"_(" << symTable.resolve(i) << ")_\",\n";
-//            }
-			os << "}";
+			symbolOs << "}";
+		} else if (header != nullptr) {
+			symbolOs << "()";
+		}
+		symbolOs << ";";
+		if (header != nullptr) {
+			symbolOs << "\n}\n";
 		}
-		os << ";";
+	}
+	if (prog.hasLattice() || !prog.getLUFs().empty() || !prog.getLBFs().empty()) {
+		os << "t_lattice lattice{symTable};\n";
 	}
 	if (Global::config().has("profile")) {
 		os << "private:\n";
@@ -1755,13 +2212,18 @@ void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 	std::string initCons;     // initialization of constructor
 	std::string registerRel;  // registration of relations
 	int relCtr = 0;
-	std::string tempType;  // string to hold the type of the temporary relations
 	std::set<std::string> storeRelations;
 	std::set<std::string> loadRelations;
 	visitDepthFirst(*(prog.getMain()),
 			[&](const RamStore& store) {storeRelations.insert(store.getRelation().getName());});
 	visitDepthFirst(*(prog.getMain()),
 			[&](const RamLoad& load) {loadRelations.insert(load.getRelation().getName());});
+	// swapped relations exchange their objects, so the new knowledge takes
+	// the type of the delta knowledge it is swapped with
+	std::map<std::string, const RamRelationReference*> swappedWith;
+	visitDepthFirst(*(prog.getMain()), [&](const RamSwap& swap) {
+		swappedWith[swap.getSecondRelation().getName()] = &swap.getFirstRelation();
+	});
 	visitDepthFirst(*(prog.getMain()), [&](const RamCreate& create) {
 		// get some table details
 			const auto& rel = create.getRelation();
@@ -1769,19 +2231,23 @@ void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 			const std::string& raw_name = rel.getName();
 			const std::string& name = getRelationName(rel);
 
-			// TODO: make this correct
-			// ensure that the type of the new knowledge is the same as that of the delta knowledge
-			bool isDelta = rel.isTemp() && raw_name.find("@delta") != std::string::npos;
-			bool isProvInfo = raw_name.find("@info") != std::string::npos;
-			auto relationType = SynthesiserRelation::getSynthesiserRelation(
-					rel, idxAnalysis->getIndexes(rel), Global::config().has("provenance") && !isProvInfo);
-			tempType = isDelta ? relationType->getTypeName() : tempType;
-			const std::string& type = (rel.isTemp()) ? tempType : relationType->getTypeName();
+			auto relationType = getRelationType(rel);
+			std::string type = relationType->getTypeName();
+			auto partner = swappedWith.find(raw_name);
+			if (partner != swappedWith.end()) {
+				const RamRelationReference& delta = *partner->second;
+				type = SynthesiserRelation::getSynthesiserRelation(delta, idxAnalysis->getIndexes(delta),
+						Global::config().has("provenance"))->getTypeName();
+			}
 
 			// defining table
 			os << "// -- Table: " << raw_name << "\n";
 
-			os << "std::unique_ptr<" << type << "> " << name << " = std::make_unique<" << type << ">();\n";
+			os << "std::unique_ptr<" << type << "> " << name << " = std::make_unique<" << type << ">(";
+			if (relationType->isLattice()) {
+				os << "lattice";
+			}
+			os << ");\n";
 			if (!rel.isTemp()) {
 				os << "souffle::RelationWrapper<";
 				os << relCtr++ << ",";
@@ -1842,6 +2308,9 @@ void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 		os
 				<< "ProfileEventSingleton::instance().setOutputFile(profiling_fname);\n";
 	}
+	for (const std::string& symbol : enumSymbols) {
+		os << "symTable.moveToEnd(R\"_(" << symbol << ")_\");\n";
+	}
 	os << registerRel;
 	os << "}\n";
 	// -- destructor --
@@ -1870,6 +2339,32 @@ void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 	}
 	os << "std::atomic<size_t> iter(0);\n\n";
 
+	// a function emitting the evaluation of a stratum, which is a call of a member
+	// function defined by a unit if the program is split into units
+	const auto& emitStratum = [&](const RamStratum& stratum) {
+		if (header == nullptr) {
+			os << "[&]() {\n";
+			emitCode(os, stratum.getBody());
+			os << "}();\n";
+			return;
+		}
+		const std::string name = "stratum_" + std::to_string(stratum.getIndex());
+		std::string parameters = "const std::string& inputDirectory, const std::string& outputDirectory, "
+				"bool performIO, std::atomic<size_t>& iter";
+		std::string arguments = "inputDirectory, outputDirectory, performIO, iter";
+		if (hasIncrement) {
+			parameters += ", std::atomic<RamDomain>& ctr";
+			arguments += ", ctr";
+		}
+		os << name << "(" << arguments << ");\n";
+		declarations << "void " << name << "(" << parameters << ");\n";
+		std::stringstream definition;
+		definition << "void " << classname << "::" << name << "(" << parameters << ") {\n";
+		emitCode(definition, stratum.getBody());
+		definition << "}\n";
+		definitions.push_back(definition.str());
+	};
+
 	// set default threads (in embedded mode)
 	if (std::stoi(Global::config().get("jobs")) > 0) {
 		os << "#if defined(__EMBEDDED_SOUFFLE__) && defined(_OPENMP)\n";
@@ -1939,22 +2434,42 @@ void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 		}
 	}
 
-	// Set up stratum
-	visitDepthFirst(*(prog.getMain()), [&](const RamStratum& stratum) {
-		os << "/* BEGIN STRATUM " << stratum.getIndex() << " */\n";
-		if (Global::config().has("engine")) {
-			// go to the stratum with the max value for int as a suffix if calling the master stratum
-			auto i = stratum.getIndex();
-			os << "STRATUM_" << i << ":\n";
-		}
-		os << "[&]() {\n";
-		emitCode(os, stratum.getBody());
-		os << "}();\n";
-		if (Global::config().has("engine")) {
-			os << "if (stratumIndex != (size_t) -1) goto EXIT;\n";
-		}
-		os << "/* END STRATUM " << stratum.getIndex() << " */\n";
-	});
+	// Set up strata as a graph of tasks if they are evaluated concurrently
+	if (Global::config().has("parallel-strata")) {
+		std::map<size_t, size_t> positions;
+		os << "std::vector<std::function<void()>> strata;\n";
+		os << "std::vector<std::vector<std::size_t>> dependencies;\n";
+		visitDepthFirst(*(prog.getMain()), [&](const RamStratum& stratum) {
+			std::vector<size_t> positionsOfDependencies;
+			for (size_t dependency : stratum.getDependencies()) {
+				positionsOfDependencies.push_back(positions.at(dependency));
+			}
+			const size_t position = positions.size();
+			positions[stratum.getIndex()] = position;
+			os << "/* BEGIN STRATUM " << stratum.getIndex() << " */\n";
+			os << "strata.push_back([&]() {\n";
+			emitStratum(stratum);
+			os << "});\n";
+			os << "dependencies.push_back({" << join(positionsOfDependencies, ",") << "});\n";
+			os << "/* END STRATUM " << stratum.getIndex() << " */\n";
+		});
+		os << "runTaskGraph(strata, dependencies);\n";
+	} else {
+		// Set up stratum
+		visitDepthFirst(*(prog.getMain()), [&](const RamStratum& stratum) {
+			os << "/* BEGIN STRATUM " << stratum.getIndex() << " */\n";
+			if (Global::config().has("engine")) {
+				// go to the stratum with the max value for int as a suffix if calling the master stratum
+				auto i = stratum.getIndex();
+				os << "STRATUM_" << i << ":\n";
+			}
+			emitStratum(stratum);
+			if (Global::config().has("engine")) {
+				os << "if (stratumIndex != (size_t) -1) goto EXIT;\n";
+			}
+			os << "/* END STRATUM " << stratum.getIndex() << " */\n";
+		});
+	}
 
 	if (Global::config().has("engine")) {
 		os << "EXIT:{}";
@@ -1982,6 +2497,13 @@ void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 
 	os << "}\n";  // end of runFunction() method
 
+	// declare the strata defined by units
+	if (header != nullptr) {
+		os << "private:\n";
+		os << declarations.str();
+		declarations.str("");
+	}
+
 	// add methods to run with and without performing IO (mainly for the interface)
 	os
 			<< "public:\nvoid run(size_t stratumIndex = (size_t) -1) override { runFunction(\".\", \".\", "
@@ -2008,13 +2530,15 @@ void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 					for (IODirectives ioDirectives : store->getIODirectives()) {
 						os << "try {";
 						os << "std::map<std::string, std::string> directiveMap(" << ioDirectives << ");\n";
-						os << R"_(if (!outputDirectory.empty() && directiveMap["IO"] == "file" && )_";
+						os << R"_(if (!outputDirectory.empty() && (directiveMap["IO"] == "file" || directiveMap["IO"] == "binary") && )_";
 						os << "directiveMap[\"filename\"].front() != '/') {";
 						os << R"_(directiveMap["filename"] = outputDirectory + "/" + directiveMap["filename"];)_";
 						os << "}\n";
 						os << "IODirectives ioDirectives(directiveMap);\n";
 						os << "IOSystem::getInstance().getWriter(";
 						os << "SymbolMask({" << store->getRelation().getSymbolMask() << "})";
+						os << ", " << toEnumTypeMask(store->getRelation().getEnumTypeMask(),
+								store->getRelation().getArity());
 						os << ", symTable, ioDirectives, " << Global::config().has("provenance");
 						os << ")->writeAll(*" << getRelationName(store->getRelation()) << ");\n";
 
@@ -2049,13 +2573,15 @@ void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 				os << "try {";
 				os << "std::map<std::string, std::string> directiveMap(";
 				os << ioDirectives << ");\n";
-				os << R"_(if (!inputDirectory.empty() && directiveMap["IO"] == "file" && )_";
+				os << R"_(if (!inputDirectory.empty() && (directiveMap["IO"] == "file" || directiveMap["IO"] == "binary") && )_";
 				os << "directiveMap[\"filename\"].front() != '/') {";
 				os << R"_(directiveMap["filename"] = inputDirectory + "/" + directiveMap["filename"];)_";
 				os << "}\n";
 				os << "IODirectives ioDirectives(directiveMap);\n";
 				os << "IOSystem::getInstance().getReader(";
 				os << "SymbolMask({" << load.getRelation().getSymbolMask() << "})";
+				os << ", " << toEnumTypeMask(load.getRelation().getEnumTypeMask(),
+						load.getRelation().getArity());
 				os << ", symTable, ioDirectives";
 				os << ", " << Global::config().has("provenance");
 				os << ")->readAll(*" << getRelationName(load.getRelation());
@@ -2068,7 +2594,7 @@ void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 
 	// issue dump methods
 	auto dumpRelation =
-			[&](const std::string& name, const SymbolMask& mask, size_t arity) {
+			[&](const std::string& name, const SymbolMask& mask, const EnumTypeMask& enumMask, size_t arity) {
 				auto relName = name;
 
 				os << "try {";
@@ -2077,6 +2603,7 @@ void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 				os << "ioDirectives.setRelationName(\"" << name << "\");\n";
 				os << "IOSystem::getInstance().getWriter(";
 				os << "SymbolMask({" << mask << "})";
+				os << ", " << toEnumTypeMask(enumMask, arity);
 				os << ", symTable, ioDirectives, " << Global::config().has("provenance");
 				os << ")->writeAll(*" << relName << ");\n";
 				os << "} catch (std::exception& e) {std::cerr << e.what();exit(1);}\n";
@@ -2089,7 +2616,7 @@ void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 		auto& name = getRelationName(load.getRelation());
 		auto& mask = load.getRelation().getSymbolMask();
 		size_t arity = load.getRelation().getArity();
-		dumpRelation(name, mask, arity);
+		dumpRelation(name, mask, load.getRelation().getEnumTypeMask(), arity);
 	});
 	os << "}\n";  // end of dumpInputs() method
 
@@ -2100,7 +2627,7 @@ void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 		auto& name = getRelationName(store.getRelation());
 		auto& mask = store.getRelation().getSymbolMask();
 		size_t arity = store.getRelation().getArity();
-		dumpRelation(name, mask, arity);
+		dumpRelation(name, mask, store.getRelation().getEnumTypeMask(), arity);
 	});
 	os << "}\n";  // end of dumpOutputs() method
 
@@ -2126,28 +2653,74 @@ void Synthesiser::generateCode(std::ostream& os, const std::string& id,
 		}
 		os << "}\n";  // end of executeSubroutine
 
-		// generate method for each subroutine
+		// generate method for each subroutine, defined by a unit if the program is split into units
 		subroutineNum = 0;
 		for (auto& sub : prog.getSubroutines()) {
+			const std::string parameters = "(const std::vector<RamDomain>& args, "
+					"std::vector<RamDomain>& ret, std::vector<bool>& err)";
+			std::stringstream definition;
+
 			// method header
-			os << "void " << "subproof_" << subroutineNum
-					<< "(const std::vector<RamDomain>& args, "
-							"std::vector<RamDomain>& ret, std::vector<bool>& err) {\n";
+			if (header != nullptr) {
+				os << "void subproof_" << subroutineNum << parameters << ";\n";
+				definition << "void " << classname << "::subproof_" << subroutineNum << parameters << " {\n";
+			} else {
+				definition << "void " << "subproof_" << subroutineNum << parameters << " {\n";
+			}
 
 			// a lock is needed when filling the subroutine return vectors
-			os << "std::mutex lock;\n";
+			definition << "std::mutex lock;\n";
 
 			// generate code for body
-			emitCode(os, *sub.second);
+			emitCode(definition, *sub.second);
 
-			os << "return;\n";
-			os << "}\n";  // end of subroutine
+			definition << "return;\n";
+			definition << "}\n";  // end of subroutine
+			if (header != nullptr) {
+				definitions.push_back(definition.str());
+			} else {
+				os << definition.str();
+			}
 			subroutineNum++;
 		}
 	}
 
 	os << "};\n";  // end of class declaration
 
+	// the units including the header define the remaining member functions
+	if (header != nullptr) {
+		os << "}\n";  // end of namespace
+		source << "#include \"" << headerName << "\"\n";
+		source << "namespace souffle {\n";
+		source << sourceDefinitions.str();
+		groupUnits(*units, definitions, headerName);
+	}
+
+	generateMain(source, id, classname);
+}
+
+void Synthesiser::groupUnits(std::vector<std::string>& units,
+		const std::vector<std::string>& definitions,
+		const std::string& headerName) {
+	// a unit ends after a definition of a chosen hash, or once it is large, such that
+	// changing a definition rarely moves the ends of other units
+	const size_t definitionsPerUnit = 8;
+	const size_t maxUnitSize = 1 << 19;
+	std::string unit;
+	for (size_t i = 0; i < definitions.size(); i++) {
+		unit += definitions[i];
+		if (i + 1 == definitions.size()
+				|| std::hash<std::string>()(definitions[i]) % definitionsPerUnit == 0
+				|| unit.size() >= maxUnitSize) {
+			units.push_back("#include \"" + headerName + "\"\n"
+					"namespace souffle {\n" + unit + "}\n");
+			unit.clear();
+		}
+	}
+}
+
+void Synthesiser::generateMain(std::ostream& os, const std::string& id,
+		const std::string& classname) {
 	// hidden hooks
 	os << "SouffleProgram *newInstance_" << id << "(){return new " << classname
 			<< ";}\n";
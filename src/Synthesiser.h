@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "EnumTypeMask.h"
 #include "RamStatement.h"
 #include "RamTypes.h"
 #include <map>
@@ -23,10 +24,13 @@
 #include <ostream>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace souffle {
 
+class RamLatticeFunction;
 class RamOperation;
+class RamProgram;
 class RamRelationReference;
 class RamTranslationUnit;
 class SynthesiserRelation;
@@ -67,17 +71,29 @@ protected:
     /** Get context name */
     const std::string getOpContextName(const RamRelationReference& rel);
 
+    /** Get the type of the data structure of a relation */
+    std::unique_ptr<SynthesiserRelation> getRelationType(const RamRelationReference& rel);
+
     /** Get relation struct definition */
     void generateRelationTypeStruct(std::ostream& out, std::unique_ptr<SynthesiserRelation> relationType);
 
     /* Convert SearchColums to a template index */
     std::string toIndex(SearchColumns key);
 
+    /* Convert an enum type mask to its constructor expression */
+    std::string toEnumTypeMask(const EnumTypeMask& mask, size_t arity);
+
     /** Get referenced relations */
     std::set<RamRelationReference> getReferencedRelations(const RamOperation& op);
 
     /** Generate code */
-    void emitCode(std::ostream& out, const RamStatement& stmt);
+    void emitCode(std::ostream& out, const RamNode& node);
+
+    /** Generate a lattice function of the lattice struct */
+    void emitLatticeFunction(std::ostream& out, const std::string& name, const RamLatticeFunction& func);
+
+    /** Generate the lattice struct holding the lattice operations and functions */
+    void generateLatticeStruct(std::ostream& out, const RamProgram& prog);
 
     /** Lookup frequency counter */
     unsigned lookupFreqIdx(const std::string& txt);
@@ -85,6 +101,17 @@ protected:
     /** Lookup read counter */
     size_t lookupReadIdx(const std::string& txt);
 
+    /** Generate the program, split into units including the header if one is given */
+    void generateProgram(std::ostream& source, std::ostream* header, std::vector<std::string>* units,
+            const std::string& headerName, const std::string& id, bool& withSharedLibrary);
+
+    /** Group definitions of member functions into units including the header */
+    void groupUnits(std::vector<std::string>& units, const std::vector<std::string>& definitions,
+            const std::string& headerName);
+
+    /** Generate the hooks creating the program and the main function */
+    void generateMain(std::ostream& os, const std::string& id, const std::string& classname);
+
 public:
     Synthesiser(RamTranslationUnit& tUnit) : translationUnit(tUnit) {}
     virtual ~Synthesiser() = default;
@@ -96,5 +123,10 @@ public:
 
     /** Generate code */
     void generateCode(std::ostream& os, const std::string& id, bool& withSharedLibrary);
+
+    /** Generate code split into a header declaring the program, the source of its main function
+     *  and units defining its strata, such that the units may be compiled in parallel */
+    void generateCode(std::ostream& header, std::ostream& os, std::vector<std::string>& units,
+            const std::string& headerName, const std::string& id, bool& withSharedLibrary);
 };
 }  // end of namespace souffle
@@ -32,6 +32,8 @@ std::unique_ptr<SynthesiserRelation> SynthesiserRelation::getSynthesiserRelation
         rel = new SynthesiserBrieRelation(ramRel, indexSet, isProvenance);
     } else if (ramRel.getRepresentation() == RelationRepresentation::EQREL) {
         rel = new SynthesiserEqrelRelation(ramRel, indexSet, isProvenance);
+    } else if (ramRel.getRepresentation() == RelationRepresentation::LATTICE) {
+        rel = new SynthesiserLatticeRelation(ramRel, indexSet, isProvenance);
     } else {
         // Handle the data structure command line flag
         if (ramRel.getArity() > 6) {
@@ -49,6 +51,48 @@ std::unique_ptr<SynthesiserRelation> SynthesiserRelation::getSynthesiserRelation
     return std::unique_ptr<SynthesiserRelation>(rel);
 }
 
+std::vector<int> SynthesiserRelation::getSearchOrder(SearchColumns search) const {
+    if (search == 0) {
+        return computedIndices[masterIndex];
+    }
+    // the full orders are computed from those of the index set in place
+    const auto orders = indices.getAllOrders();
+    auto pos = std::find(orders.begin(), orders.end(), indices.getLexOrder(search));
+    assert(pos != orders.end() && "search without index");
+    return computedIndices[pos - orders.begin()];
+}
+
+void SynthesiserRelation::generateRangeEnds(std::ostream& out, SearchColumns search, size_t indNum,
+        bool indirect, const std::string& refresh) const {
+    std::string ind = "ind_" + std::to_string(indNum);
+    std::string hints = "h.hints_" + std::to_string(indNum);
+    std::string low = indirect ? "&low" : "low";
+    std::string high = indirect ? "&high" : "high";
+    auto printBounds = [&]() {
+        out << refresh;
+        out << "t_tuple low(t); t_tuple high(t);\n";
+        for (size_t column = 0; column < getArity(); column++) {
+            if (!((search >> column) & 1)) {
+                out << "low[" << column << "] = MIN_RAM_DOMAIN;\n";
+                out << "high[" << column << "] = MAX_RAM_DOMAIN;\n";
+            }
+        }
+    };
+
+    // the last tuple of a non-empty range
+    out << "const t_tuple& last_" << search << "(const t_tuple& t, context& h) const {\n";
+    printBounds();
+    out << "return " << (indirect ? "**" : "*") << ind << ".floor(" << high << ");\n";
+    out << "}\n";
+
+    // the size of the range
+    out << "std::size_t count_" << search << "(const t_tuple& t, context& h) const {\n";
+    printBounds();
+    out << "return " << ind << ".rank(" << ind << ".upper_bound(" << high << ", " << hints << ")) - " << ind
+        << ".rank(" << ind << ".lower_bound(" << low << ", " << hints << "));\n";
+    out << "}\n";
+}
+
 // -------- Nullary Relation --------
 
 /** Generate index set for a nullary relation, which should be empty */
@@ -284,11 +328,13 @@ void SynthesiserDirectRelation::generateTypeStruct(std::ostream& out) {
     out << "range<iterator> equalRange_0(const t_tuple& t, context& h) const {\n";
     out << "return range<iterator>(ind_" << masterIndex << ".begin(),ind_" << masterIndex << ".end());\n";
     out << "}\n";
+    generateRangeEnds(out, 0, masterIndex, false, "");
 
     // equalRange methods for each pattern which is used to search this relation
     for (int64_t search : getIndexSet().getSearches()) {
         auto lexOrder = getIndexSet().getLexOrder(search);
         size_t indNum = indexToNumMap[lexOrder];
+        generateRangeEnds(out, search, indNum, false, "");
 
         out << "range<t_ind_" << indNum << "::iterator> equalRange_" << search;
         out << "(const t_tuple& t, context& h) const {\n";
@@ -576,10 +622,12 @@ void SynthesiserIndirectRelation::generateTypeStruct(std::ostream& out) {
     out << "range<iterator> equalRange_0(const t_tuple& t, context& h) const {\n";
     out << "return range<iterator>(ind_" << masterIndex << ".begin(),ind_" << masterIndex << ".end());\n";
     out << "}\n";
+    generateRangeEnds(out, 0, masterIndex, true, "");
 
     for (int64_t search : getIndexSet().getSearches()) {
         auto lexOrder = getIndexSet().getLexOrder(search);
         size_t indNum = indexToNumMap[lexOrder];
+        generateRangeEnds(out, search, indNum, true, "");
 
         out << "range<iterator_" << indNum << "> equalRange_" << search;
         out << "(const t_tuple& t, context& h) const {\n";
@@ -675,6 +723,391 @@ void SynthesiserIndirectRelation::generateTypeStruct(std::ostream& out) {
     out << "};\n";
 }
 
+// -------- Lattice B-Tree Relation --------
+
+/** Generate index set for a lattice relation */
+void SynthesiserLatticeRelation::computeIndices() {
+    assert(!isProvenance);
+
+    // Generate and set indices
+    std::vector<std::vector<int>> inds = indices.getAllOrders();
+
+    // the cell index orders the key columns before the lattice column
+    masterIndex = 0;
+    if (getArity() > 1) {
+        auto cellInd = indices.getLexOrder(getCellKey());
+        masterIndex = std::find(inds.begin(), inds.end(), cellInd) - inds.begin();
+        assert(masterIndex < inds.size() && "no index on the key columns");
+    }
+
+    // generate a full index if no indices exist
+    if (inds.empty()) {
+        std::vector<int> fullInd(getArity());
+        std::iota(fullInd.begin(), fullInd.end(), 0);
+        inds.push_back(fullInd);
+    }
+
+    // expand all search orders to be full
+    for (auto& ind : inds) {
+        std::set<int> curIndexElems(ind.begin(), ind.end());
+        for (size_t i = 0; i < getArity(); i++) {
+            if (curIndexElems.find(i) == curIndexElems.end()) {
+                ind.push_back(i);
+            }
+        }
+    }
+
+    computedIndices = inds;
+}
+
+/** Generate type name of a lattice relation */
+std::string SynthesiserLatticeRelation::getTypeName() {
+    std::stringstream res;
+    res << "t_lattice_btree_" << getArity();
+
+    for (auto& ind : getIndices()) {
+        res << "__" << join(ind, "_");
+    }
+
+    for (auto& search : getIndexSet().getSearches()) {
+        res << "__" << search;
+    }
+
+    return res.str();
+}
+
+/** Generate type struct of a lattice relation */
+void SynthesiserLatticeRelation::generateTypeStruct(std::ostream& out) {
+    size_t arity = getArity();
+    size_t lat = arity - 1;
+    const auto& inds = getIndices();
+    size_t numIndexes = inds.size();
+    std::map<std::vector<int>, int> indexToNumMap;
+
+    // an index stays sorted when a lattice element goes up iff it orders the
+    // lattice column last; other indices are rebuilt on their next search
+    std::vector<bool> stable;
+    for (auto& ind : inds) {
+        stable.push_back(ind.back() == (int)lat);
+    }
+
+    // struct definition
+    out << "struct " << getTypeName() << " {\n";
+
+    // stored tuple type
+    out << "using t_tuple = Tuple<RamDomain, " << arity << ">;\n";
+
+    // generate the btree type for each relation
+    for (size_t i = 0; i < inds.size(); i++) {
+        auto& ind = inds[i];
+
+        if (i < getIndexSet().getAllOrders().size()) {
+            indexToNumMap[getIndexSet().getAllOrders()[i]] = i;
+        }
+
+        out << "using t_ind_" << i << " = btree_set<t_tuple, index_utils::comparator<" << join(ind)
+            << ">>;\n";
+        if (stable[i]) {
+            out << "t_ind_" << i << " ind_" << i << ";\n";
+        } else {
+            out << "mutable t_ind_" << i << " ind_" << i << ";\n";
+            out << "mutable std::atomic<bool> stale_" << i << "{false};\n";
+        }
+    }
+
+    // the lattice whose least upper bound joins the elements of a cell
+    out << "t_lattice& lattice;\n";
+
+    // cells are joined under the lock of their key's stripe; the indices are
+    // shared by joins and only locked exclusively to add or raise a cell
+    out << "mutable Lock cell_locks[64];\n";
+    out << "mutable ReadWriteLock index_lock;\n";
+    out << "mutable Lock refresh_lock;\n";
+
+    // the number of cells holding the top element
+    out << "std::atomic<std::size_t> saturatedCells{0};\n";
+
+    // typedef master index iterator to be struct iterator
+    out << "using iterator = t_ind_" << masterIndex << "::iterator;\n";
+
+    // constructor
+    out << getTypeName() << "(t_lattice& lattice) : lattice(lattice) {}\n";
+
+    // create a struct storing hints for each btree
+    out << "struct context {\n";
+    for (size_t i = 0; i < numIndexes; i++) {
+        out << "t_ind_" << i << "::operation_hints hints_" << i << ";\n";
+    }
+    out << "};\n";
+    out << "context createContext() { return context(); }\n";
+
+    // rebuild methods for indices that went out of order
+    for (size_t i = 0; i < numIndexes; i++) {
+        if (stable[i]) {
+            continue;
+        }
+        out << "void refresh_" << i << "() const {\n";
+        out << "if (!stale_" << i << ") return;\n";
+        out << "auto lease = refresh_lock.acquire();\n";
+        out << "(void)lease;\n";
+        out << "if (!stale_" << i << ") return;\n";
+        out << "ind_" << i << ".clear();\n";
+        out << "for (const auto& cur : ind_" << masterIndex << ") ind_" << i << ".insert(cur);\n";
+        out << "stale_" << i << " = false;\n";
+        out << "}\n";
+    }
+
+    // lock of the stripe holding the cell of a key
+    out << "Lock& cellLock(const t_tuple& t) const {\n";
+    out << "std::size_t hash = 0;\n";
+    for (size_t column = 0; column < lat; column++) {
+        out << "hash = hash * 31 + static_cast<std::size_t>(t[" << column << "]);\n";
+    }
+    out << "return cell_locks[hash % 64];\n";
+    out << "}\n";
+
+    // insert methods
+    out << "bool insert(const t_tuple& t) {\n";
+    out << "context h;\n";
+    out << "return insert(t, h);\n";
+    out << "}\n";  // end of insert(t_tuple&)
+
+    // join the lattice element of the tuple into the cell of its key
+    out << "bool insert(const t_tuple& t, context& h) {\n";
+    out << "auto lease = cellLock(t).acquire();\n";
+    out << "(void)lease;\n";
+    out << "t_tuple low(t);\n";
+    out << "low[" << lat << "] = MIN_RAM_DOMAIN;\n";
+    out << "index_lock.start_read();\n";
+    out << "auto pos = ind_" << masterIndex << ".lower_bound(low, h.hints_" << masterIndex << ");\n";
+    out << "if (pos == ind_" << masterIndex << ".end()";
+    for (size_t column = 0; column < lat; column++) {
+        out << " || (*pos)[" << column << "] != t[" << column << "]";
+    }
+    out << ") {\n";
+    out << "index_lock.end_read();\n";
+    out << "index_lock.start_write();\n";
+    for (size_t i = 0; i < numIndexes; i++) {
+        out << "ind_" << i << ".insert(t, h.hints_" << i << ");\n";
+    }
+    out << "index_lock.end_write();\n";
+    out << "if (t[" << lat << "] == t_lattice::top) saturatedCells++;\n";
+    out << "return true;\n";
+    out << "}\n";
+    out << "t_tuple old(*pos);\n";
+    out << "index_lock.end_read();\n";
+    out << "RamDomain value = old[" << lat << "];\n";
+    out << "RamDomain joined = value;\n";
+    out << "if (value != t_lattice::top && value != t[" << lat << "]) {\n";
+    out << "joined = lattice.lub(value, t[" << lat << "]);\n";
+    out << "}\n";
+    out << "if (joined == value) {\n";
+    out << "return false;\n";
+    out << "}\n";
+    // the stored tuples are read by the joins of other keys, so the cell is
+    // only written under the exclusive lock; the key lock keeps it in place
+    out << "index_lock.start_write();\n";
+    for (size_t i = 0; i < numIndexes; i++) {
+        if (stable[i]) {
+            out << "const_cast<t_tuple&>(*ind_" << i << ".find(old, h.hints_" << i << "))[" << lat
+                << "] = joined;\n";
+        } else {
+            out << "stale_" << i << " = true;\n";
+        }
+    }
+    out << "index_lock.end_write();\n";
+    out << "if (joined == t_lattice::top) saturatedCells++;\n";
+    out << "return true;\n";
+    out << "}\n";  // end of insert(t_tuple&, context&)
+
+    out << "bool insert(const RamDomain* ramDomain, context& h) {\n";
+    out << "RamDomain data[" << arity << "];\n";
+    out << "std::copy(ramDomain, ramDomain + " << arity << ", data);\n";
+    out << "const t_tuple& tuple = reinterpret_cast<const t_tuple&>(data);\n";
+    out << "return insert(tuple, h);\n";
+    out << "}\n";  // end of insert(RamDomain*, context&)
+
+    out << "bool insert(const RamDomain* ramDomain) {\n";
+    out << "context h;\n";
+    out << "return insert(ramDomain, h);\n";
+    out << "}\n";  // end of insert(RamDomain*)
+
+    std::vector<std::string> decls, params;
+    for (size_t i = 0; i < arity; i++) {
+        decls.push_back("RamDomain a" + std::to_string(i));
+        params.push_back("a" + std::to_string(i));
+    }
+    out << "bool insert(" << join(decls, ",") << ") {\n";
+    out << "RamDomain data[" << arity << "] = {" << join(params, ",") << "};\n";
+    out << "return insert(data);\n";
+    out << "}\n";  // end of insert(RamDomain x1, RamDomain x2, ...)
+
+    // insertAll method, joining tuple by tuple
+    out << "template <typename T>\n";
+    out << "void insertAll(T& other) {\n";
+    out << "context h;\n";
+    out << "for (auto const& cur : other) {\n";
+    out << "insert(cur, h);\n";
+    out << "}\n";
+    out << "}\n";  // end of insertAll<T>
+
+    // contains methods
+    out << "bool contains(const t_tuple& t, context& h) const {\n";
+    out << "return ind_" << masterIndex << ".contains(t, h.hints_" << masterIndex << ");\n";
+    out << "}\n";
+
+    out << "bool contains(const t_tuple& t) const {\n";
+    out << "context h;\n";
+    out << "return contains(t, h);\n";
+    out << "}\n";
+
+    // subsumes methods: the cell of the key holds an element at least as big
+    out << "bool subsumes(const t_tuple& t, context& h) const {\n";
+    out << "t_tuple low(t);\n";
+    out << "low[" << lat << "] = MIN_RAM_DOMAIN;\n";
+    out << "auto pos = ind_" << masterIndex << ".lower_bound(low, h.hints_" << masterIndex << ");\n";
+    out << "if (pos == ind_" << masterIndex << ".end()";
+    for (size_t column = 0; column < lat; column++) {
+        out << " || (*pos)[" << column << "] != t[" << column << "]";
+    }
+    out << ") return false;\n";
+    out << "RamDomain value = (*pos)[" << lat << "];\n";
+    out << "return value == t_lattice::top || value == t[" << lat << "] || lattice.lub(value, t[" << lat
+        << "]) == value;\n";
+    out << "}\n";
+
+    out << "bool subsumes(const t_tuple& t) const {\n";
+    out << "context h;\n";
+    out << "return subsumes(t, h);\n";
+    out << "}\n";
+
+    // saturated methods: the cell of the key holds the top element
+    out << "bool saturated(const t_tuple& t, context& h) const {\n";
+    out << "if (saturatedCells == 0) return false;\n";
+    out << "t_tuple low(t);\n";
+    out << "low[" << lat << "] = t_lattice::top;\n";
+    out << "return ind_" << masterIndex << ".contains(low, h.hints_" << masterIndex << ");\n";
+    out << "}\n";
+
+    out << "bool saturated(const t_tuple& t) const {\n";
+    out << "context h;\n";
+    out << "return saturated(t, h);\n";
+    out << "}\n";
+
+    // size method
+    out << "std::size_t size() const {\n";
+    out << "return ind_" << masterIndex << ".size();\n";
+    out << "}\n";
+
+    // find methods
+    out << "iterator find(const t_tuple& t, context& h) const {\n";
+    out << "return ind_" << masterIndex << ".find(t, h.hints_" << masterIndex << ");\n";
+    out << "}\n";
+
+    out << "iterator find(const t_tuple& t) const {\n";
+    out << "context h;\n";
+    out << "return find(t, h);\n";
+    out << "}\n";
+
+    // empty equalRange method
+    out << "range<iterator> equalRange_0(const t_tuple& t, context& h) const {\n";
+    out << "return range<iterator>(ind_" << masterIndex << ".begin(),ind_" << masterIndex << ".end());\n";
+    out << "}\n";
+
+    out << "range<iterator> equalRange_0(const t_tuple& t) const {\n";
+    out << "return range<iterator>(ind_" << masterIndex << ".begin(),ind_" << masterIndex << ".end());\n";
+    out << "}\n";
+    generateRangeEnds(out, 0, masterIndex, false, "");
+
+    // equalRange methods for each pattern which is used to search this relation
+    for (int64_t search : getIndexSet().getSearches()) {
+        auto lexOrder = getIndexSet().getLexOrder(search);
+        size_t indNum = indexToNumMap[lexOrder];
+        generateRangeEnds(out, search, indNum, false,
+                stable[indNum] ? "" : "refresh_" + std::to_string(indNum) + "();\n");
+
+        out << "range<t_ind_" << indNum << "::iterator> equalRange_" << search;
+        out << "(const t_tuple& t, context& h) const {\n";
+        if (!stable[indNum]) {
+            out << "refresh_" << indNum << "();\n";
+        }
+
+        // generate lower and upper bounds for range search
+        out << "t_tuple low(t); t_tuple high(t);\n";
+        // check which indices to pad out
+        for (size_t column = 0; column < arity; column++) {
+            // if bit number column is set
+            if (!((search >> column) & 1)) {
+                out << "low[" << column << "] = MIN_RAM_DOMAIN;\n";
+                out << "high[" << column << "] = MAX_RAM_DOMAIN;\n";
+            }
+        }
+        out << "return make_range(ind_" << indNum << ".lower_bound(low, h.hints_" << indNum << "), ind_"
+            << indNum << ".upper_bound(high, h.hints_" << indNum << "));\n";
+        out << "}\n";
+
+        out << "range<t_ind_" << indNum << "::iterator> equalRange_" << search;
+        out << "(const t_tuple& t) const {\n";
+        out << "context h;\n";
+        out << "return equalRange_" << search << "(t, h);\n";
+        out << "}\n";
+    }
+
+    // empty method
+    out << "bool empty() const {\n";
+    out << "return ind_" << masterIndex << ".empty();\n";
+    out << "}\n";
+
+    // partition method for parallelism
+    out << "std::vector<range<iterator>> partition() const {\n";
+    out << "return ind_" << masterIndex << ".getChunks(400);\n";
+    out << "}\n";
+
+    // purge method
+    out << "void purge() {\n";
+    for (size_t i = 0; i < numIndexes; i++) {
+        out << "ind_" << i << ".clear();\n";
+        if (!stable[i]) {
+            out << "stale_" << i << " = false;\n";
+        }
+    }
+    out << "saturatedCells = 0;\n";
+    out << "}\n";
+
+    // begin and end iterators
+    out << "iterator begin() const {\n";
+    out << "return ind_" << masterIndex << ".begin();\n";
+    out << "}\n";
+
+    out << "iterator end() const {\n";
+    out << "return ind_" << masterIndex << ".end();\n";
+    out << "}\n";
+
+    // printHintStatistics method
+    out << "void printHintStatistics(std::ostream& o, const std::string prefix) const {\n";
+    for (size_t i = 0; i < numIndexes; i++) {
+        out << "const auto& stats_" << i << " = ind_" << i << ".getHintStatistics();\n";
+        out << "o << prefix << \"arity " << getArity() << " lattice b-tree index " << inds[i]
+            << ": (hits/misses/total)\\n\";\n";
+        out << "o << prefix << \"Insert: \" << stats_" << i << ".inserts.getHits() << \"/\" << stats_" << i
+            << ".inserts.getMisses() << \"/\" << stats_" << i << ".inserts.getAccesses() << \"\\n\";\n";
+        out << "o << prefix << \"Contains: \" << stats_" << i << ".contains.getHits() << \"/\" << stats_" << i
+            << ".contains.getMisses() << \"/\" << stats_" << i << ".contains.getAccesses() << \"\\n\";\n";
+        out << "o << prefix << \"Lower-bound: \" << stats_" << i
+            << ".lower_bound.getHits() << \"/\" << stats_" << i
+            << ".lower_bound.getMisses() << \"/\" << stats_" << i
+            << ".lower_bound.getAccesses() << \"\\n\";\n";
+        out << "o << prefix << \"Upper-bound: \" << stats_" << i
+            << ".upper_bound.getHits() << \"/\" << stats_" << i
+            << ".upper_bound.getMisses() << \"/\" << stats_" << i
+            << ".upper_bound.getAccesses() << \"\\n\";\n";
+    }
+    out << "}\n";
+
+    // end struct
+    out << "};\n";
+}
+
 // -------- Brie Relation --------
 
 /** Generate index set for a brie relation */
@@ -62,11 +62,30 @@ public:
     /** Generate relation type struct */
     virtual void generateTypeStruct(std::ostream& out) = 0;
 
+    /** Check whether the relation is constructed with the lattice struct */
+    virtual bool isLattice() const {
+        return false;
+    }
+
+    /** Check whether the indexes of the relation are b-trees, which find the last
+     *  tuple of a search and count its tuples without a scan, see generateRangeEnds */
+    virtual bool hasRankedIndexes() const {
+        return false;
+    }
+
+    /** Get the full order of the index answering a search, the master index for a full scan */
+    std::vector<int> getSearchOrder(SearchColumns search) const;
+
     /** Factory method to generate a SynthesiserRelation */
     static std::unique_ptr<SynthesiserRelation> getSynthesiserRelation(
             const RamRelationReference& ramRel, const IndexSet& indexSet, bool isProvenance);
 
 protected:
+    /** Generate the methods finding the last tuple of a search and counting its
+     *  tuples from the ranks of the ends of the range in the b-tree of an index */
+    void generateRangeEnds(std::ostream& out, SearchColumns search, size_t indNum, bool indirect,
+            const std::string& refresh) const;
+
     /** Ram relation referred to by this */
     const RamRelationReference& relation;
 
@@ -105,6 +124,10 @@ public:
     void computeIndices() override;
     std::string getTypeName() override;
     void generateTypeStruct(std::ostream& out) override;
+
+    bool hasRankedIndexes() const override {
+        return true;
+    }
 };
 
 class SynthesiserIndirectRelation : public SynthesiserRelation {
@@ -116,6 +139,35 @@ public:
     void computeIndices() override;
     std::string getTypeName() override;
     void generateTypeStruct(std::ostream& out) override;
+
+    bool hasRankedIndexes() const override {
+        return true;
+    }
+};
+
+class SynthesiserLatticeRelation : public SynthesiserRelation {
+public:
+    SynthesiserLatticeRelation(
+            const RamRelationReference& ramRel, const IndexSet& indexSet, bool isProvenance)
+            : SynthesiserRelation(ramRel, indexSet, isProvenance) {}
+
+    void computeIndices() override;
+    std::string getTypeName() override;
+    void generateTypeStruct(std::ostream& out) override;
+
+    bool isLattice() const override {
+        return true;
+    }
+
+    bool hasRankedIndexes() const override {
+        return true;
+    }
+
+private:
+    /** Get the search for the cell of a tuple, i.e. its key columns */
+    SearchColumns getCellKey() const {
+        return (SearchColumns(1) << (getArity() - 1)) - 1;
+    }
 };
 
 class SynthesiserBrieRelation : public SynthesiserRelation {
@@ -269,6 +269,19 @@ struct range {
 
     // splits up this range into the given number of partitions
     std::vector<range> partition(int np = 100) {
+        return partition(a, b, np, 0);
+    }
+
+private:
+    // iterators providing a partition operation split up ranges on their own
+    template <typename I>
+    static auto partition(const I& a, const I& b, int np, int) -> decltype(I::partition(a, b, np)) {
+        return I::partition(a, b, np);
+    }
+
+    // all others are split up by counting the elements of the range
+    template <typename I>
+    static std::vector<range> partition(const I& a, const I& b, int np, long) {
         // obtain the size
         int n = 0;
         for (auto i = a; i != b; ++i) n++;
@@ -21,6 +21,7 @@
 #include "SymbolTable.h"
 
 #include <cassert>
+#include <vector>
 
 namespace souffle {
 
@@ -35,17 +36,30 @@ public:
         if (summary) {
             return writeSize(relation.size());
         }
-        auto lease = symbolTable.acquireLock();
-        (void)lease;
         if (arity == 0) {
             if (relation.begin() != relation.end()) {
                 writeNullary();
             }
+            writeEnd();
             return;
         }
+        writeBegin(relation.size());
+        // tuples are handed to the stream in batches, copied one after another
+        const size_t stride = symbolMask.getArity();
+        std::vector<RamDomain> batch;
+        batch.reserve(BATCH_SIZE * stride);
         for (const auto& current : relation) {
-            writeNext(current);
+            const RamDomain* tuple = dataOf(current);
+            batch.insert(batch.end(), tuple, tuple + stride);
+            if (batch.size() == BATCH_SIZE * stride) {
+                writeNextTuples(batch.data(), BATCH_SIZE);
+                batch.clear();
+            }
+        }
+        if (!batch.empty()) {
+            writeNextTuples(batch.data(), batch.size() / stride);
         }
+        writeEnd();
     }
     template <typename T>
     void writeSize(const T& relation) {
@@ -62,8 +76,20 @@ protected:
     const bool summary;
     const size_t arity;
 
+    /** Called before the tuples of a relation of the given size are written */
+    virtual void writeBegin(std::size_t size) {}
+    /** Called once all tuples were written; errors are reported here rather than on destruction */
+    virtual void writeEnd() {}
     virtual void writeNullary() = 0;
     virtual void writeNextTuple(const RamDomain* tuple) = 0;
+
+    /** Write count tuples stored one after another */
+    virtual void writeNextTuples(const RamDomain* tuples, size_t count) {
+        const size_t stride = symbolMask.getArity();
+        for (size_t i = 0; i < count; ++i) {
+            writeNextTuple(tuples + i * stride);
+        }
+    }
     virtual void writeSize(std::size_t size) {
         assert(false && "attempting to print size of a write operation");
     }
@@ -71,6 +97,17 @@ protected:
     void writeNext(const Tuple tuple) {
         writeNextTuple(tuple.data);
     }
+
+private:
+    enum { BATCH_SIZE = 1 << 16 };
+
+    template <typename Tuple>
+    static const RamDomain* dataOf(const Tuple& tuple) {
+        return tuple.data;
+    }
+    static const RamDomain* dataOf(const RamDomain* tuple) {
+        return tuple;
+    }
 };
 
 class WriteStreamFactory {
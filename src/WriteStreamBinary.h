@@ -0,0 +1,160 @@
+/*
+ * Souffle - A Datalog Compiler
+ * Copyright (c) 2013, 2014, Oracle and/or its affiliates. All rights reserved
+ * Licensed under the Universal Permissive License v 1.0 as shown at:
+ * - https://opensource.org/licenses/UPL
+ * - <souffle root>/licenses/SOUFFLE-UPL.txt
+ */
+
+/************************************************************************
+ *
+ * @file WriteStreamBinary.h
+ *
+ ***********************************************************************/
+
+#pragma once
+
+#include "BinaryFormat.h"
+#include "IODirectives.h"
+#include "SymbolMask.h"
+#include "EnumTypeMask.h"
+#include "SymbolTable.h"
+#include "WriteStream.h"
+
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace souffle {
+
+/**
+ * Writes a relation in the columnar binary format, see BinaryFormat.h.
+ *
+ * The size of the relation is known up front, so each batch of tuples is
+ * scattered straight into its place in the columns. Only the symbol
+ * dictionary is kept in memory; it and the header are written by writeEnd.
+ */
+class WriteFileBinary : public WriteStream {
+public:
+    WriteFileBinary(const SymbolMask& symbolMask, const EnumTypeMask& enumTypeMask, const SymbolTable& symbolTable,
+            const IODirectives& ioDirectives, const bool provenance = false)
+            : WriteStream(symbolMask, enumTypeMask, symbolTable, provenance),
+              fileName(ioDirectives.getFileName()), file(fileName, std::ios::out | std::ios::binary) {
+        if (!file.is_open()) {
+            throw std::invalid_argument("Cannot open output file " + fileName + "\n");
+        }
+        offsets.push_back(0);
+        // the header stays zeroed, and so invalid, until the file is complete
+        const char placeholder[sizeof(BinaryHeader)] = {};
+        file.write(placeholder, sizeof(placeholder));
+    }
+
+protected:
+    void writeBegin(std::size_t count) override {
+        capacity = count;
+    }
+
+    void writeEnd() override {
+        if (arity > 0 && size != capacity) {
+            throw std::runtime_error("Relation size does not match the tuples written to output file " + fileName + "\n");
+        }
+        BinaryHeader header;
+        header.arity = arity;
+        header.size = size;
+        header.symbols = offsets.size() - 1;
+        header.symbolBytes = characters.size();
+        const uint64_t columnEnd = arity * size * sizeof(RamDomain);
+        const char padding[8] = {};
+        file.seekp(sizeof(BinaryHeader) + columnEnd);
+        file.write(padding, header.columnBytes() - columnEnd);
+        file.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        file.write(characters.data(), characters.size());
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.flush();
+        if (file.fail()) {
+            throw std::runtime_error("Cannot write output file " + fileName + "\n");
+        }
+    }
+
+    void writeNullary() override {
+        size = 1;
+    }
+
+    void writeNextTuple(const RamDomain* tuple) override {
+        writeNextTuples(tuple, 1);
+    }
+
+    void writeNextTuples(const RamDomain* tuples, size_t count) override {
+        if (size + count > capacity) {
+            throw std::runtime_error("Relation size does not match the tuples written to output file " + fileName + "\n");
+        }
+        const size_t stride = symbolMask.getArity();
+        column.resize(count);
+        for (size_t col = 0; col < arity; ++col) {
+            for (size_t i = 0; i < count; ++i) {
+                RamDomain value = tuples[i * stride + col];
+                if (symbolMask.isSymbol(col)) {
+                    value = encode(symbolIds, value, symbolTable.unsafeResolve(value));
+                } else if (enumTypeMask.isEnumType(col)) {
+                    value = encode(enumIds, value, symbolTable.enumTypeResolve(value));
+                }
+                column[i] = value;
+            }
+            file.seekp(sizeof(BinaryHeader) + (col * capacity + size) * sizeof(RamDomain));
+            file.write(reinterpret_cast<const char*>(column.data()), count * sizeof(RamDomain));
+        }
+        size += count;
+        if (file.fail()) {
+            throw std::runtime_error("Cannot write output file " + fileName + "\n");
+        }
+    }
+
+private:
+    /** Index of a value in the symbol dictionary, adding its text if it is not there yet */
+    RamDomain encode(std::unordered_map<RamDomain, RamDomain>& ids, RamDomain value, const std::string& text) {
+        auto it = ids.find(value);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        RamDomain id = offsets.size() - 1;
+        ids[value] = id;
+        characters.insert(characters.end(), text.begin(), text.end());
+        offsets.push_back(characters.size());
+        return id;
+    }
+
+    const std::string fileName;
+    std::ofstream file;
+    uint64_t capacity = 0;
+    uint64_t size = 0;
+
+    /** One column of the batch being written */
+    std::vector<RamDomain> column;
+
+    /** Dictionary indices of the symbols and enum values written so far */
+    std::unordered_map<RamDomain, RamDomain> symbolIds;
+    std::unordered_map<RamDomain, RamDomain> enumIds;
+
+    /** The symbol dictionary */
+    std::vector<uint64_t> offsets;
+    std::vector<char> characters;
+};
+
+class WriteFileBinaryFactory : public WriteStreamFactory {
+public:
+    std::unique_ptr<WriteStream> getWriter(const SymbolMask& symbolMask, const EnumTypeMask& enumTypeMask,
+            const SymbolTable& symbolTable, const IODirectives& ioDirectives, const bool provenance) override {
+        return std::make_unique<WriteFileBinary>(symbolMask, enumTypeMask, symbolTable, ioDirectives, provenance);
+    }
+    const std::string& getName() const override {
+        static const std::string name = "binary";
+        return name;
+    }
+    ~WriteFileBinaryFactory() override = default;
+};
+
+} /* namespace souffle */
@@ -21,14 +21,19 @@
 #include "SymbolTable.h"
 #include "WriteStream.h"
 #ifdef USE_LIBZ
-#include "gzfstream.h"
+#include <zlib.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <fstream>
 #include <memory>
 #include <ostream>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 namespace souffle {
 
@@ -40,6 +45,63 @@ protected:
         }
         return "\t";
     }
+
+    /** Append the text of a tuple as one line */
+    static void formatTuple(std::string& out, const RamDomain* tuple, size_t arity, const std::string& delimiter,
+            const SymbolMask& symbolMask, const EnumTypeMask& enumTypeMask, const SymbolTable& symbolTable) {
+        for (size_t col = 0; col < arity; ++col) {
+            if (col > 0) {
+                out += delimiter;
+            }
+            if (symbolMask.isSymbol(col)) {
+                out += symbolTable.unsafeResolve(tuple[col]);
+            } else if (enumTypeMask.isEnumType(col)) {
+                out += symbolTable.enumTypeResolve(tuple[col]);
+            } else {
+                formatNumber(out, tuple[col]);
+            }
+        }
+        out += '\n';
+    }
+
+    /**
+     * Split count tuples into slices that are formatted in parallel, each into its own buffer
+     * by format(buffer, begin, end), and hand the buffers to write in order.
+     */
+    template <typename Format, typename Write>
+    static void formatInParallel(size_t count, Format format, Write write) {
+        const size_t slices = std::max<size_t>(1, std::min<size_t>(MAX_THREADS, count / MIN_SLICE));
+        std::vector<std::string> buffers(slices);
+#pragma omp parallel for schedule(static, 1) if (slices > 1)
+        for (size_t slice = 0; slice < slices; ++slice) {
+            format(buffers[slice], count * slice / slices, count * (slice + 1) / slices);
+        }
+        for (const std::string& buffer : buffers) {
+            write(buffer);
+        }
+    }
+
+private:
+    /** Minimal number of tuples formatted by one thread */
+    enum { MIN_SLICE = 4096 };
+
+    static void formatNumber(std::string& out, RamDomain value) {
+        char digits[24];
+        char* end = digits + sizeof(digits);
+        char* pos = end;
+        auto magnitude = static_cast<typename std::make_unsigned<RamDomain>::type>(value);
+        if (value < 0) {
+            magnitude = -magnitude;
+        }
+        do {
+            *--pos = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude != 0);
+        if (value < 0) {
+            *--pos = '-';
+        }
+        out.append(pos, end);
+    }
 };
 
 class WriteFileCSV : public WriteStreamCSV, public WriteStream {
@@ -64,69 +126,129 @@ protected:
     }
 
     void writeNextTuple(const RamDomain* tuple) override {
-        if (symbolMask.isSymbol(0)) {
-            file << symbolTable.unsafeResolve(tuple[0]);
-        } else if (enumTypeMask.isEnumType(0)) {
-        	file << symbolTable.enumTypeResolve(tuple[0]);
-        } else {
-            file << tuple[0];
-        }
-        for (size_t col = 1; col < arity; ++col) {
-            file << delimiter;
-            if (symbolMask.isSymbol(col)) {
-                file << symbolTable.unsafeResolve(tuple[col]);
-            } else if (enumTypeMask.isEnumType(col)) {
-            	file << symbolTable.enumTypeResolve(tuple[col]);
-            } else {
-                file << tuple[col];
-            }
-        }
-        file << "\n";
+        writeNextTuples(tuple, 1);
+    }
+
+    void writeNextTuples(const RamDomain* tuples, size_t count) override {
+        const size_t stride = symbolMask.getArity();
+        formatInParallel(count,
+                [&](std::string& out, size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; ++i) {
+                        formatTuple(out, tuples + i * stride, arity, delimiter, symbolMask, enumTypeMask,
+                                symbolTable);
+                    }
+                },
+                [&](const std::string& text) { file.write(text.data(), text.size()); });
     }
 };
 
 #ifdef USE_LIBZ
+/**
+ * Writes gzip compressed CSV files. Batches of tuples are formatted in parallel and the text is
+ * collected until it fills members of MEMBER_SIZE bytes, which are compressed in parallel; a
+ * sequence of gzip members is a valid gzip file. The remaining text is compressed by writeEnd.
+ */
 class WriteGZipFileCSV : public WriteStreamCSV, public WriteStream {
 public:
     WriteGZipFileCSV(const SymbolMask& symbolMask, const EnumTypeMask& enumTypeMask, const SymbolTable& symbolTable,
             const IODirectives& ioDirectives, const bool provenance = false)
             : WriteStream(symbolMask, enumTypeMask, symbolTable, provenance), delimiter(getDelimiter(ioDirectives)),
-              file(ioDirectives.getFileName(), std::ios::out | std::ios::binary) {
+              fileName(ioDirectives.getFileName()), file(fileName, std::ios::out | std::ios::binary) {
         if (ioDirectives.has("headers") && ioDirectives.get("headers") == "true") {
-            file << ioDirectives.get("attributeNames") << std::endl;
+            pending += ioDirectives.get("attributeNames") + "\n";
         }
     }
 
     ~WriteGZipFileCSV() override = default;
 
 protected:
+    void writeEnd() override {
+        compressPending(true);
+        file.flush();
+        if (file.fail()) {
+            throw std::runtime_error("Cannot write output file " + fileName + "\n");
+        }
+    }
+
     void writeNullary() override {
-        file << "()\n";
+        pending += "()\n";
     }
 
     void writeNextTuple(const RamDomain* tuple) override {
-        if (symbolMask.isSymbol(0)) {
-            file << symbolTable.unsafeResolve(tuple[0]);
-        } else if (enumTypeMask.isEnumType(0)) {
-        	file << symbolTable.enumTypeResolve(tuple[0]);
-        } else {
-            file << tuple[0];
-        }
-        for (size_t col = 1; col < arity; ++col) {
-            file << delimiter;
-            if (symbolMask.isSymbol(col)) {
-                file << symbolTable.unsafeResolve(tuple[col]);
-            } else if (enumTypeMask.isEnumType(col)) {
-            	file << symbolTable.enumTypeResolve(tuple[col]);
-            } else {
-                file << tuple[col];
+        writeNextTuples(tuple, 1);
+    }
+
+    void writeNextTuples(const RamDomain* tuples, size_t count) override {
+        const size_t stride = symbolMask.getArity();
+        formatInParallel(count,
+                [&](std::string& out, size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; ++i) {
+                        formatTuple(out, tuples + i * stride, arity, delimiter, symbolMask, enumTypeMask,
+                                symbolTable);
+                    }
+                },
+                [&](const std::string& text) { pending += text; });
+        compressPending(false);
+    }
+
+    /**
+     * Compress the pending text into members of MEMBER_SIZE bytes. The rest is kept for the
+     * next batch, unless this is the last call, which writes it as a final, possibly empty, member.
+     */
+    void compressPending(bool last) {
+        size_t members = pending.size() / MEMBER_SIZE;
+        if (last && (members == 0 || pending.size() % MEMBER_SIZE != 0)) {
+            ++members;
+        }
+        std::vector<std::string> compressed(members);
+        std::atomic<bool> failed(false);
+#pragma omp parallel for schedule(static, 1) if (members > 1)
+        for (size_t i = 0; i < members; ++i) {
+            const size_t begin = i * MEMBER_SIZE;
+            const size_t length = std::min<size_t>(MEMBER_SIZE, pending.size() - begin);
+            if (!compress(pending.data() + begin, length, compressed[i])) {
+                failed = true;
             }
         }
-        file << "\n";
+        if (failed) {
+            throw std::runtime_error("Cannot compress output");
+        }
+        for (const std::string& member : compressed) {
+            file.write(member.data(), member.size());
+        }
+        pending.erase(0, std::min(pending.size(), members * size_t(MEMBER_SIZE)));
+    }
+
+    /** Compress text into a complete gzip member, returns false on failure */
+    static bool compress(const char* text, size_t length, std::string& member) {
+        z_stream stream;
+        stream.zalloc = Z_NULL;
+        stream.zfree = Z_NULL;
+        stream.opaque = Z_NULL;
+        if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return false;
+        }
+        member.resize(deflateBound(&stream, length));
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text));
+        stream.avail_in = length;
+        stream.next_out = reinterpret_cast<Bytef*>(&member[0]);
+        stream.avail_out = member.size();
+        int result = deflate(&stream, Z_FINISH);
+        member.resize(stream.total_out);
+        deflateEnd(&stream);
+        return result == Z_STREAM_END;
     }
 
     const std::string delimiter;
-    gzfstream::ogzfstream file;
+    const std::string fileName;
+    std::ofstream file;
+
+    /** Formatted text that has not been compressed yet */
+    std::string pending;
+
+private:
+    /** Number of bytes of text compressed into one gzip member */
+    enum { MEMBER_SIZE = 1 << 20 };
 };
 #endif
 
@@ -152,24 +274,19 @@ protected:
     }
 
     void writeNextTuple(const RamDomain* tuple) override {
-        if (symbolMask.isSymbol(0)) {
-            std::cout << symbolTable.unsafeResolve(tuple[0]);
-        } else if (enumTypeMask.isEnumType(0)) {
-        	std::cout << symbolTable.enumTypeResolve(tuple[0]);
-        } else {
-            std::cout << tuple[0];
-        }
-        for (size_t col = 1; col < arity; ++col) {
-            std::cout << delimiter;
-            if (symbolMask.isSymbol(col)) {
-                std::cout << symbolTable.unsafeResolve(tuple[col]);
-            } else if (enumTypeMask.isEnumType(col)) {
-            	std::cout << symbolTable.enumTypeResolve(tuple[col]);
-            } else {
-                std::cout << tuple[col];
-            }
-        }
-        std::cout << "\n";
+        writeNextTuples(tuple, 1);
+    }
+
+    void writeNextTuples(const RamDomain* tuples, size_t count) override {
+        const size_t stride = symbolMask.getArity();
+        formatInParallel(count,
+                [&](std::string& out, size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; ++i) {
+                        formatTuple(out, tuples + i * stride, arity, delimiter, symbolMask, enumTypeMask,
+                                symbolTable);
+                    }
+                },
+                [&](const std::string& text) { std::cout.write(text.data(), text.size()); });
     }
 
     const std::string delimiter;
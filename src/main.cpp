@@ -64,9 +64,10 @@
 namespace souffle {
 
 /**
- * Executes a binary file.
+ * Executes a binary file, removing it and the given files it was generated from afterwards
+ * unless the binary is to be kept.
  */
-void executeBinary(const std::string& binaryFilename
+void executeBinary(const std::string& binaryFilename, const std::vector<std::string>& generatedFilenames
 #ifdef USE_MPI
         ,
         const int numberOfProcesses
@@ -99,7 +100,9 @@ void executeBinary(const std::string& binaryFilename
 
     if (Global::config().get("dl-program").empty()) {
         remove(binaryFilename.c_str());
-        remove((binaryFilename + ".cpp").c_str());
+        for (const std::string& filename : generatedFilenames) {
+            remove(filename.c_str());
+        }
     }
 
     // exit with same code as executable
@@ -109,15 +112,15 @@ void executeBinary(const std::string& binaryFilename
 }
 
 /**
- * Compiles the given source file to a binary file.
+ * Compiles the given source files to a binary file, named after the first of them.
  */
-void compileToBinary(std::string compileCmd, const std::string& sourceFilename) {
+void compileToBinary(std::string compileCmd, const std::vector<std::string>& sourceFilenames) {
     // add source code
-    compileCmd += sourceFilename;
+    compileCmd += toString(join(sourceFilenames, " "));
 
     // run executable
     if (system(compileCmd.c_str()) != 0) {
-        throw std::invalid_argument("failed to compile C++ source <" + sourceFilename + ">");
+        throw std::invalid_argument("failed to compile C++ source <" + sourceFilenames.front() + ">");
     }
 }
 
@@ -193,6 +196,8 @@ int main(int argc, char** argv) {
                 {"hostfile", '\1', "FILE", "", false,
                         "Specify --hostfile option for call to mpiexec when using mpi as "
                         "execution engine."},
+                {"parallel-strata", '\3', "", "", false,
+                        "Evaluate strata concurrently once the strata they depend on are complete."},
                 {"verbose", 'v', "", "", false, "Verbose output."},
                 {"version", '\2', "", "", false, "Version."},
                 {"help", 'h', "", "", false, "Display this help message."}};
@@ -335,6 +340,16 @@ int main(int argc, char** argv) {
         if (Global::config().has("live-profile") && !Global::config().has("profile")) {
             Global::config().set("profile");
         }
+
+        /* disable concurrent strata with distributed execution and profiling */
+        if (Global::config().has("parallel-strata")) {
+            if (Global::config().has("engine")) {
+                throw std::runtime_error("parallel strata cannot be enabled with distributed execution.");
+            }
+            if (Global::config().has("profile")) {
+                throw std::runtime_error("parallel strata cannot be enabled with profiling.");
+            }
+        }
     } catch (std::exception& e) {
         std::cerr << e.what() << std::endl;
         exit(1);
@@ -560,6 +575,7 @@ int main(int argc, char** argv) {
         try {
             // Find the base filename for code generation and execution
             std::string baseFilename;
+            bool isTemporary = false;
             if (Global::config().has("dl-program")) {
                 baseFilename = Global::config().get("dl-program");
             } else if (Global::config().has("generate")) {
@@ -570,17 +586,46 @@ int main(int argc, char** argv) {
                 }
             } else {
                 baseFilename = tempFile();
+                isTemporary = true;
             }
             if (baseName(baseFilename) == "/" || baseName(baseFilename) == ".") {
                 baseFilename = tempFile();
+                isTemporary = true;
             }
 
-            std::string baseIdentifier = identifier(simpleName(baseFilename));
-            std::string sourceFilename = baseFilename + ".cpp";
+            // temporary programs are named after the datalog program, such that
+            // the code generated for it and its compiled units are the same in each run
+            std::string baseIdentifier =
+                    identifier(simpleName(isTemporary ? Global::config().get("") : baseFilename));
+            std::vector<std::string> sourceFilenames{baseFilename + ".cpp"};
+            std::vector<std::string> generatedFilenames = sourceFilenames;
 
             bool withSharedLibrary;
-            std::ofstream os(sourceFilename);
-            synthesiser->generateCode(os, baseIdentifier, withSharedLibrary);
+            std::ofstream os(sourceFilenames.front());
+            if (Global::config().has("compile")) {
+                // split the program into units to be compiled in parallel
+                const std::string headerFilename = baseFilename + ".h";
+                std::ofstream header(headerFilename);
+                std::vector<std::string> units;
+                synthesiser->generateCode(
+                        header, os, units, baseName(headerFilename), baseIdentifier, withSharedLibrary);
+                generatedFilenames.push_back(headerFilename);
+                for (size_t i = 0; i < units.size(); i++) {
+                    sourceFilenames.push_back(baseFilename + "_" + std::to_string(i + 1) + ".cpp");
+                    std::ofstream unit(sourceFilenames.back());
+                    unit << units[i];
+                    generatedFilenames.push_back(sourceFilenames.back());
+                }
+                // the main source file includes the units unless they are compiled
+                // separately, so that it still builds on its own, e.g. when embedded
+                os << "#ifndef __SOUFFLE_SEPARATE_UNITS__\n";
+                for (size_t i = 1; i < sourceFilenames.size(); i++) {
+                    os << "#include \"" << baseName(sourceFilenames[i]) << "\"\n";
+                }
+                os << "#endif\n";
+            } else {
+                synthesiser->generateCode(os, baseIdentifier, withSharedLibrary);
+            }
             os.close();
 
             if (withSharedLibrary) {
@@ -590,7 +635,7 @@ int main(int argc, char** argv) {
             if (Global::config().has("compile")) {
                 auto start = std::chrono::high_resolution_clock::now();
                 std::cout << "start compiling generated C++ code!\n";
-                compileToBinary(compileCmd, sourceFilename);
+                compileToBinary(compileCmd, sourceFilenames);
                 /* Report overall run-time in verbose mode */
                 if (Global::config().has("verbose")) {
                     auto end = std::chrono::high_resolution_clock::now();
@@ -599,7 +644,7 @@ int main(int argc, char** argv) {
                 }
                 // run compiled C++ program if requested.
                 if (!Global::config().has("dl-program")) {
-                    executeBinary(baseFilename
+                    executeBinary(baseFilename, generatedFilenames
 #ifdef USE_MPI
                             ,
                             ((int)astTranslationUnit->getAnalysis<SCCGraph>()->getNumberOfSCCs()) + 1
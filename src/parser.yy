@@ -548,6 +548,7 @@ lattice_unary_def
   		$$->setSrcLoc(@$);
   		$$->setName($2);
   		$$->setArg($4);
+  		$$->setArgType($6);
   		$$->setOutput($9);
   	}
 
@@ -568,6 +569,8 @@ lattice_binary_def
   		$$->setName($2);
   		$$->addArg($4);
   		$$->addArg($8);
+  		$$->addArgType($6);
+  		$$->addArgType($10);
   		$$->setOutput($13);
   	}
 
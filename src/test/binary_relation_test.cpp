@@ -512,6 +512,35 @@ TEST(EqRelTest, IterPartition) {
     EXPECT_EQ(br.size(), values.size());
 }
 
+TEST(EqRelTest, IterPartitionExact) {
+    // test that the chunks cover every pair exactly once, for dj sets of mixed sizes
+    EqRel br;
+    for (RamDomain i = 0; i < 500; ++i) {
+        br.insert(i, i);
+    }
+    for (RamDomain i = 500; i < 1500; ++i) {
+        br.insert(i, i - i % 10);
+    }
+    for (RamDomain i = 2000; i < 2300; ++i) {
+        br.insert(2000, i);
+    }
+    const size_t numPairs = 500 + 100 * 10 * 10 + 300 * 300;
+    EXPECT_EQ(numPairs, br.size());
+
+    for (size_t chunks : {1, 7, 64, 1000}) {
+        std::set<std::pair<RamDomain, RamDomain>> values;
+        size_t count = 0;
+        for (auto chunk : br.partition(chunks)) {
+            for (auto x = chunk.begin(); x != chunk.end(); ++x) {
+                values.insert(std::make_pair((*x)[0], (*x)[1]));
+                ++count;
+            }
+        }
+        EXPECT_EQ(numPairs, count);
+        EXPECT_EQ(numPairs, values.size());
+    }
+}
+
 TEST(EqRelTest, Scaling) {
     const int N = 100;
 
@@ -330,6 +330,78 @@ TEST(BTreeSet, Merge) {
     EXPECT_EQ(c, d);
 }
 
+TEST(BTreeSet, InsertSorted) {
+    using test_set = btree_set<int, detail::comparator<int>, std::allocator<int>, 16>;
+
+    test_set t;
+    std::set<int> r;
+
+    // merge ranges of increasing size, interleaved with single insertions
+    int N = 10;
+    for (int n = 10; n < 20000; n *= 3) {
+        std::vector<int> data;
+        for (int i = 0; i < n; i++) {
+            data.push_back((i * 7) % (2 * n));
+        }
+        std::sort(data.begin(), data.end());
+
+        t.insertSorted(data.begin(), data.end());
+        r.insert(data.begin(), data.end());
+        EXPECT_TRUE(t.check());
+
+        for (int i = 0; i < N; i++) {
+            t.insert(i * 11);
+            r.insert(i * 11);
+        }
+        N *= 2;
+
+        EXPECT_TRUE(t.check());
+        EXPECT_EQ(r.size(), t.size());
+        EXPECT_TRUE(std::equal(r.begin(), r.end(), t.begin()));
+    }
+}
+
+TEST(BTreeSet, RankSelect) {
+    using test_set = btree_set<int, detail::comparator<int>, std::allocator<int>, 16>;
+
+    for (std::size_t n : {0, 1, 10, 100, 1000, 10000}) {
+        test_set t;
+        for (std::size_t i = 0; i < n; i++) {
+            t.insert(int((i * 7919) % n * 2));
+        }
+        EXPECT_EQ(n, t.size());
+
+        // ranks and selections are inverse to each other
+        std::size_t i = 0;
+        for (auto it = t.begin(); it != t.end(); ++it, ++i) {
+            EXPECT_EQ(i, t.rank(it));
+            EXPECT_EQ(int(i * 2), *t.select(i));
+        }
+        EXPECT_EQ(n, t.rank(t.end()));
+        EXPECT_EQ(t.end(), t.select(n));
+
+        // partitions cover ranges in pieces of equal size
+        auto a = t.lower_bound(n / 2);
+        for (std::size_t num : {1, 3, 16, 400}) {
+            auto chunks = test_set::iterator::partition(a, t.end(), num);
+            std::size_t expected = t.rank(t.end()) - t.rank(a);
+            std::size_t count = 0;
+            std::size_t max = 0;
+            auto cur = a;
+            for (const auto& chunk : chunks) {
+                EXPECT_EQ(cur, chunk.begin());
+                std::size_t size = std::distance(chunk.begin(), chunk.end());
+                count += size;
+                max = std::max(max, size);
+                cur = chunk.end();
+            }
+            EXPECT_EQ(t.end(), cur);
+            EXPECT_EQ(expected, count);
+            EXPECT_LT(max, expected / num + 2);
+        }
+    }
+}
+
 TEST(BTreeSet, IteratorEmpty) {
     using test_set = btree_set<int, detail::comparator<int>, std::allocator<int>, 16>;
     test_set t;
@@ -0,0 +1,82 @@
+/*
+ * Souffle - A Datalog Compiler
+ * Copyright (c) 2013, 2015, Oracle and/or its affiliates. All rights reserved
+ * Licensed under the Universal Permissive License v 1.0 as shown at:
+ * - https://opensource.org/licenses/UPL
+ * - <souffle root>/licenses/SOUFFLE-UPL.txt
+ */
+
+/************************************************************************
+ *
+ * @file compiled_record_test.cpp
+ *
+ * Test cases for the packing of records in the compiled and interpreted execution.
+ *
+ ***********************************************************************/
+
+#include "CompiledRecord.h"
+#include "InterpreterRecords.h"
+#include "test.h"
+
+#include <vector>
+
+namespace souffle {
+
+using namespace std;
+
+TEST(Record, PackUnpack) {
+    using tuple_type = ram::Tuple<RamDomain, 2>;
+
+    vector<RamDomain> refs;
+    for (RamDomain i = 0; i < 5000; i++) {
+        refs.push_back(pack<tuple_type>({{i, -i}}));
+        EXPECT_FALSE(isNull<tuple_type>(refs.back()));
+    }
+    for (RamDomain i = 0; i < 5000; i++) {
+        EXPECT_EQ(refs[i], pack<tuple_type>({{i, -i}}));
+        const tuple_type& tuple = unpack<tuple_type>(refs[i]);
+        EXPECT_EQ(i, tuple[0]);
+        EXPECT_EQ(-i, tuple[1]);
+    }
+}
+
+TEST(Record, ParallelPack) {
+    using tuple_type = ram::Tuple<RamDomain, 3>;
+    const int N = 20000;
+
+    // pack overlapping sets of tuples from all threads
+    vector<RamDomain> refs(2 * N);
+#pragma omp parallel for
+    for (int i = 0; i < 2 * N; i++) {
+        RamDomain v = i % N;
+        refs[i] = pack<tuple_type>({{v, v + 1, v + 2}});
+    }
+
+    for (int i = 0; i < N; i++) {
+        EXPECT_EQ(refs[i], refs[i + N]);
+        const tuple_type& tuple = unpack<tuple_type>(refs[i]);
+        EXPECT_EQ(i, tuple[0]);
+        EXPECT_EQ(i + 2, tuple[2]);
+    }
+}
+
+TEST(Record, Interpreter) {
+    // records with inline keys and with generic keys
+    for (int arity : {1, 4, 16, 17, 40}) {
+        vector<RamDomain> refs;
+        vector<RamDomain> tuple(arity);
+        for (RamDomain i = 0; i < 100; i++) {
+            tuple.assign(arity, i);
+            refs.push_back(pack(tuple.data(), arity));
+        }
+        for (RamDomain i = 0; i < 100; i++) {
+            tuple.assign(arity, i);
+            EXPECT_EQ(refs[i], pack(tuple.data(), arity));
+            const RamDomain* unpacked = unpack(refs[i], arity);
+            EXPECT_EQ(i, unpacked[0]);
+            EXPECT_EQ(i, unpacked[arity - 1]);
+        }
+    }
+}
+
+}  // end namespace souffle
@@ -17,7 +17,12 @@
 #include "AstProgram.h"
 #include "test.h"
 
+#include <atomic>
 #include <functional>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 using namespace souffle;
 
@@ -140,4 +145,162 @@ TEST(SymbolTable, Inserts) {
     if (ECHO_TIME) std::cout << "Time to insert " << N << " new elements: " << n << " ns" << std::endl;
 }
 
+TEST(SymbolTable, BlockGrowth) {
+    // enough symbols to fill several blocks of growing size
+    const size_t N = 100000;
+    SymbolTable table;
+
+    for (size_t i = 0; i < N; ++i) {
+        EXPECT_EQ(RamDomain(i), table.lookup(std::to_string(i) + "symbol"));
+    }
+    EXPECT_EQ(N, table.size());
+
+    // symbols keep their numbers and characters once further blocks are allocated
+    for (size_t i = 0; i < N; ++i) {
+        EXPECT_EQ(std::to_string(i) + "symbol", table.resolve(i));
+        EXPECT_EQ(RamDomain(i), table.lookupExisting(std::to_string(i) + "symbol"));
+    }
+
+    // numbers beyond the table are rejected
+    bool rejected = false;
+    try {
+        table.unsafeResolve(N);
+    } catch (const std::out_of_range&) {
+        rejected = true;
+    }
+    EXPECT_TRUE(rejected);
+}
+
+TEST(SymbolTable, EnumSideTable) {
+    SymbolTable table;
+    RamDomain top = table.lookup("Top");
+    RamDomain bot = table.lookup("Bot");
+    RamDomain other = table.lookup("other");
+
+    table.moveToEnd("Top");
+    table.moveToEnd("Bot");
+
+    // moved symbols are numbered in the enum range, at an offset of their position
+    const RamDomain base = MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_1;
+    EXPECT_EQ(base + top, table.lookup("Top"));
+    EXPECT_EQ(base + bot, table.lookupExisting("Bot"));
+    EXPECT_EQ(other, table.lookup("other"));
+
+    EXPECT_EQ("Top", table.resolve(base + top));
+    EXPECT_EQ("Bot", table.unsafeResolve(base + bot));
+    EXPECT_EQ("Bot", table.enumTypeResolve(base + bot));
+    EXPECT_EQ("other", table.resolve(other));
+
+    // the old numbers of moved symbols, and enum numbers of others, are gone
+    bool rejected = false;
+    try {
+        table.unsafeResolve(top);
+    } catch (const std::out_of_range&) {
+        rejected = true;
+    }
+    EXPECT_TRUE(rejected);
+    rejected = false;
+    try {
+        table.unsafeResolve(base + other);
+    } catch (const std::out_of_range&) {
+        rejected = true;
+    }
+    EXPECT_TRUE(rejected);
+
+    // copies keep the side table
+    SymbolTable copy(table);
+    EXPECT_EQ(base + top, copy.lookup("Top"));
+    EXPECT_EQ("Top", copy.resolve(base + top));
+    EXPECT_EQ(other, copy.lookup("other"));
+
+    // new symbols follow the moved ones
+    EXPECT_EQ(RamDomain(3), table.lookup("new"));
+}
+
+#ifdef _OPENMP
+TEST(SymbolTable, ParallelLookups) {
+    // symbols spread over all shards of the index and several blocks
+    const int N = 100000;
+    SymbolTable table;
+    std::vector<RamDomain> numbers(N);
+    std::atomic<size_t> unwritten(0);
+
+#pragma omp parallel for
+    for (int i = 0; i < N; ++i) {
+        // every symbol is looked up twice, by threads racing to insert it
+        numbers[i] = table.lookup(std::to_string(i / 2) + "symbol");
+
+        // all counted symbols are written, although others are being inserted
+        size_t size = table.size();
+        if (size > 0) {
+            RamDomain last = static_cast<RamDomain>(size - 1);
+            if (table.resolve(last).empty() || table.lookup(table.resolve(last)) != last) {
+                unwritten++;
+            }
+        }
+    }
+
+    EXPECT_EQ(0u, unwritten.load());
+    EXPECT_EQ(size_t(N / 2), table.size());
+    std::set<RamDomain> distinct;
+    for (int i = 0; i < N; ++i) {
+        EXPECT_EQ(std::to_string(i / 2) + "symbol", table.resolve(numbers[i]));
+        if (i % 2 == 1) {
+            EXPECT_EQ(numbers[i - 1], numbers[i]);
+        }
+        distinct.insert(numbers[i]);
+    }
+    EXPECT_EQ(size_t(N / 2), distinct.size());
+}
+
+TEST(SymbolTable, ParallelLookupsMoveToEnd) {
+    // symbols inserted concurrently over several blocks, some of them moved afterwards
+    const int N = 100000;
+    SymbolTable table;
+    std::vector<RamDomain> numbers(N);
+
+#pragma omp parallel for
+    for (int i = 0; i < N; ++i) {
+        numbers[i] = table.lookup(std::to_string(i) + "symbol");
+    }
+
+    // only symbols below the capacity of the enum range can be moved
+    auto moved = [&](int i) {
+        return numbers[i] % 7 == 0 && numbers[i] < ENUM_SYMBOL_OFFSET_1 - ENUM_SYMBOL_OFFSET_2;
+    };
+
+    // moving symbols races with resolving the others
+    const RamDomain base = MAX_RAM_DOMAIN - ENUM_SYMBOL_OFFSET_1;
+    std::atomic<size_t> wrong(0);
+#pragma omp parallel for
+    for (int i = 0; i < N; ++i) {
+        if (moved(i)) {
+            table.moveToEnd(std::to_string(i) + "symbol");
+        } else if (table.resolve(numbers[i]) != std::to_string(i) + "symbol") {
+            wrong++;
+        }
+    }
+    EXPECT_EQ(0u, wrong.load());
+
+    EXPECT_EQ(size_t(N), table.size());
+    for (int i = 0; i < N; ++i) {
+        const std::string symbol = std::to_string(i) + "symbol";
+        if (moved(i)) {
+            EXPECT_EQ(base + numbers[i], table.lookup(symbol));
+            EXPECT_EQ(symbol, table.resolve(base + numbers[i]));
+            bool rejected = false;
+            try {
+                table.unsafeResolve(numbers[i]);
+            } catch (const std::out_of_range&) {
+                rejected = true;
+            }
+            EXPECT_TRUE(rejected);
+        } else {
+            EXPECT_EQ(numbers[i], table.lookup(symbol));
+            EXPECT_EQ(symbol, table.resolve(numbers[i]));
+        }
+    }
+}
+#endif
+
 }  // end namespace test